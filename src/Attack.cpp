@@ -0,0 +1,216 @@
+#include <bit>
+
+#include "Attack.h"
+#include "Board.h"
+#include "Cpu.h"
+#include "Magic.h"
+#include "Tables.h"
+
+/*
+Queries about which squares are attacked, built on the Magic slider lookups and the leaper tables.
+attackedBy() computes every square a side attacks and caches it for the current position, so castling, legality
+and eval can all ask for it without computing it again. The cache is per thread and is keyed on Board::version.
+
+slidingAttacks() finds everything a set of sliders attacks at once with Kogge-Stone occluded fills: each of the
+8 directions is flooded from all the pieces together in three doubling steps, stopping at occupied squares, so it
+takes the same number of shifts however many sliders there are. AttackAVX2.cpp does four directions per register.
+*/
+
+namespace Attack {
+
+	/*
+	* Last computed attack map for each side (0 white, 1 black) and the board version it belongs to.
+	*/
+	thread_local std::uint64_t cachedMap[2];
+	thread_local std::uint64_t cachedVersion[2] = { ~0ULL, ~0ULL };
+
+	//Whether slidingAttacks() uses the AVX2 fills. Starts as whether it can; set it to false to compare.
+	bool avx2 = [] {
+		std::uint64_t attacks;
+		return Cpu::hasAVX2() && slidingAttacksAVX2(0, 0, 0, attacks);
+	}();
+
+	/**
+	 * .
+	 * Moves every bit one step in a direction: positive shifts go towards H1, negative towards A8. The wrap mask
+	 * clears the column a step along this direction can't land on from the board.
+	 * \param b
+	 * \return
+	 */
+	template<int shift>
+	constexpr std::uint64_t step(std::uint64_t b) {
+		if constexpr (shift > 0) return b << shift;
+		else return b >> -shift;
+	}
+
+	/**
+	 * .
+	 * Occluded fill in one direction: every square the pieces in gen reach before and including the first blocker.
+	 * \param gen
+	 * \param empty
+	 * \param wrap
+	 * \return
+	 */
+	template<int shift>
+	constexpr std::uint64_t fill(std::uint64_t gen, std::uint64_t empty, std::uint64_t wrap) {
+
+		std::uint64_t pro = empty & wrap;
+
+		gen |= pro & step<shift>(gen);
+		pro &= step<shift>(pro);
+		gen |= pro & step<shift * 2>(gen);
+		pro &= step<shift * 2>(pro);
+		gen |= pro & step<shift * 4>(gen);
+
+		return step<shift>(gen) & wrap;
+
+	}
+
+	/**
+	 * .
+	 * Returns every square the rooks (straight) and bishops (diagonal) attack with the given occupancy, with plain
+	 * 64-bit fills. Queens go in both.
+	 * \param rooks
+	 * \param bishops
+	 * \param occ
+	 * \return
+	 */
+	std::uint64_t slidingAttacksScalar(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ) {
+
+		std::uint64_t empty = ~occ;
+
+		return fill<-8>(rooks, empty, ~0ULL) | fill<8>(rooks, empty, ~0ULL)
+			| fill<1>(rooks, empty, ~Board::colA) | fill<-1>(rooks, empty, ~Board::colH)
+			| fill<9>(bishops, empty, ~Board::colA) | fill<7>(bishops, empty, ~Board::colH)
+			| fill<-9>(bishops, empty, ~Board::colH) | fill<-7>(bishops, empty, ~Board::colA);
+
+	}
+
+	/**
+	 * .
+	 * Returns every square the rooks and bishops attack. Uses the AVX2 fills if the CPU has them; otherwise a
+	 * Magic lookup per piece, which beats plain 64-bit fills for the few sliders a side usually has.
+	 * \param rooks
+	 * \param bishops
+	 * \param occ
+	 * \return
+	 */
+	std::uint64_t slidingAttacks(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ) {
+
+		std::uint64_t attacks{ 0 };
+
+		if (avx2 && slidingAttacksAVX2(rooks, bishops, occ, attacks)) return attacks;
+
+		for (std::uint64_t b = rooks; b; b &= b - 1) attacks |= Magic::getRookMove(std::countr_zero(b), occ);
+		for (std::uint64_t b = bishops; b; b &= b - 1) attacks |= Magic::getBishopMove(std::countr_zero(b), occ);
+
+		return attacks;
+
+	}
+
+	/**
+	 * .
+	 * Returns every piece of either color that attacks a square, with the given occupancy for the sliders.
+	 * Pawns are found by looking from the square the other way: a white pawn attacks sq if a black pawn on sq
+	 * would attack it.
+	 * \param sq
+	 * \param occ
+	 * \return
+	 */
+	std::uint64_t attackersTo(int sq, std::uint64_t occ) {
+
+		return (Tables::pawnAttacks[1][sq] & Board::WP)
+			| (Tables::pawnAttacks[0][sq] & Board::BP)
+			| (Tables::knightAttacks[sq] & (Board::WN | Board::BN))
+			| (Tables::kingAttacks[sq] & (Board::WK | Board::BK))
+			| (Magic::getRookMove(sq, occ) & (Board::WR | Board::BR | Board::WQ | Board::BQ))
+			| (Magic::getBishopMove(sq, occ) & (Board::WB | Board::BB | Board::WQ | Board::BQ));
+
+	}
+
+	/**
+	 * .
+	 * Checks if a side attacks a square on the current board. Stops at the first kind of attacker it finds.
+	 * \param sq
+	 * \param byWhite
+	 * \return
+	 */
+	bool isSquareAttacked(int sq, bool byWhite) {
+
+		std::uint64_t P = byWhite ? Board::WP : Board::BP;
+		std::uint64_t N = byWhite ? Board::WN : Board::BN;
+		std::uint64_t K = byWhite ? Board::WK : Board::BK;
+		std::uint64_t straight = byWhite ? (Board::WR | Board::WQ) : (Board::BR | Board::BQ);
+		std::uint64_t diagonal = byWhite ? (Board::WB | Board::WQ) : (Board::BB | Board::BQ);
+
+		if (Tables::pawnAttacks[byWhite ? 1 : 0][sq] & P) return true;
+		if (Tables::knightAttacks[sq] & N) return true;
+		if (Tables::kingAttacks[sq] & K) return true;
+
+		std::uint64_t occ = Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			| Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+
+		if (straight && (Magic::getRookMove(sq, occ) & straight)) return true;
+		if (diagonal && (Magic::getBishopMove(sq, occ) & diagonal)) return true;
+
+		return false;
+
+	}
+
+	/**
+	 * .
+	 * Returns every square a side attacks in the current position. Computed once per position and then cached.
+	 * \param white
+	 * \return
+	 */
+	std::uint64_t attackedBy(bool white) {
+
+		int side = white ? 0 : 1;
+
+		if (cachedVersion[side] == Board::version) return cachedMap[side];
+
+		std::uint64_t occ = Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			| Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+
+		std::uint64_t attacks{ 0 };
+
+		/*
+		* Pawns and sliders are done all at once with shifts. Knights and kings go piece by piece.
+		*/
+
+		if (white) attacks |= (Board::WP >> 9 & ~Board::colH) | (Board::WP >> 7 & ~Board::colA);
+		else attacks |= (Board::BP << 9 & ~Board::colA) | (Board::BP << 7 & ~Board::colH);
+
+		for (std::uint64_t b = white ? Board::WN : Board::BN; b; b &= b - 1) attacks |= Tables::knightAttacks[std::countr_zero(b)];
+		for (std::uint64_t b = white ? Board::WK : Board::BK; b; b &= b - 1) attacks |= Tables::kingAttacks[std::countr_zero(b)];
+
+		std::uint64_t Q = white ? Board::WQ : Board::BQ;
+		attacks |= slidingAttacks((white ? Board::WR : Board::BR) | Q, (white ? Board::WB : Board::BB) | Q, occ);
+
+		cachedMap[side] = attacks;
+		cachedVersion[side] = Board::version;
+
+		return attacks;
+
+	}
+
+	/**
+	 * .
+	 * Returns the enemy pieces giving check to the side to move.
+	 * \return
+	 */
+	std::uint64_t checkers() {
+
+		std::uint64_t king = Board::whiteTurn ? Board::WK : Board::BK;
+		if (!king) return 0;
+
+		std::uint64_t occ = Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			| Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+		std::uint64_t enemy = Board::whiteTurn ? (Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK)
+			: (Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK);
+
+		return attackersTo(std::countr_zero(king), occ) & enemy;
+
+	}
+
+}
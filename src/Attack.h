@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Attack {
+
+	extern std::uint64_t attackersTo(int sq, std::uint64_t occ);
+
+	extern bool isSquareAttacked(int sq, bool byWhite);
+
+	extern std::uint64_t attackedBy(bool white);
+
+	extern std::uint64_t checkers();
+
+	extern bool avx2;
+
+	extern std::uint64_t slidingAttacks(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ);
+
+	extern std::uint64_t slidingAttacksScalar(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ);
+
+	extern bool slidingAttacksAVX2(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ, std::uint64_t& attacks);
+
+}
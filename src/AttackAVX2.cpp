@@ -0,0 +1,81 @@
+#include "Attack.h"
+#include "Board.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && defined(_M_X64))
+#include <immintrin.h>
+#define GORILLA_ATTACK_AVX2
+#endif
+
+/*
+The AVX2 build of the Kogge-Stone slider fills (see Attack.cpp). This file is compiled with AVX2 enabled and only
+called once Attack.cpp has checked the CPU supports it.
+
+The 8 directions go in two registers of four, grouped by which way they shift, since the variable shifts move
+every lane the same way: south, east, south-east and south-west shift left (towards H1), north, west, north-west
+and north-east shift right. Each lane has its own shift amount and wrap mask.
+*/
+
+namespace Attack {
+
+#ifdef GORILLA_ATTACK_AVX2
+
+	/**
+	 * .
+	 * Fills four directions at once. left picks the shift direction of the whole register.
+	 * \param gen
+	 * \param empty
+	 * \param wrap
+	 * \param shift
+	 * \return
+	 */
+	template<bool left>
+	inline __m256i fill(__m256i gen, __m256i empty, __m256i wrap, __m256i shift) {
+
+		auto step = [](__m256i b, __m256i s) { return left ? _mm256_sllv_epi64(b, s) : _mm256_srlv_epi64(b, s); };
+
+		__m256i shift2 = _mm256_add_epi64(shift, shift);
+		__m256i shift4 = _mm256_add_epi64(shift2, shift2);
+		__m256i pro = _mm256_and_si256(empty, wrap);
+
+		gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, shift)));
+		pro = _mm256_and_si256(pro, step(pro, shift));
+		gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, shift2)));
+		pro = _mm256_and_si256(pro, step(pro, shift2));
+		gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, shift4)));
+
+		return _mm256_and_si256(step(gen, shift), wrap);
+
+	}
+
+	bool slidingAttacksAVX2(std::uint64_t rooks, std::uint64_t bishops, std::uint64_t occ, std::uint64_t& attacks) {
+
+		//Lanes are listed last to first: lanes 0 and 1 are straight directions, 2 and 3 diagonal
+		__m256i gen = _mm256_set_epi64x((long long)bishops, (long long)bishops, (long long)rooks, (long long)rooks);
+		__m256i empty = _mm256_set1_epi64x((long long)~occ);
+
+		//South, east, south-east, south-west
+		__m256i leftShift = _mm256_set_epi64x(7, 9, 1, 8);
+		__m256i leftWrap = _mm256_set_epi64x((long long)~Board::colH, (long long)~Board::colA, (long long)~Board::colA, -1);
+
+		//North, west, north-west, north-east
+		__m256i rightShift = _mm256_set_epi64x(7, 9, 1, 8);
+		__m256i rightWrap = _mm256_set_epi64x((long long)~Board::colA, (long long)~Board::colH, (long long)~Board::colH, -1);
+
+		__m256i all = _mm256_or_si256(fill<true>(gen, empty, leftWrap, leftShift), fill<false>(gen, empty, rightWrap, rightShift));
+
+		__m128i half = _mm_or_si128(_mm256_castsi256_si128(all), _mm256_extracti128_si256(all, 1));
+		attacks = (std::uint64_t)_mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+
+		return true;
+
+	}
+
+#else
+
+	bool slidingAttacksAVX2(std::uint64_t, std::uint64_t, std::uint64_t, std::uint64_t&) {
+		return false;
+	}
+
+#endif
+
+}
@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "Batch.h"
+#include "BatchKernel.h"
+#include "Bench.h"
+#include "Cpu.h"
+#include "Magic.h"
+#include "Move.h"
+#include "Search.h"
+#include "Tables.h"
+
+/*
+Pseudo-legal move generation for four positions at once, for batch jobs over many independent positions (perft
+suites, data generation, mobility features). The positions are loaded into Lanes and generate() fills in the
+target squares of each kind of move and the number of moves for all four.
+
+perft() uses the counts for the last ply of the tree, which is most of its work: a position there that isn't in
+check, has nothing pinned and no en passant capture only loses the king moves to attacked squares, so its legal
+moves are counted without making any of them. bench-epd runs perft suites with it.
+
+batchcheck [plies] compares the targets and counts with Move::generate on the bench positions and every position
+up to plies (default 2) legal moves from them, with the AVX2 kernel if the CPU has it and with the plain one, and
+perft to plies + 1 with Search::perft.
+
+Pawns, knights and kings are set-wise shifts and masks, which run in vector lanes (BatchKernel.h): with AVX2 when
+the CPU has it, otherwise the same code on plain integers. Sliders and castling need the Magic lookups and attack
+checks, so they're done per position afterwards.
+*/
+
+namespace Batch {
+
+	/*
+	* Four bitboards as plain integers, for CPUs without AVX2.
+	*/
+	struct Scalar {
+
+		std::uint64_t v[width];
+
+		static Scalar load(const std::uint64_t* p) { return { { p[0], p[1], p[2], p[3] } }; }
+		static void store(std::uint64_t* p, Scalar a) { for (int i = 0; i < width; i++) p[i] = a.v[i]; }
+		static Scalar set1(std::uint64_t x) { return { { x, x, x, x } }; }
+
+		friend Scalar operator&(Scalar a, Scalar b) { for (int i = 0; i < width; i++) a.v[i] &= b.v[i]; return a; }
+		friend Scalar operator|(Scalar a, Scalar b) { for (int i = 0; i < width; i++) a.v[i] |= b.v[i]; return a; }
+
+		static Scalar andNot(Scalar a, Scalar b) { for (int i = 0; i < width; i++) a.v[i] &= ~b.v[i]; return a; }
+		static Scalar select(Scalar mask, Scalar a, Scalar b) { for (int i = 0; i < width; i++) a.v[i] = (mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i]); return a; }
+		static Scalar add(Scalar a, Scalar b) { for (int i = 0; i < width; i++) a.v[i] += b.v[i]; return a; }
+
+		template<int n> static Scalar shl(Scalar a) { for (int i = 0; i < width; i++) a.v[i] <<= n; return a; }
+		template<int n> static Scalar shr(Scalar a) { for (int i = 0; i < width; i++) a.v[i] >>= n; return a; }
+
+		static Scalar popcount(Scalar a) { for (int i = 0; i < width; i++) a.v[i] = std::popcount(a.v[i]); return a; }
+
+	};
+
+	//Whether generate() uses the AVX2 kernel. Starts as whether it can; set it to false to compare with the plain one.
+	bool avx2 = [] {
+		Lanes lanes{};
+		Targets targets;
+		return Cpu::hasAVX2() && kernelAVX2(lanes, targets);
+	}();
+
+	/**
+	 * .
+	 * Copies a position into one lane.
+	 * \param lanes
+	 * \param lane
+	 * \param s
+	 */
+	void load(Lanes& lanes, int lane, const Board::State& s) {
+
+		const std::uint64_t pieces[12] = { s.WP, s.WN, s.WB, s.WR, s.WQ, s.WK, s.BP, s.BN, s.BB, s.BR, s.BQ, s.BK };
+
+		for (int p = 0; p < 12; p++) lanes.pieces[p][lane] = pieces[p];
+
+		lanes.enPassant[lane] = s.enPassant;
+		lanes.white[lane] = s.whiteTurn ? ~0ULL : 0;
+		lanes.castlingRights[lane] = s.castlingRights;
+
+	}
+
+	/**
+	 * .
+	 * Checks if a side attacks a square in one lane, like Attack::isSquareAttacked does on the board.
+	 * \param in
+	 * \param lane
+	 * \param sq
+	 * \param byWhite
+	 * \param occ
+	 * \return
+	 */
+	bool attacked(const Lanes& in, int lane, int sq, bool byWhite, std::uint64_t occ) {
+
+		int base = byWhite ? 0 : 6;
+
+		if (Tables::pawnAttacks[byWhite ? 1 : 0][sq] & in.pieces[base][lane]) return true;
+		if (Tables::knightAttacks[sq] & in.pieces[base + 1][lane]) return true;
+		if (Tables::kingAttacks[sq] & in.pieces[base + 5][lane]) return true;
+
+		std::uint64_t straight = in.pieces[base + 3][lane] | in.pieces[base + 4][lane];
+		std::uint64_t diagonal = in.pieces[base + 2][lane] | in.pieces[base + 4][lane];
+
+		if (straight && (Magic::getRookMove(sq, occ) & straight)) return true;
+		if (diagonal && (Magic::getBishopMove(sq, occ) & diagonal)) return true;
+
+		return false;
+
+	}
+
+	/**
+	 * .
+	 * Generates the move targets and counts of the side to move in all four positions.
+	 * \param in
+	 * \param out
+	 */
+	void generate(const Lanes& in, Targets& out) {
+
+		if (!avx2 || !kernelAVX2(in, out)) kernel<Scalar>(in, out);
+
+		for (int lane = 0; lane < width; lane++) {
+
+			bool white = in.white[lane];
+			int base = white ? 0 : 6;
+
+			std::uint64_t own{ 0 }, occ{ 0 };
+			for (int p = 0; p < 12; p++) occ |= in.pieces[p][lane];
+			for (int p = base; p < base + 6; p++) own |= in.pieces[p][lane];
+
+			std::uint64_t queens = in.pieces[base + 4][lane];
+			std::uint64_t sliders{ 0 };
+			std::uint64_t count{ 0 };
+
+			for (std::uint64_t b = in.pieces[base + 3][lane] | queens; b; b &= b - 1) {
+				std::uint64_t to = Magic::getRookMove(std::countr_zero(b), occ) & ~own;
+				sliders |= to;
+				count += std::popcount(to);
+			}
+			for (std::uint64_t b = in.pieces[base + 2][lane] | queens; b; b &= b - 1) {
+				std::uint64_t to = Magic::getBishopMove(std::countr_zero(b), occ) & ~own;
+				sliders |= to;
+				count += std::popcount(to);
+			}
+
+			/*
+			* A queen's rook and bishop moves go to different squares, so counting them apart counts each once.
+			* Castling is checked the same way movegen does it.
+			*/
+
+			std::uint8_t rights = in.castlingRights[lane];
+			std::uint64_t castling{ 0 };
+
+			if (white) {
+				if ((rights & Board::whiteKingside) && !(occ & Board::shortPathW)
+					&& !attacked(in, lane, 60, false, occ) && !attacked(in, lane, 61, false, occ) && !attacked(in, lane, 62, false, occ)) castling |= 1ULL << 62;
+				if ((rights & Board::whiteQueenside) && !(occ & Board::longPathW)
+					&& !attacked(in, lane, 60, false, occ) && !attacked(in, lane, 59, false, occ) && !attacked(in, lane, 58, false, occ)) castling |= 1ULL << 58;
+			}
+			else {
+				if ((rights & Board::blackKingside) && !(occ & Board::shortPathB)
+					&& !attacked(in, lane, 4, true, occ) && !attacked(in, lane, 5, true, occ) && !attacked(in, lane, 6, true, occ)) castling |= 1ULL << 6;
+				if ((rights & Board::blackQueenside) && !(occ & Board::longPathB)
+					&& !attacked(in, lane, 4, true, occ) && !attacked(in, lane, 3, true, occ) && !attacked(in, lane, 2, true, occ)) castling |= 1ULL << 2;
+			}
+
+			out.sliders[lane] = sliders;
+			out.castling[lane] = castling;
+			out.count[lane] += count + std::popcount(castling);
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Whether the side to move has a piece pinned to its king, which would make some of its pseudo-legal moves
+	 * illegal.
+	 * \return
+	 */
+	bool pinned() {
+
+		bool white = Board::whiteTurn;
+		int king = std::countr_zero(white ? Board::WK : Board::BK);
+
+		std::uint64_t own = white ? Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			: Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+		std::uint64_t occ = own | (white ? Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK
+			: Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK);
+
+		std::uint64_t straight = white ? Board::BR | Board::BQ : Board::WR | Board::WQ;
+		std::uint64_t diagonal = white ? Board::BB | Board::BQ : Board::WB | Board::WQ;
+
+		/*
+		* A slider on an empty line to the king pins the only piece between them, if that piece is ours.
+		*/
+
+		for (std::uint64_t b = Magic::getRookMove(king, 0) & straight; b; b &= b - 1) {
+			int sq = std::countr_zero(b);
+			std::uint64_t between = Magic::getRookMove(king, 1ULL << sq) & Magic::getRookMove(sq, 1ULL << king) & occ;
+			if (std::popcount(between) == 1 && (between & own)) return true;
+		}
+
+		for (std::uint64_t b = Magic::getBishopMove(king, 0) & diagonal; b; b &= b - 1) {
+			int sq = std::countr_zero(b);
+			std::uint64_t between = Magic::getBishopMove(king, 1ULL << sq) & Magic::getBishopMove(sq, 1ULL << king) & occ;
+			if (std::popcount(between) == 1 && (between & own)) return true;
+		}
+
+		return false;
+
+	}
+
+	/**
+	 * .
+	 * Number of legal moves in the current position, making every move.
+	 * \return
+	 */
+	std::uint64_t legalCount() {
+
+		Board::State state = Board::save();
+		std::uint64_t count{ 0 };
+
+		for (std::uint16_t m : Move::generate()) {
+			if (Move::makeLegal(m)) count++;
+			Board::restore(state);
+		}
+
+		return count;
+
+	}
+
+	/*
+	* Positions at the last ply of a perft, counted four at a time.
+	*/
+	struct Frontier {
+		Lanes lanes{};
+		int used{ 0 };
+		std::uint64_t count{ 0 };
+	};
+
+	/**
+	 * .
+	 * Counts the legal moves of the positions waiting in the frontier.
+	 * \param f
+	 */
+	void flush(Frontier& f) {
+
+		if (!f.used) return;
+
+		Targets targets;
+		generate(f.lanes, targets);
+
+		/*
+		* Not in check and with nothing pinned, the only illegal pseudo-legal moves are king moves to attacked
+		* squares. The king is taken off the board so a slider's line through it counts.
+		*/
+
+		for (int lane = 0; lane < f.used; lane++) {
+
+			bool white = f.lanes.white[lane];
+			std::uint64_t king = f.lanes.pieces[white ? 5 : 11][lane];
+
+			std::uint64_t occ{ 0 };
+			for (int p = 0; p < 12; p++) occ |= f.lanes.pieces[p][lane];
+			occ &= ~king;
+
+			std::uint64_t count = targets.count[lane];
+
+			for (std::uint64_t b = targets.kings[lane]; b; b &= b - 1) {
+				if (attacked(f.lanes, lane, std::countr_zero(b), !white, occ)) count--;
+			}
+
+			f.count += count;
+
+		}
+
+		f.used = 0;
+
+	}
+
+	/**
+	 * .
+	 * Adds the current position to the frontier, or counts it on the spot if its pseudo-legal count can't be
+	 * corrected cheaply: in check, with a pinned piece, or with an en passant capture, which can uncover the king.
+	 * \param f
+	 */
+	void add(Frontier& f) {
+
+		bool white = Board::whiteTurn;
+		int ep = Board::enPassant ? std::countr_zero(Board::enPassant) : -1;
+
+		if (Move::inCheck(white) || (ep >= 0 && (Tables::pawnAttacks[white ? 1 : 0][ep] & (white ? Board::WP : Board::BP))) || pinned()) {
+			f.count += legalCount();
+			return;
+		}
+
+		load(f.lanes, f.used++, Board::save());
+
+		if (f.used == width) flush(f);
+
+	}
+
+	/**
+	 * .
+	 * Walks the legal move tree down to the last ply, adding the positions there to the frontier.
+	 * \param depth
+	 * \param f
+	 */
+	void descend(int depth, Frontier& f) {
+
+		if (depth == 1) {
+			add(f);
+			return;
+		}
+
+		Board::State state = Board::save();
+
+		for (std::uint16_t m : Move::generate()) {
+			if (Move::makeLegal(m)) descend(depth - 1, f);
+			Board::restore(state);
+		}
+
+	}
+
+	/**
+	 * .
+	 * Counts the leaf nodes of the legal move tree of the current position, like Search::perft, but counts the
+	 * moves at the last ply four positions at a time from their pseudo-legal counts instead of making each move.
+	 * \param depth
+	 * \return
+	 */
+	std::uint64_t perft(int depth) {
+
+		if (depth <= 0) return 1;
+
+		Frontier f;
+		descend(depth, f);
+		flush(f);
+
+		return f.count;
+
+	}
+
+	/*
+	* The fields of Targets, for comparing them one by one.
+	*/
+	struct Field {
+		const char* name;
+		std::uint64_t(Targets::* member)[width];
+	};
+
+	constexpr Field fields[] = {
+		{ "pawn pushes", &Targets::pawnPushes },
+		{ "double pushes", &Targets::pawnDoubles },
+		{ "pawn captures", &Targets::pawnCaptures },
+		{ "promotions", &Targets::promotions },
+		{ "en passant", &Targets::enPassant },
+		{ "knights", &Targets::knights },
+		{ "kings", &Targets::kings },
+		{ "sliders", &Targets::sliders },
+		{ "castling", &Targets::castling },
+		{ "count", &Targets::count }
+	};
+
+	/**
+	 * .
+	 * Fills in one lane of targets from the moves Move::generate() makes in the current position.
+	 * \param targets
+	 * \param lane
+	 */
+	void reference(Targets& targets, int lane) {
+
+		std::vector<std::uint16_t> moves = Move::generate();
+
+		for (std::uint16_t m : moves) {
+
+			int to = m & Move::toMask;
+			int from = (m & Move::fromMask) >> 6;
+			int special = (m & Move::specMask) >> 14;
+			int piece = Board::pieceAt(from) % 6;
+			std::uint64_t bit = 1ULL << to;
+
+			if (special == 3) targets.castling[lane] |= bit;
+			else if (special == 2) targets.enPassant[lane] |= bit;
+			else if (special == 1) targets.promotions[lane] |= bit;
+			else if (piece == 0) {
+				if (from - to == 16 || to - from == 16) targets.pawnDoubles[lane] |= bit;
+				else if (from % 8 == to % 8) targets.pawnPushes[lane] |= bit;
+				else targets.pawnCaptures[lane] |= bit;
+			}
+			else if (piece == 1) targets.knights[lane] |= bit;
+			else if (piece == 5) targets.kings[lane] |= bit;
+			else targets.sliders[lane] |= bit;
+
+		}
+
+		targets.count[lane] = moves.size();
+
+	}
+
+	/**
+	 * .
+	 * Adds the current position and every position up to plies legal moves from it.
+	 * \param states
+	 * \param plies
+	 */
+	void expand(std::vector<Board::State>& states, int plies) {
+
+		Board::State state = Board::save();
+		states.push_back(state);
+
+		if (plies <= 0) return;
+
+		for (std::uint16_t m : Move::generate()) {
+			if (Move::makeLegal(m)) expand(states, plies - 1);
+			Board::restore(state);
+		}
+
+	}
+
+	/**
+	 * .
+	 * Checks generate() against Move::generate: batchcheck [plies].
+	 * \param input
+	 */
+	void check(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string command;
+		int plies{ 2 };
+
+		reader >> command;
+		if (!(reader >> plies)) plies = 2;
+		plies = std::clamp(plies, 0, 3);
+
+		Board::State original = Board::save();
+
+		std::vector<Board::State> states;
+
+		for (int i = 0; i < Bench::positionCount; i++) {
+			Board::loadFEN(Bench::positions[i]);
+			expand(states, plies);
+		}
+
+		bool canAVX2 = avx2;
+
+		for (bool vector : { true, false }) {
+
+			if (vector && !canAVX2) continue;
+			avx2 = vector;
+
+			std::uint64_t mismatches{ 0 };
+
+			for (std::size_t first = 0; first < states.size(); first += width) {
+
+				int used = (int)std::min<std::size_t>(width, states.size() - first);
+
+				Lanes lanes{};
+				Targets want{}, got{};
+
+				for (int lane = 0; lane < used; lane++) {
+					load(lanes, lane, states[first + lane]);
+					Board::restore(states[first + lane]);
+					reference(want, lane);
+				}
+
+				generate(lanes, got);
+
+				for (int lane = 0; lane < used; lane++) {
+
+					for (const Field& f : fields) {
+
+						if ((want.*f.member)[lane] == (got.*f.member)[lane]) continue;
+
+						if (++mismatches <= 10) {
+							Board::restore(states[first + lane]);
+							std::cout << "info string " << f.name << " differ: " << (got.*f.member)[lane] << " instead of "
+								<< (want.*f.member)[lane] << " in " << Board::getFEN() << std::endl;
+						}
+
+					}
+
+				}
+
+			}
+
+			std::cout << "info string batch check " << (vector ? "avx2" : "scalar") << ": " << states.size() << " positions, "
+				<< mismatches << " mismatches" << std::endl;
+
+		}
+
+		/*
+		* perft against Search::perft, with the default path, to the depth of the positions above plus one.
+		*/
+
+		avx2 = canAVX2;
+
+		std::uint64_t perftMismatches{ 0 }, leaves{ 0 };
+
+		for (int i = 0; i < Bench::positionCount; i++) {
+
+			Board::loadFEN(Bench::positions[i]);
+
+			std::uint64_t batched = perft(plies + 1);
+			std::uint64_t expected = Search::perft(plies + 1);
+			leaves += expected;
+
+			if (batched != expected && ++perftMismatches <= 10) {
+				std::cout << "info string perft " << plies + 1 << " differs: " << batched << " instead of " << expected << " in "
+					<< Bench::positions[i] << std::endl;
+			}
+
+		}
+
+		std::cout << "info string batch check perft " << plies + 1 << ": " << leaves << " leaves, " << perftMismatches << " mismatches" << std::endl;
+
+		Board::restore(original);
+
+	}
+
+}
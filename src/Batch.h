@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Board.h"
+
+namespace Batch {
+
+	constexpr int width{ 4 };
+
+	/*
+	* Four positions laid out structure-of-arrays: pieces[p][i] is piece bitboard p (WP-BK) of position i, so each
+	* row is one 256-bit vector. white[i] is all ones if white is to move in position i, otherwise 0.
+	*/
+	struct alignas(32) Lanes {
+		std::uint64_t pieces[12][width];
+		std::uint64_t enPassant[width];
+		std::uint64_t white[width];
+		std::uint8_t castlingRights[width];
+	};
+
+	/*
+	* The squares the side to move can move to in each of four positions, by kind of move, and how many
+	* pseudo-legal moves that is in total. count[i] is the size of the list Move::generate() makes for position i.
+	* The counts are pseudo-legal; perft() corrects them into legal counts at the last ply of its tree.
+	*/
+	struct alignas(32) Targets {
+		std::uint64_t pawnPushes[width];	//single pushes that don't promote
+		std::uint64_t pawnDoubles[width];
+		std::uint64_t pawnCaptures[width];	//captures that don't promote
+		std::uint64_t promotions[width];	//squares promoted on, by push or capture
+		std::uint64_t enPassant[width];
+		std::uint64_t knights[width];
+		std::uint64_t kings[width];
+		std::uint64_t sliders[width];
+		std::uint64_t castling[width];		//the king's destination
+		std::uint64_t count[width];
+	};
+
+	extern bool avx2;
+
+	extern void load(Lanes& lanes, int lane, const Board::State& s);
+
+	extern void generate(const Lanes& lanes, Targets& targets);
+
+	extern std::uint64_t perft(int depth);
+
+	extern void check(const std::string& input);
+
+}
@@ -0,0 +1,67 @@
+#include "BatchKernel.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && defined(_M_X64))
+#include <immintrin.h>
+#define GORILLA_BATCH_AVX2
+#endif
+
+/*
+The AVX2 build of the batch kernel (see BatchKernel.h). This file is compiled with AVX2 enabled, and nothing in it
+runs unless Batch.cpp has checked that the CPU supports it. Where the compiler can't target AVX2 the kernel isn't
+built and kernelAVX2 reports that.
+*/
+
+namespace Batch {
+
+#ifdef GORILLA_BATCH_AVX2
+
+	/*
+	* Four bitboards in one 256-bit register.
+	*/
+	struct Avx2 {
+
+		__m256i v;
+
+		static Avx2 load(const std::uint64_t* p) { return { _mm256_load_si256(reinterpret_cast<const __m256i*>(p)) }; }
+		static void store(std::uint64_t* p, Avx2 a) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), a.v); }
+		static Avx2 set1(std::uint64_t x) { return { _mm256_set1_epi64x((long long)x) }; }
+
+		friend Avx2 operator&(Avx2 a, Avx2 b) { return { _mm256_and_si256(a.v, b.v) }; }
+		friend Avx2 operator|(Avx2 a, Avx2 b) { return { _mm256_or_si256(a.v, b.v) }; }
+
+		static Avx2 andNot(Avx2 a, Avx2 b) { return { _mm256_andnot_si256(b.v, a.v) }; }
+		static Avx2 select(Avx2 mask, Avx2 a, Avx2 b) { return { _mm256_blendv_epi8(b.v, a.v, mask.v) }; }
+		static Avx2 add(Avx2 a, Avx2 b) { return { _mm256_add_epi64(a.v, b.v) }; }
+
+		template<int n> static Avx2 shl(Avx2 a) { return { _mm256_slli_epi64(a.v, n) }; }
+		template<int n> static Avx2 shr(Avx2 a) { return { _mm256_srli_epi64(a.v, n) }; }
+
+		/*
+		* There's no 64-bit popcount before AVX-512, so each nibble is counted with a lookup table shuffle and the
+		* bytes of every lane are summed with sad.
+		*/
+		static Avx2 popcount(Avx2 a) {
+			const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+			const __m256i low = _mm256_set1_epi8(0x0F);
+			__m256i lo = _mm256_and_si256(a.v, low);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(a.v, 4), low);
+			__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo), _mm256_shuffle_epi8(table, hi));
+			return { _mm256_sad_epu8(bytes, _mm256_setzero_si256()) };
+		}
+
+	};
+
+	bool kernelAVX2(const Lanes& lanes, Targets& targets) {
+		kernel<Avx2>(lanes, targets);
+		return true;
+	}
+
+#else
+
+	bool kernelAVX2(const Lanes&, Targets&) {
+		return false;
+	}
+
+#endif
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Batch.h"
+#include "Board.h"
+
+/*
+The part of batch move generation that runs in vector lanes: pawns, knights and kings. It's a template over the
+vector type so the same code builds once with AVX2 intrinsics (BatchAVX2.cpp, compiled with AVX2 enabled) and once
+with plain 64-bit integers (Batch.cpp). Only for those two files.
+
+A vector type V holds four bitboards and provides load, store, set1, &, |, andNot (a & ~b), select (per lane,
+mask ? a : b), add, shl<n>, shr<n> and popcount (per lane).
+*/
+
+namespace Batch {
+
+	extern bool kernelAVX2(const Lanes& lanes, Targets& targets);
+
+	/**
+	 * .
+	 * Moves every bit by delta squares: positive towards H1, negative towards A8.
+	 * \param x
+	 * \return
+	 */
+	template<int delta, typename V>
+	inline V shift(V x) {
+		if constexpr (delta > 0) return V::template shl<delta>(x);
+		else return V::template shr<-delta>(x);
+	}
+
+	/**
+	 * .
+	 * Adds the moves of one direction of a leaper to its targets and count. The mask clears the columns a move
+	 * along this direction would wrap around to.
+	 * \param from
+	 * \param notOwn
+	 * \param mask
+	 * \param targets
+	 * \param count
+	 */
+	template<int delta, typename V>
+	inline void leap(V from, V notOwn, V mask, V& targets, V& count) {
+		V to = shift<delta>(from) & notOwn & mask;
+		targets = targets | to;
+		count = V::add(count, V::popcount(to));
+	}
+
+	template<typename V>
+	inline void kernel(const Lanes& in, Targets& out) {
+
+		V pieces[12];
+		for (int p = 0; p < 12; p++) pieces[p] = V::load(in.pieces[p]);
+
+		V white = V::load(in.white);
+		V enPassant = V::load(in.enPassant);
+
+		V whites = pieces[0] | pieces[1] | pieces[2] | pieces[3] | pieces[4] | pieces[5];
+		V blacks = pieces[6] | pieces[7] | pieces[8] | pieces[9] | pieces[10] | pieces[11];
+		V all = V::set1(~0ULL);
+		V empty = V::andNot(all, whites | blacks);
+
+		V opp = V::select(white, blacks, whites);
+		V notOwn = V::andNot(all, V::select(white, whites, blacks));
+
+		V P = V::select(white, pieces[0], pieces[6]);
+		V N = V::select(white, pieces[1], pieces[7]);
+		V K = V::select(white, pieces[5], pieces[11]);
+
+		V notA = V::set1(~Board::colA), notB = V::set1(~Board::colB), notG = V::set1(~Board::colG), notH = V::set1(~Board::colH);
+		V notAB = notA & notB, notGH = notG & notH;
+
+		/*
+		* Pawns. White moves towards A8 (negative shifts), black towards H1, so both are computed and each lane keeps
+		* its own side's.
+		*/
+
+		V promoRank = V::select(white, V::set1(Board::row8), V::set1(Board::row1));
+		V startRank = V::select(white, V::set1(Board::row2), V::set1(Board::row7));
+
+		V push = V::select(white, shift<-8>(P), shift<8>(P)) & empty;
+		V start = P & startRank;
+		V once = V::select(white, shift<-8>(start), shift<8>(start)) & empty;
+		V twice = V::select(white, shift<-8>(once), shift<8>(once)) & empty;
+
+		V west = V::select(white, shift<-9>(P), shift<7>(P)) & notH;
+		V east = V::select(white, shift<-7>(P), shift<9>(P)) & notA;
+
+		V pushes = V::andNot(push, promoRank);
+		V capturesWest = V::andNot(west & opp, promoRank);
+		V capturesEast = V::andNot(east & opp, promoRank);
+		V promoPush = push & promoRank;
+		V promoWest = west & opp & promoRank;
+		V promoEast = east & opp & promoRank;
+		V epWest = west & enPassant;
+		V epEast = east & enPassant;
+
+		V count = V::add(V::popcount(pushes), V::popcount(twice));
+		count = V::add(count, V::add(V::popcount(capturesWest), V::popcount(capturesEast)));
+		count = V::add(count, V::add(V::popcount(epWest), V::popcount(epEast)));
+		V promos = V::add(V::popcount(promoPush), V::add(V::popcount(promoWest), V::popcount(promoEast)));
+		count = V::add(count, V::template shl<2>(promos));
+
+		/*
+		* Knights and kings, one direction at a time. Each direction moves every piece to a different square, so
+		* adding up the bits of each direction counts every move once.
+		*/
+
+		V knights = V::set1(0);
+		leap<-17>(N, notOwn, notH, knights, count);
+		leap<-15>(N, notOwn, notA, knights, count);
+		leap<-10>(N, notOwn, notGH, knights, count);
+		leap<-6>(N, notOwn, notAB, knights, count);
+		leap<6>(N, notOwn, notGH, knights, count);
+		leap<10>(N, notOwn, notAB, knights, count);
+		leap<15>(N, notOwn, notH, knights, count);
+		leap<17>(N, notOwn, notA, knights, count);
+
+		V kings = V::set1(0);
+		leap<-9>(K, notOwn, notH, kings, count);
+		leap<-8>(K, notOwn, all, kings, count);
+		leap<-7>(K, notOwn, notA, kings, count);
+		leap<-1>(K, notOwn, notH, kings, count);
+		leap<1>(K, notOwn, notA, kings, count);
+		leap<7>(K, notOwn, notH, kings, count);
+		leap<8>(K, notOwn, all, kings, count);
+		leap<9>(K, notOwn, notA, kings, count);
+
+		V::store(out.pawnPushes, pushes);
+		V::store(out.pawnDoubles, twice);
+		V::store(out.pawnCaptures, capturesWest | capturesEast);
+		V::store(out.promotions, promoPush | promoWest | promoEast);
+		V::store(out.enPassant, epWest | epEast);
+		V::store(out.knights, knights);
+		V::store(out.kings, kings);
+		V::store(out.count, count);
+
+	}
+
+}
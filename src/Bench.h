@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace Bench {
+
+	//The built-in bench positions, as FEN. Also used as the corpus of the microbenchmarks.
+	extern const char* const positions[];
+	extern const int positionCount;
+
+	extern void bench(const std::string& input);
+
+}
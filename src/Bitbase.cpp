@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Bitbase.h"
+#include "Board.h"
+#include "FileMap.h"
+#include "Move.h"
+
+/*
+Win/draw bitbases for king and pawn, rook or queen against a lone king (KPK, KRK, KQK), built by retrograde
+analysis with the engine's own move generation and stored one bit per position: set if the side with the piece (the
+strong side) wins. The lone king can never win, so one bit is enough. KBK and KNK are always drawn and need no file.
+
+Positions are indexed with the strong side as white:
+
+index = ((strongKing * 64 + weakKing) * 64 + piece) * 2 + weakToMove
+
+which makes 2^19 positions and a 64KB file per endgame, also counting illegal ones (which are 0). A position with
+black as the strong side is looked up mirrored vertically with the colors swapped.
+
+The generator first sets up every position on the board, throws out the illegal ones, decides mates and
+stalemates, and lists the index of every legal move's result (or whether it's decided already: the piece taken,
+or for KPK a promotion, which is looked up in the KQK and KRK results). Then it sweeps all positions until nothing
+changes: strong side to move wins if one move wins, weak side to move loses if every move does. What's left is a
+draw. Each thread has its own slice of the indexes, for the setup as well as the sweeps.
+
+bitbase generate [dir] [threads] writes KQK, KRK and KPK.bitbase to dir (BitbasePath by default) and loads them.
+At runtime the files are mapped into memory read only; search uses them to stop at drawn positions and the
+evaluation to score won ones.
+*/
+
+namespace Bitbase {
+
+	std::string path{ "bitbases" };
+
+	enum Endgame : int {
+		KQK,
+		KRK,
+		KPK,
+		endgameCount
+	};
+
+	const char* const names[endgameCount] = { "KQK", "KRK", "KPK" };
+
+	//Piece number (as in Board::pieceAt) of the strong side's piece
+
+	constexpr int pieces[endgameCount] = { 4, 3, 0 };
+
+	constexpr std::uint32_t positions{ 64 * 64 * 64 * 2 };
+	constexpr std::size_t fileBytes{ positions / 8 };
+
+	constexpr std::uint32_t index(int strongKing, int weakKing, int piece, bool weakToMove) {
+		return ((std::uint32_t)(strongKing * 64 + weakKing) * 64 + piece) * 2 + weakToMove;
+	}
+
+	/*
+	* A file mapped into memory.
+	*/
+	struct Mapped {
+		const std::uint8_t* bits{ nullptr };
+		FileMap::Mapping file;
+	};
+
+	Mapped tables[endgameCount];
+
+	/**
+	 * .
+	 * Looks up the current position.
+	 * \return unknown if it isn't a bitbase endgame or the file isn't loaded
+	 */
+	Outcome probe() {
+
+		std::uint64_t white = Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK;
+		std::uint64_t black = Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+
+		if (std::popcount(white | black) != 3) return unknown;
+
+		bool strongWhite = std::popcount(white) == 2;
+		std::uint64_t minors = strongWhite ? Board::WN | Board::WB : Board::BN | Board::BB;
+
+		if (minors) return draw;
+
+		Endgame e = (strongWhite ? Board::WQ : Board::BQ) ? KQK : (strongWhite ? Board::WR : Board::BR) ? KRK : KPK;
+
+		if (!tables[e].bits) return unknown;
+
+		std::uint64_t piece = strongWhite ? Board::WQ | Board::WR | Board::WP : Board::BQ | Board::BR | Board::BP;
+		int flip = strongWhite ? 0 : 56;
+		bool weakToMove = Board::whiteTurn != strongWhite;
+
+		std::uint32_t i = index(std::countr_zero(strongWhite ? Board::WK : Board::BK) ^ flip, std::countr_zero(strongWhite ? Board::BK : Board::WK) ^ flip,
+			std::countr_zero(piece) ^ flip, weakToMove);
+
+		if (!(tables[e].bits[i / 8] >> (i % 8) & 1)) return draw;
+
+		return weakToMove ? loss : win;
+
+	}
+
+	void unmap(Mapped& m) {
+		FileMap::unmap(m.file);
+		m.bits = nullptr;
+	}
+
+	/**
+	 * .
+	 * Maps a bitbase file. Files of the wrong size are ignored.
+	 * \param file
+	 * \param m
+	 * \return
+	 */
+	bool map(const std::string& file, Mapped& m) {
+
+		if (!FileMap::map(file, m.file, FileMap::random)) return false;
+
+		if (m.file.bytes != fileBytes) {
+			FileMap::unmap(m.file);
+			return false;
+		}
+
+		m.bits = static_cast<const std::uint8_t*>(m.file.data);
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Maps the bitbase files found in a directory, replacing those loaded before. Not safe during a search.
+	 * \param dir
+	 * \return the number of files loaded
+	 */
+	int load(const std::string& dir) {
+
+		int loaded{ 0 };
+
+		for (int e = 0; e < endgameCount; e++) {
+			unmap(tables[e]);
+			if (map(dir + "/" + names[e] + ".bitbase", tables[e])) loaded++;
+		}
+
+		path = dir;
+
+		return loaded;
+
+	}
+
+	/**
+	 * .
+	 * Lists the loaded bitbases, for info string output.
+	 * \return
+	 */
+	std::string describe() {
+
+		std::string loaded;
+
+		for (int e = 0; e < endgameCount; e++) {
+			if (tables[e].bits) loaded += (loaded.empty() ? "" : " ") + std::string(names[e]);
+		}
+
+		return loaded.empty() ? "none in " + path : loaded + " from " + path;
+
+	}
+
+	/*
+	* Generation. A position's state, and the special successors that are decided without a lookup.
+	*/
+
+	enum State : std::uint8_t {
+		open,
+		won,
+		drawn,
+		illegal
+	};
+
+	constexpr std::uint32_t drawnMove{ 0xFFFFFFFF };
+	constexpr std::uint32_t wonMove{ 0xFFFFFFFE };
+
+	/*
+	* One thread's share of the positions, with the results of their legal moves: those of position i are
+	* moves[begin[i - from]] to moves[begin[i - from + 1] - 1].
+	*/
+	struct Slice {
+		std::uint32_t from{ 0 }, to{ 0 };
+		std::vector<std::uint32_t> begin;
+		std::vector<std::uint32_t> moves;
+	};
+
+	/**
+	 * .
+	 * Sets up a position of an endgame on the board. Returns false if two pieces share a square or a pawn is on
+	 * the first or last row.
+	 * \param e
+	 * \param i
+	 * \return
+	 */
+	bool setUp(Endgame e, std::uint32_t i) {
+
+		bool weakToMove = i & 1;
+		int piece = (i >> 1) % 64;
+		int weakKing = (i >> 7) % 64;
+		int strongKing = i >> 13;
+
+		if (strongKing == weakKing || piece == strongKing || piece == weakKing) return false;
+		if (e == KPK && (piece / 8 == 0 || piece / 8 == 7)) return false;
+
+		Board::clear();
+
+		std::uint64_t* boards[endgameCount] = { &Board::WQ, &Board::WR, &Board::WP };
+
+		Board::WK = 1ULL << strongKing;
+		Board::BK = 1ULL << weakKing;
+		*boards[e] = 1ULL << piece;
+
+		Board::pieceOn[strongKing] = 5;
+		Board::pieceOn[weakKing] = 11;
+		Board::pieceOn[piece] = (std::int8_t)pieces[e];
+
+		Board::whiteTurn = !weakToMove;
+		Board::hash = Board::computeHash();
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Builds one endgame.
+	 * \param e
+	 * \param solved results of the endgames built before, for promotions
+	 * \param threads
+	 * \return the state of every position (won or not after the sweeps)
+	 */
+	std::vector<std::uint8_t> build(Endgame e, const std::vector<std::uint8_t> (&solved)[endgameCount], int threads) {
+
+		std::vector<std::uint8_t> state(positions, open);
+		std::vector<Slice> slices(threads);
+		std::vector<std::thread> workers;
+
+		/*
+		* Setup: illegal positions, mates and stalemates, and the results of every legal move.
+		*/
+
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+
+				Slice& s = slices[t];
+				s.from = (std::uint32_t)((std::uint64_t)positions * t / threads);
+				s.to = (std::uint32_t)((std::uint64_t)positions * (t + 1) / threads);
+				s.begin.push_back(0);
+
+				for (std::uint32_t i = s.from; i < s.to; i++) {
+
+					if (!setUp(e, i) || Move::inCheck(!Board::whiteTurn)) {
+						state[i] = illegal;
+						s.begin.push_back((std::uint32_t)s.moves.size());
+						continue;
+					}
+
+					std::vector<std::uint16_t> moves = Move::legalMoves();
+
+					if (moves.empty()) state[i] = !Board::whiteTurn && Move::inCheck(false) ? won : drawn;
+
+					Board::State before = Board::save();
+
+					for (std::uint16_t m : moves) {
+
+						Board::makeMove(m);
+
+						std::uint32_t next;
+
+						if (Board::WP | Board::WR | Board::WQ) {
+							Endgame now = Board::WQ ? KQK : Board::WR ? KRK : KPK;
+							std::uint64_t piece = Board::WQ | Board::WR | Board::WP;
+							next = index(std::countr_zero(Board::WK), std::countr_zero(Board::BK), std::countr_zero(piece), !Board::whiteTurn);
+							if (now != e) next = solved[now][next] == won ? wonMove : drawnMove;
+						}
+						else next = drawnMove;
+
+						s.moves.push_back(next);
+
+						Board::restore(before);
+
+					}
+
+					s.begin.push_back((std::uint32_t)s.moves.size());
+
+				}
+
+			});
+		}
+
+		for (std::thread& w : workers) w.join();
+
+		/*
+		* Sweeps. Each one reads the states of the last and writes the new ones to a copy, so threads never read
+		* what another one is writing.
+		*/
+
+		for (bool changed = true; changed;) {
+
+			std::vector<std::uint8_t> next = state;
+			std::atomic<bool> any{ false };
+
+			workers.clear();
+
+			for (int t = 0; t < threads; t++) {
+				workers.emplace_back([&, t] {
+
+					const Slice& s = slices[t];
+					bool found{ false };
+
+					for (std::uint32_t i = s.from; i < s.to; i++) {
+
+						if (state[i] != open) continue;
+
+						bool weakToMove = i & 1;
+						bool allWon{ true }, anyWon{ false };
+
+						for (std::uint32_t j = s.begin[i - s.from]; j < s.begin[i - s.from + 1]; j++) {
+							std::uint32_t m = s.moves[j];
+							bool w = m == wonMove || (m != drawnMove && state[m] == won);
+							allWon &= w;
+							anyWon |= w;
+						}
+
+						if (weakToMove ? allWon : anyWon) {
+							next[i] = won;
+							found = true;
+						}
+
+					}
+
+					if (found) any = true;
+
+				});
+			}
+
+			for (std::thread& w : workers) w.join();
+
+			state.swap(next);
+			changed = any;
+
+		}
+
+		return state;
+
+	}
+
+	void generate(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name, command, dir{ path };
+		int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+		reader >> name >> command;
+
+		if (command != "generate") {
+			std::cout << "info string usage: bitbase generate [dir] [threads]" << std::endl;
+			return;
+		}
+
+		reader >> dir >> threads;
+		if (threads < 1) threads = 1;
+
+		std::error_code error;
+		std::filesystem::create_directories(dir, error);
+
+		/*
+		* Positions are only set up on the worker threads' boards, so this thread's board is left alone.
+		*/
+
+		std::vector<std::uint8_t> solved[endgameCount];
+
+		for (int e = 0; e < endgameCount; e++) {
+
+			auto start = std::chrono::steady_clock::now();
+
+			solved[e] = build((Endgame)e, solved, threads);
+
+			std::vector<std::uint8_t> bits(fileBytes, 0);
+			std::uint32_t wins{ 0 }, legal{ 0 };
+
+			for (std::uint32_t i = 0; i < positions; i++) {
+				if (solved[e][i] != illegal) legal++;
+				if (solved[e][i] == won) {
+					bits[i / 8] |= (std::uint8_t)(1 << (i % 8));
+					wins++;
+				}
+			}
+
+			/*
+			* The loaded tables may be mapped from these files and probed by a running search, so each one is written
+			* to a temporary file and renamed over the old one instead of being rewritten in place: a mapping keeps
+			* the old file's contents. Windows can't replace a mapped file, so there the old table is unmapped first.
+			*/
+
+			std::string file = dir + "/" + names[e] + ".bitbase";
+			std::string temporary = file + ".tmp";
+
+			{
+				std::ofstream out{ temporary, std::ios::binary | std::ios::trunc };
+				out.write(reinterpret_cast<const char*>(bits.data()), (std::streamsize)bits.size());
+				out.close();
+
+				std::error_code error;
+#ifdef _WIN32
+				unmap(tables[e]);
+#endif
+				if (out) std::filesystem::rename(temporary, file, error);
+
+				if (!out || error) {
+					std::remove(temporary.c_str());
+					std::cout << "info string cannot write " << file << std::endl;
+					return;
+				}
+			}
+
+			std::cout << "info string " << names[e] << " " << wins << " wins of " << legal << " legal positions in "
+				<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+
+		}
+
+		std::cout << "info string bitbases loaded: " << load(dir) << std::endl;
+
+	}
+
+}
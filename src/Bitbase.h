@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+namespace Bitbase {
+
+	/*
+	* Outcome of a position with perfect play, from the side to move's point of view.
+	*/
+	enum Outcome : int {
+		unknown,	//not a bitbase endgame, or its file isn't loaded
+		draw,
+		win,
+		loss
+	};
+
+	//Directory the bitbase files are loaded from (the BitbasePath option)
+	extern std::string path;
+
+	extern Outcome probe();
+
+	extern int load(const std::string& dir);
+
+	extern std::string describe();
+
+	extern void generate(const std::string& input);
+
+}
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <sstream>
 #include <bitset>
+#include <bit>
+#include <string>
 
 #include "Board.h"
+#include "Tables.h"
 
 /*
 Contains the representation of the board, including position, en passant, castling, 50-move draw, and moveNum.
@@ -14,73 +17,347 @@ namespace Board {
 
 	//Represents position of each type of piece. Reads from (A8) right down (H1). 
 	//A8 is rightmost when printed, H1 is leftmost when printed.
-
-	std::uint64_t WP;
-	std::uint64_t WN;
-	std::uint64_t WB;
-	std::uint64_t WR;
-	std::uint64_t WQ;
-	std::uint64_t WK;
-
-	std::uint64_t BP;
-	std::uint64_t BN;
-	std::uint64_t BB;
-	std::uint64_t BR;
-	std::uint64_t BQ;
-	std::uint64_t BK;
+	//The position is thread_local so every search or game thread works on its own board.
+
+	thread_local std::uint64_t WP;
+	thread_local std::uint64_t WN;
+	thread_local std::uint64_t WB;
+	thread_local std::uint64_t WR;
+	thread_local std::uint64_t WQ;
+	thread_local std::uint64_t WK;
+
+	thread_local std::uint64_t BP;
+	thread_local std::uint64_t BN;
+	thread_local std::uint64_t BB;
+	thread_local std::uint64_t BR;
+	thread_local std::uint64_t BQ;
+	thread_local std::uint64_t BK;
 
 	//Represents an available square which can be captured en passant
 
-	std::uint64_t enPassant;
+	thread_local std::uint64_t enPassant;
 
-	//Ignore the left 4 bits. Use the 4 helper bit flags to check or not castling rights.
+	//Ignore the left 4 bits. Use the 4 helper bit flags (in Board.h) to check or not castling rights.
 
-	std::uint8_t castlingRights;
-	std::uint8_t whiteKingside{  0b00000001 };
-	std::uint8_t whiteQueenside{ 0b00000010 };
-	std::uint8_t blackKingside{  0b00000100 };
-	std::uint8_t blackQueenside{ 0b00001000 };
+	thread_local std::uint8_t castlingRights;
 
 	//Movenum measures the amount of full moves since the game's start, starting at 1 and incremented at
 	//the end of each black move. Fiftydraw represents the number of half moves since a capture or pawn advance,
 	//and is incremented at every turn. It starts at 0.
 
-	std::uint16_t moveNum;
-	std::uint8_t fiftyDraw;
+	thread_local std::uint16_t moveNum;
+	thread_local std::uint8_t fiftyDraw;
 
 	//Represents whether it is white or black to play
 
-	bool whiteTurn;
-
-	/*
-	* Masks of each row and column. Extremely useful for legal move generation.
-	*/
-	std::uint64_t row1{ 0b11111111'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
-	std::uint64_t row2{ 0b00000000'11111111'00000000'00000000'00000000'00000000'00000000'00000000 };
-	std::uint64_t row3{ 0b00000000'00000000'11111111'00000000'00000000'00000000'00000000'00000000 };
-	std::uint64_t row4{ 0b00000000'00000000'00000000'11111111'00000000'00000000'00000000'00000000 };
-	std::uint64_t row5{ 0b00000000'00000000'00000000'00000000'11111111'00000000'00000000'00000000 };
-	std::uint64_t row6{ 0b00000000'00000000'00000000'00000000'00000000'11111111'00000000'00000000 };
-	std::uint64_t row7{ 0b00000000'00000000'00000000'00000000'00000000'00000000'11111111'00000000 };
-	std::uint64_t row8{ 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'11111111 };
-
-	std::uint64_t colA{ 0b00000001'00000001'00000001'00000001'00000001'00000001'00000001'00000001 };
-	std::uint64_t colB{ 0b00000010'00000010'00000010'00000010'00000010'00000010'00000010'00000010 };
-	std::uint64_t colC{ 0b00000100'00000100'00000100'00000100'00000100'00000100'00000100'00000100 };
-	std::uint64_t colD{ 0b00001000'00001000'00001000'00001000'00001000'00001000'00001000'00001000 };
-	std::uint64_t colE{ 0b00010000'00010000'00010000'00010000'00010000'00010000'00010000'00010000 };
-	std::uint64_t colF{ 0b00100000'00100000'00100000'00100000'00100000'00100000'00100000'00100000 };
-	std::uint64_t colG{ 0b01000000'01000000'01000000'01000000'01000000'01000000'01000000'01000000 };
-	std::uint64_t colH{ 0b10000000'10000000'10000000'10000000'10000000'10000000'10000000'10000000 };
-
-	//Represents the castling paths. Useful for movegen.
-	std::uint64_t shortPathB{ 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'01100000 };
-	std::uint64_t longPathB { 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'00001110 };
-	std::uint64_t shortPathW{ 0b01100000'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
-	std::uint64_t longPathW	{ 0b00001110'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
-
-	//An array of squares. arrOfSquares[0] = A8, arrOfSquares[63] = H1
-	std::uint64_t arrOfSquares[64];
+	thread_local bool whiteTurn;
+
+	//Counts every change to the board. Anything cached for a position (like attack maps) is only valid
+	//while the version is unchanged. It only ever goes up, even when a move is taken back.
+
+	thread_local std::uint64_t version;
+
+	//Zobrist hash of the position (see Tables::zobrist). makeMove updates it incrementally, loadFEN and clear
+	//compute it from scratch.
+
+	thread_local std::uint64_t hash;
+
+	//The piece on every square, so finding what stands on a square doesn't mean testing twelve bitboards. Every
+	//function that changes the bitboards updates it too.
+
+	thread_local std::array<std::int8_t, 64> pieceOn;
+
+	//Hashes of the positions of the game so far. Only play adds to it, so the search's makeMove and restore don't
+	//have to keep it in step; clear and loadFEN empty it.
+
+	thread_local std::vector<std::uint64_t> history;
+
+	//FEN letters of the pieces, by piece number
+
+	constexpr char pieceChars[12] = { 'P', 'N', 'B', 'R', 'Q', 'K', 'p', 'n', 'b', 'r', 'q', 'k' };
+
+	/**
+	 * .
+	 * Copies the current position so it can be restored after trying a move.
+	 * \return
+	 */
+	State save() {
+		return State{ WP, WN, WB, WR, WQ, WK, BP, BN, BB, BR, BQ, BK, enPassant, castlingRights, moveNum, fiftyDraw, whiteTurn, hash, pieceOn };
+	}
+
+	/**
+	 * .
+	 * Sets the position back to a copy taken with save().
+	 * \param s
+	 */
+	void restore(const State& s) {
+		WP = s.WP; WN = s.WN; WB = s.WB; WR = s.WR; WQ = s.WQ; WK = s.WK;
+		BP = s.BP; BN = s.BN; BB = s.BB; BR = s.BR; BQ = s.BQ; BK = s.BK;
+		enPassant = s.enPassant;
+		castlingRights = s.castlingRights;
+		moveNum = s.moveNum;
+		fiftyDraw = s.fiftyDraw;
+		whiteTurn = s.whiteTurn;
+		hash = s.hash;
+		pieceOn = s.pieceOn;
+		version++;
+	}
+
+	/**
+	 * .
+	 * Returns the piece standing on a square.
+	 * Pieces are numbered WP, WN, WB, WR, WQ, WK, BP, BN, BB, BR, BQ, BK (0-11). Returns -1 for an empty square.
+	 * \param sq
+	 * \return
+	 */
+	int pieceAt(int sq) {
+		return pieceOn[sq];
+	}
+
+	/**
+	 * .
+	 * Plays a move (in the 16 bit representation) for the side to move. The move isn't checked for legality.
+	 * Updates captures, promotions, en passant, castling, castling rights, the clocks and the turn.
+	 * \param move
+	 */
+	void makeMove(std::uint16_t move) {
+
+		int to = move & 0b111111;
+		int from = (move >> 6) & 0b111111;
+		int promo = (move >> 12) & 0b11;
+		int special = move >> 14;
+
+		std::uint64_t toBB = 1ULL << to;
+		std::uint64_t fromBB = 1ULL << from;
+
+		std::uint64_t* white[6] = { &WP, &WN, &WB, &WR, &WQ, &WK };
+		std::uint64_t* black[6] = { &BP, &BN, &BB, &BR, &BQ, &BK };
+		std::uint64_t** own = whiteTurn ? white : black;
+		std::uint64_t** opp = whiteTurn ? black : white;
+
+		//Zobrist piece indexes of the side to move and of the opponent
+		int ownBase = whiteTurn ? 0 : 6;
+		int oppBase = whiteTurn ? 6 : 0;
+		const auto& keys = Tables::zobrist;
+
+		hash ^= keys.castling[castlingRights & 0b00001111];
+		if (enPassant) hash ^= keys.enPassant[std::countr_zero(enPassant) % 8];
+
+		/*
+		* Finds the moving piece, removes whatever it captures and moves it.
+		*/
+
+		int moved = pieceOn[from] - ownBase;
+		int captured = pieceOn[to];
+
+		bool capture = captured != noPiece;
+		if (capture) {
+			*opp[captured - oppBase] &= ~toBB;
+			hash ^= keys.piece[captured][to];
+		}
+
+		*own[moved] ^= fromBB | toBB;
+		hash ^= keys.piece[ownBase + moved][from] ^ keys.piece[ownBase + moved][to];
+
+		pieceOn[to] = pieceOn[from];
+		pieceOn[from] = noPiece;
+
+		/*
+		* Promotion types are 0 - queen, 1 - knight, 2 - bishop, 3 - rook.
+		*/
+
+		if (special == 1) {
+			const int promoPiece[4] = { 4, 1, 2, 3 };
+			*own[0] &= ~toBB;
+			*own[promoPiece[promo]] |= toBB;
+			hash ^= keys.piece[ownBase][to] ^ keys.piece[ownBase + promoPiece[promo]][to];
+			pieceOn[to] = ownBase + promoPiece[promo];
+		}
+
+		/*
+		* The pawn taken en passant is on the square behind the destination.
+		*/
+
+		else if (special == 2) {
+			int taken = whiteTurn ? to + 8 : to - 8;
+			*opp[0] &= ~(1ULL << taken);
+			hash ^= keys.piece[oppBase][taken];
+			pieceOn[taken] = noPiece;
+			capture = true;
+		}
+
+		/*
+		* The king has already moved, so only the rook is left.
+		*/
+
+		else if (special == 3) {
+			switch (to) {
+			case 62: WR ^= (1ULL << 63) | (1ULL << 61); hash ^= keys.piece[3][63] ^ keys.piece[3][61]; pieceOn[63] = noPiece; pieceOn[61] = 3; break;
+			case 58: WR ^= (1ULL << 56) | (1ULL << 59); hash ^= keys.piece[3][56] ^ keys.piece[3][59]; pieceOn[56] = noPiece; pieceOn[59] = 3; break;
+			case 6: BR ^= (1ULL << 7) | (1ULL << 5); hash ^= keys.piece[9][7] ^ keys.piece[9][5]; pieceOn[7] = noPiece; pieceOn[5] = 9; break;
+			case 2: BR ^= (1ULL << 0) | (1ULL << 3); hash ^= keys.piece[9][0] ^ keys.piece[9][3]; pieceOn[0] = noPiece; pieceOn[3] = 9; break;
+			}
+		}
+
+		/*
+		* Moving the king or a rook, or capturing a rook on its starting square, removes the matching castling rights.
+		*/
+
+		std::uint64_t touched = fromBB | toBB;
+		if (touched & (1ULL << 60)) castlingRights &= ~(whiteKingside | whiteQueenside);
+		if (touched & (1ULL << 63)) castlingRights &= ~whiteKingside;
+		if (touched & (1ULL << 56)) castlingRights &= ~whiteQueenside;
+		if (touched & (1ULL << 4)) castlingRights &= ~(blackKingside | blackQueenside);
+		if (touched & (1ULL << 7)) castlingRights &= ~blackKingside;
+		if (touched & (1ULL << 0)) castlingRights &= ~blackQueenside;
+
+		enPassant = 0;
+		if (moved == 0 && (from - to == 16 || to - from == 16)) enPassant = 1ULL << ((from + to) / 2);
+
+		hash ^= keys.castling[castlingRights & 0b00001111];
+		if (enPassant) hash ^= keys.enPassant[std::countr_zero(enPassant) % 8];
+
+		if (moved == 0 || capture) fiftyDraw = 0;
+		else fiftyDraw++;
+
+		if (!whiteTurn) moveNum++;
+
+		whiteTurn = !whiteTurn;
+		hash ^= keys.blackToMove;
+
+		version++;
+
+	}
+
+	/**
+	 * .
+	 * Passes the turn without moving. Only used by the search (null-move pruning), so the move number isn't touched.
+	 */
+	void makeNullMove() {
+
+		if (enPassant) hash ^= Tables::zobrist.enPassant[std::countr_zero(enPassant) % 8];
+		enPassant = 0;
+
+		fiftyDraw++;
+
+		whiteTurn = !whiteTurn;
+		hash ^= Tables::zobrist.blackToMove;
+
+		version++;
+
+	}
+
+	/**
+	 * .
+	 * Plays a move of the game (as opposed to one tried by the search) and remembers the position it leaves in
+	 * history. Positions before a capture or pawn move can never come back, so they're dropped.
+	 * \param move
+	 */
+	void play(std::uint16_t move) {
+
+		history.push_back(hash);
+
+		makeMove(move);
+
+		if (fiftyDraw == 0) history.clear();
+
+	}
+
+	/**
+	 * .
+	 * Computes the Zobrist hash of the current position from scratch.
+	 * \return
+	 */
+	std::uint64_t computeHash() {
+
+		const std::uint64_t pieces[12] = { WP, WN, WB, WR, WQ, WK, BP, BN, BB, BR, BQ, BK };
+		const auto& keys = Tables::zobrist;
+
+		std::uint64_t h{ 0 };
+
+		for (int p = 0; p < 12; p++) {
+			for (std::uint64_t b = pieces[p]; b; b &= b - 1) h ^= keys.piece[p][std::countr_zero(b)];
+		}
+
+		h ^= keys.castling[castlingRights & 0b00001111];
+		if (enPassant) h ^= keys.enPassant[std::countr_zero(enPassant) % 8];
+		if (!whiteTurn) h ^= keys.blackToMove;
+
+		return h;
+
+	}
+
+	/**
+	 * .
+	 * Empties the board and resets castling, en passant, the clocks and the turn.
+	 */
+	void clear() {
+
+		WP = WN = WB = WR = WQ = WK = 0;
+		BP = BN = BB = BR = BQ = BK = 0;
+
+		pieceOn.fill(noPiece);
+		history.clear();
+
+		enPassant = 0;
+		castlingRights = 0;
+		moveNum = 1;
+		fiftyDraw = 0;
+		whiteTurn = true;
+
+		hash = computeHash();
+		version++;
+
+	}
+
+	/**
+	 * .
+	 * Checks that a FEN can be loaded: 8 ranks of exactly 8 squares with only piece letters and digits, one king
+	 * per side, w or b to move, castling rights of KQkq or -, and an en passant square on the third or sixth rank
+	 * or -. The clocks are optional, as in EPD. loadFEN trusts its input, so untrusted positions go through here.
+	 * \param FEN
+	 * \return
+	 */
+	bool validFEN(const std::string& FEN) {
+
+		std::string position, turn, castling, enP;
+
+		std::istringstream reader{ FEN };
+
+		if (!(reader >> position >> turn >> castling >> enP)) return false;
+
+		int rank{ 0 }, file{ 0 }, whiteKings{ 0 }, blackKings{ 0 };
+
+		for (char c : position) {
+
+			if (c == '/') {
+				if (file != 8) return false;
+				rank++;
+				file = 0;
+			}
+			else if (c >= '1' && c <= '8') file += c - '0';
+			else if (std::string{ "pnbrqkPNBRQK" }.find(c) != std::string::npos) {
+				file++;
+				if (c == 'K') whiteKings++;
+				if (c == 'k') blackKings++;
+			}
+			else return false;
+
+			if (file > 8 || rank > 7) return false;
+
+		}
+
+		if (rank != 7 || file != 8 || whiteKings != 1 || blackKings != 1) return false;
+
+		if (turn != "w" && turn != "b") return false;
+
+		if (castling != "-" && castling.find_first_not_of("KQkq") != std::string::npos) return false;
+
+		if (enP != "-" && (enP.size() != 2 || enP[0] < 'a' || enP[0] > 'h' || (enP[1] != '3' && enP[1] != '6'))) return false;
+
+		return true;
+
+	}
 
 	/**
 	 * .
@@ -99,13 +376,15 @@ namespace Board {
 		char turn{};
 		std::string castling;
 		std::string enP;
-		std::uint8_t fifDraw{};
-		std::uint16_t moveCount{};
+		int fifDraw{ 0 };
+		int moveCount{ 1 };
 
 		std::istringstream reader{ FEN };
 		
 		reader >> position >> turn >> castling >> enP >> fifDraw >> moveCount;
 
+		clear();
+
 		/*
 		* Setting the piece bitboards to the proper values. Goes through each row and finds a substring from the start
 		* to the location of the first slash (which separates rows). It goes through each column, and if it has a number,
@@ -125,18 +404,18 @@ namespace Board {
 
 				switch (row[count]) {
 				
-				case 'r': BR |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'n': BN |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'p': BP |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'q': BQ |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'k': BK |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'b': BB |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'R': WR |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'N': WN |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'P': WP |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'Q': WQ |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'K': WK |= ((std::uint64_t)pow(2, i * 8 + j)); break;
-				case 'B': WB |= ((std::uint64_t)pow(2, i * 8 + j)); break;
+				case 'r': BR |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 9; break;
+				case 'n': BN |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 7; break;
+				case 'p': BP |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 6; break;
+				case 'q': BQ |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 10; break;
+				case 'k': BK |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 11; break;
+				case 'b': BB |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 8; break;
+				case 'R': WR |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 3; break;
+				case 'N': WN |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 1; break;
+				case 'P': WP |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 0; break;
+				case 'Q': WQ |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 4; break;
+				case 'K': WK |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 5; break;
+				case 'B': WB |= arrOfSquares[i * 8 + j]; pieceOn[i * 8 + j] = 2; break;
 				default: j += (row[count] - '0') - 1;
 
 				}
@@ -180,7 +459,7 @@ namespace Board {
 
 			int col = enP[0] - 'a';
 			int row = 8-(enP[1] - '0');
-			enPassant = pow(2, row * 8 + col);
+			enPassant = arrOfSquares[row * 8 + col];
 
 		}
 
@@ -190,7 +469,68 @@ namespace Board {
 		
 		fiftyDraw = fifDraw;
 		
-		moveNum = moveCount;
+		moveNum = moveCount < 1 ? 1 : moveCount;
+
+		hash = computeHash();
+		version++;
+
+	}
+
+	/**
+	 * .
+	 * Builds the FEN string of the current board representation. Inverse of loadFEN.
+	 * \return
+	 */
+	std::string getFEN() {
+
+		std::string FEN;
+
+		/*
+		* Goes through each row from the eighth rank down, counting empty squares between pieces.
+		*/
+
+		for (int i = 0; i < 8; i++) {
+
+			int empty{ 0 };
+
+			for (int j = 0; j < 8; j++) {
+
+				int piece = pieceOn[i * 8 + j];
+
+				if (piece == noPiece) {
+					empty++;
+					continue;
+				}
+				if (empty) FEN += (char)('0' + empty);
+				empty = 0;
+				FEN += pieceChars[piece];
+
+			}
+
+			if (empty) FEN += (char)('0' + empty);
+			if (i != 7) FEN += '/';
+
+		}
+
+		FEN += whiteTurn ? " w " : " b ";
+
+		if (castlingRights & whiteKingside) FEN += 'K';
+		if (castlingRights & whiteQueenside) FEN += 'Q';
+		if (castlingRights & blackKingside) FEN += 'k';
+		if (castlingRights & blackQueenside) FEN += 'q';
+		if ((castlingRights & 0b00001111) == 0) FEN += '-';
+
+		if (enPassant) {
+			int sq = std::countr_zero(enPassant);
+			FEN += ' ';
+			FEN += (char)('a' + sq % 8);
+			FEN += (char)('0' + 8 - sq / 8);
+		}
+		else FEN += " -";
+
+		FEN += ' ' + std::to_string(fiftyDraw) + ' ' + std::to_string(moveNum);
+
+		return FEN;
 
 	}
 	
@@ -228,21 +568,9 @@ namespace Board {
 
 			for (int j = 0; j < 8; j++) {
 
-				std::uint64_t k = i * 8 + j;
-
-				if (((WP >> k) & 1) == 1) std::cout << 'P';
-				else if (((WR >> k) & 1) == 1) std::cout << 'R';
-				else if (((WB >> k) & 1) == 1) std::cout << 'B';
-				else if (((WQ >> k) & 1) == 1) std::cout << 'Q';
-				else if (((WK >> k) & 1) == 1) std::cout << 'K';
-				else if (((WN >> k) & 1) == 1) std::cout << 'N';
-				else if (((BP >> k) & 1) == 1) std::cout << 'p';
-				else if (((BN >> k) & 1) == 1) std::cout << 'n';
-				else if (((BR >> k) & 1) == 1) std::cout << 'r';
-				else if (((BK >> k) & 1) == 1) std::cout << 'k';
-				else if (((BQ >> k) & 1) == 1) std::cout << 'q';
-				else if (((BB >> k) & 1) == 1) std::cout << 'b';
-				else std::cout << " ";
+				int piece = pieceOn[i * 8 + j];
+
+				std::cout << (piece == noPiece ? ' ' : pieceChars[piece]);
 
 				std::cout << " ";
 
@@ -1,63 +1,128 @@
 #pragma once
 
+#include <array>
 #include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace Board {
 
-	extern std::uint64_t WP;
-	extern std::uint64_t WN;
-	extern std::uint64_t WB;
-	extern std::uint64_t WR;
-	extern std::uint64_t WQ;
-	extern std::uint64_t WK;
-
-	extern std::uint64_t BP;
-	extern std::uint64_t BN;
-	extern std::uint64_t BB;
-	extern std::uint64_t BR;
-	extern std::uint64_t BQ;
-	extern std::uint64_t BK;
-
-	extern std::uint64_t enPassant;
-
-	extern std::uint8_t castlingRights;
-	extern std::uint8_t whiteKingside;
-	extern std::uint8_t whiteQueenside;
-	extern std::uint8_t blackKingside;
-	extern std::uint8_t blackQueenside;
-
-	extern std::uint16_t moveNum;
-	extern std::uint8_t fiftyDraw;
-
-	extern bool whiteTurn;
-
-	extern std::uint64_t row1;
-	extern std::uint64_t row2;
-	extern std::uint64_t row3;
-	extern std::uint64_t row4;
-	extern std::uint64_t row5;
-	extern ::uint64_t row6;
-	extern std::uint64_t row7;
-	extern std::uint64_t row8;
-
-	extern std::uint64_t colA;
-	extern std::uint64_t colB;
-	extern std::uint64_t colC;
-	extern std::uint64_t colD;
-	extern std::uint64_t colE;
-	extern std::uint64_t colF;
-	extern std::uint64_t colG;
-	extern std::uint64_t colH;
-
-	extern std::uint64_t shortPathW;
-	extern std::uint64_t longPathW;
-	extern std::uint64_t shortPathB;
-	extern std::uint64_t longPathB;
-
-	extern std::uint64_t arrOfSquares[64];
+	extern thread_local std::uint64_t WP;
+	extern thread_local std::uint64_t WN;
+	extern thread_local std::uint64_t WB;
+	extern thread_local std::uint64_t WR;
+	extern thread_local std::uint64_t WQ;
+	extern thread_local std::uint64_t WK;
+
+	extern thread_local std::uint64_t BP;
+	extern thread_local std::uint64_t BN;
+	extern thread_local std::uint64_t BB;
+	extern thread_local std::uint64_t BR;
+	extern thread_local std::uint64_t BQ;
+	extern thread_local std::uint64_t BK;
+
+	extern thread_local std::uint64_t enPassant;
+
+	extern thread_local std::uint8_t castlingRights;
+	inline constexpr std::uint8_t whiteKingside{  0b00000001 };
+	inline constexpr std::uint8_t whiteQueenside{ 0b00000010 };
+	inline constexpr std::uint8_t blackKingside{  0b00000100 };
+	inline constexpr std::uint8_t blackQueenside{ 0b00001000 };
+
+	extern thread_local std::uint16_t moveNum;
+	extern thread_local std::uint8_t fiftyDraw;
+
+	extern thread_local bool whiteTurn;
+
+	extern thread_local std::uint64_t version;
+
+	extern thread_local std::uint64_t hash;
+
+	/*
+	* The piece on each square, numbered like pieceAt (WP-BK, 0-11), or noPiece. Kept in step with the bitboards.
+	*/
+	extern thread_local std::array<std::int8_t, 64> pieceOn;
+	inline constexpr std::int8_t noPiece{ -1 };
+
+	/*
+	* Hashes of the game positions played before the current one (see play), oldest first, back to the last capture
+	* or pawn move. The search checks them for repetitions.
+	*/
+	extern thread_local std::vector<std::uint64_t> history;
+
+	/*
+	* Masks of each row and column. Extremely useful for legal move generation.
+	* These are compile-time constants, so they inline into movegen instead of being loaded from memory.
+	*/
+	inline constexpr std::uint64_t row1{ 0b11111111'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t row2{ 0b00000000'11111111'00000000'00000000'00000000'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t row3{ 0b00000000'00000000'11111111'00000000'00000000'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t row4{ 0b00000000'00000000'00000000'11111111'00000000'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t row5{ 0b00000000'00000000'00000000'00000000'11111111'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t row6{ 0b00000000'00000000'00000000'00000000'00000000'11111111'00000000'00000000 };
+	inline constexpr std::uint64_t row7{ 0b00000000'00000000'00000000'00000000'00000000'00000000'11111111'00000000 };
+	inline constexpr std::uint64_t row8{ 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'11111111 };
+
+	inline constexpr std::uint64_t colA{ 0b00000001'00000001'00000001'00000001'00000001'00000001'00000001'00000001 };
+	inline constexpr std::uint64_t colB{ 0b00000010'00000010'00000010'00000010'00000010'00000010'00000010'00000010 };
+	inline constexpr std::uint64_t colC{ 0b00000100'00000100'00000100'00000100'00000100'00000100'00000100'00000100 };
+	inline constexpr std::uint64_t colD{ 0b00001000'00001000'00001000'00001000'00001000'00001000'00001000'00001000 };
+	inline constexpr std::uint64_t colE{ 0b00010000'00010000'00010000'00010000'00010000'00010000'00010000'00010000 };
+	inline constexpr std::uint64_t colF{ 0b00100000'00100000'00100000'00100000'00100000'00100000'00100000'00100000 };
+	inline constexpr std::uint64_t colG{ 0b01000000'01000000'01000000'01000000'01000000'01000000'01000000'01000000 };
+	inline constexpr std::uint64_t colH{ 0b10000000'10000000'10000000'10000000'10000000'10000000'10000000'10000000 };
+
+	//Represents the castling paths. Useful for movegen.
+	inline constexpr std::uint64_t shortPathB{ 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'01100000 };
+	inline constexpr std::uint64_t longPathB { 0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'00001110 };
+	inline constexpr std::uint64_t shortPathW{ 0b01100000'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
+	inline constexpr std::uint64_t longPathW	{ 0b00001110'00000000'00000000'00000000'00000000'00000000'00000000'00000000 };
+
+	//An array of squares. arrOfSquares[0] = A8, arrOfSquares[63] = H1
+	inline constexpr std::array<std::uint64_t, 64> arrOfSquares = [] {
+		std::array<std::uint64_t, 64> squares{};
+		for (int i = 0; i < 64; i++) squares[i] = 1ULL << i;
+		return squares;
+	}();
+
+	/*
+	* A copy of everything that makes up a position. Used to take back moves (copy-make).
+	*/
+	struct State {
+		std::uint64_t WP, WN, WB, WR, WQ, WK;
+		std::uint64_t BP, BN, BB, BR, BQ, BK;
+		std::uint64_t enPassant;
+		std::uint8_t castlingRights;
+		std::uint16_t moveNum;
+		std::uint8_t fiftyDraw;
+		bool whiteTurn;
+		std::uint64_t hash;
+		std::array<std::int8_t, 64> pieceOn;
+	};
+
+	extern State save();
+
+	extern void restore(const State& s);
+
+	extern int pieceAt(int sq);
+
+	extern void makeMove(std::uint16_t move);
+
+	extern void makeNullMove();
+
+	extern void play(std::uint16_t move);
+
+	extern std::uint64_t computeHash();
+
+	extern void clear();
+
+	extern bool validFEN(const std::string& FEN);
 
 	extern void loadFEN(std::string FEN);
 
+	extern std::string getFEN();
+
 	extern void printBoard();
 
 }
@@ -0,0 +1,701 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Cluster.h"
+#include "Board.h"
+#include "Move.h"
+#include "TT.h"
+
+/*
+Search spread over several engine processes, which can be on other machines or in other containers.
+
+A worker is this engine started with "cluster worker <address> [threads] [hash]". It listens on a Unix domain
+socket, or on TCP if the address is host:port, and serves one coordinator at a time. The coordinator is the engine
+the GUI talks to, with the ClusterWorkers option set to a comma separated list of worker addresses (or with
+"cluster spawn <n>", which starts n local workers on Unix sockets, for testing on one machine). While it has
+workers, go searches on them instead of locally.
+
+The coordinator runs the iterative deepening. Every iteration the root moves are dealt out round robin, best moves
+of the last iteration first, so every worker gets a mix of likely and unlikely moves. Each worker searches its own
+root moves to the iteration's depth (a search that excludes the other root moves) and answers with its best move,
+score and pv, and with its deepest transposition table entries. Those are handed to the other workers before the
+next iteration, so a subtree one process searched is a table hit for the others. An iteration counts only if
+every worker finished it. A worker that drops out is forgotten and the iteration is dealt again to the rest; with
+none left the search continues locally.
+
+The protocol is one line of text per message, between builds of the same engine (moves travel in the 16-bit
+representation):
+
+coordinator		hello <protocol>
+				fen <FEN>
+				history <hash>...			the game's earlier positions, for repetitions
+				tt <check>:<data>...		table entries of the other workers, in hex
+				search <depth> <movetime> <nodes> <move>...
+				clear
+worker			hello <protocol>
+				tt <check>:<data>...
+				result <depth> <score> <nodes> <complete> <move>...
+*/
+
+namespace Cluster {
+
+	constexpr int protocol{ 1 };
+
+	//Most table entries a worker shares per iteration, and how far below the iteration's depth they can be
+
+	constexpr std::size_t shareEntries{ 4096 };
+	constexpr int shareBelow{ 4 };
+
+	/*
+	* A connection to a worker, with what it has sent but not been read yet.
+	*/
+	struct Peer {
+		std::string address;
+		int fd{ -1 };
+		std::string pending;
+		std::string shared;		//the table entries of its last answer
+	};
+
+	std::vector<Peer> peers;
+
+#ifndef _WIN32
+
+	/**
+	 * .
+	 * Opens a socket to an address, or to listen on it. A host:port address is TCP, anything else a Unix domain
+	 * socket path. Returns -1 on failure.
+	 * \param address
+	 * \param server
+	 * \return
+	 */
+	int open(const std::string& address, bool server) {
+
+		std::size_t colon = address.rfind(':');
+
+		if (colon == std::string::npos || address.find('/') != std::string::npos) {
+
+			sockaddr_un where{};
+			where.sun_family = AF_UNIX;
+			if (address.size() >= sizeof(where.sun_path)) return -1;
+			address.copy(where.sun_path, address.size());
+
+			int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0) return -1;
+
+			if (server) ::unlink(address.c_str());
+
+			bool ok = server ? ::bind(fd, (sockaddr*)&where, sizeof(where)) == 0 && ::listen(fd, 4) == 0
+				: ::connect(fd, (sockaddr*)&where, sizeof(where)) == 0;
+
+			if (!ok) {
+				::close(fd);
+				return -1;
+			}
+
+			return fd;
+
+		}
+
+		addrinfo hints{}, * found{ nullptr };
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = server ? AI_PASSIVE : 0;
+
+		std::string host = address.substr(0, colon);
+		std::string port = address.substr(colon + 1);
+
+		if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) return -1;
+
+		int fd{ -1 };
+
+		for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+
+			fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+			if (fd < 0) continue;
+
+			//Messages are small and answered right away, so they shouldn't wait to be batched (Nagle)
+
+			int yes{ 1 };
+			if (server) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+			else ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+			bool ok = server ? ::bind(fd, a->ai_addr, a->ai_addrlen) == 0 && ::listen(fd, 4) == 0
+				: ::connect(fd, a->ai_addr, a->ai_addrlen) == 0;
+
+			if (!ok) {
+				::close(fd);
+				fd = -1;
+			}
+
+		}
+
+		::freeaddrinfo(found);
+
+		return fd;
+
+	}
+
+	bool send(int fd, const std::string& line) {
+
+		std::string data = line + '\n';
+
+		for (std::size_t sent = 0; sent < data.size();) {
+			ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0) return false;
+			sent += n;
+		}
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Reads the next line from a connection. Returns false when it's closed.
+	 * \param fd
+	 * \param pending
+	 * \param line
+	 * \return
+	 */
+	bool receive(int fd, std::string& pending, std::string& line) {
+
+		char buffer[65536];
+
+		while (true) {
+
+			std::size_t end = pending.find('\n');
+
+			if (end != std::string::npos) {
+				line = pending.substr(0, end);
+				pending.erase(0, end + 1);
+				return true;
+			}
+
+			ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+			if (n <= 0) return false;
+
+			pending.append(buffer, n);
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Table entries as "<check>:<data>" in hex, separated by spaces.
+	 * \param entries
+	 * \return
+	 */
+	std::string encode(const std::vector<TT::Entry>& entries) {
+
+		std::ostringstream out;
+		out << std::hex;
+
+		for (const TT::Entry& e : entries) out << ' ' << e.check << ':' << e.data;
+
+		return out.str();
+
+	}
+
+	void decode(const std::string& text, TT::Table& table) {
+
+		std::istringstream reader{ text };
+		std::string token;
+
+		while (reader >> token) {
+			std::size_t colon = token.find(':');
+			if (colon == std::string::npos) continue;
+			TT::Entry e{ std::strtoull(token.c_str(), nullptr, 16), std::strtoull(token.c_str() + colon + 1, nullptr, 16) };
+			table.merge(e);
+		}
+
+	}
+
+	void drop(Peer& peer) {
+		if (peer.fd >= 0) ::close(peer.fd);
+		peer.fd = -1;
+		std::cout << "info string cluster worker " << peer.address << " dropped" << std::endl;
+	}
+
+	/**
+	 * .
+	 * Sends a line to a worker, dropping it if the connection is gone.
+	 * \param peer
+	 * \param line
+	 * \return
+	 */
+	bool tell(Peer& peer, const std::string& line) {
+		if (peer.fd < 0) return false;
+		if (send(peer.fd, line)) return true;
+		drop(peer);
+		return false;
+	}
+
+	/**
+	 * .
+	 * Serves one coordinator until it disconnects.
+	 * \param fd
+	 */
+	void serve(int fd) {
+
+		std::string pending, line;
+
+		while (receive(fd, pending, line)) {
+
+			std::istringstream reader{ line };
+			std::string kind;
+			reader >> kind;
+
+			if (kind == "hello") {
+				if (!send(fd, "hello " + std::to_string(protocol))) return;
+			}
+			else if (kind == "fen") {
+
+				//A coordinator that sends a position that can't be loaded is broken, so it's dropped
+
+				std::string fen = line.size() > 4 ? line.substr(4) : "";
+
+				if (!Board::validFEN(fen)) {
+					std::cout << "info string cluster invalid fen from coordinator" << std::endl;
+					return;
+				}
+
+				Board::loadFEN(fen);
+
+			}
+			else if (kind == "history") {
+				std::string hash;
+				while (reader >> hash) Board::history.push_back(std::strtoull(hash.c_str(), nullptr, 16));
+			}
+			else if (kind == "tt") {
+				decode(line.substr(2), TT::table);
+			}
+			else if (kind == "clear") {
+				Search::clear();
+			}
+			else if (kind == "search") {
+
+				/*
+				* Searches only the moves given: every other legal root move is excluded. The search plays on a copy
+				* of the position so the next search starts from the same one.
+				*/
+
+				Search::Limits limits;
+				int move{ 0 };
+
+				reader >> limits.depth >> limits.movetime >> limits.nodes;
+
+				std::vector<std::uint16_t> mine;
+				while (reader >> move) mine.push_back((std::uint16_t)move);
+
+				for (std::uint16_t m : Move::legalMoves()) {
+					if (std::find(mine.begin(), mine.end(), m) == mine.end()) limits.exclude.push_back(m);
+				}
+
+				Board::State state = Board::save();
+				std::vector<std::uint64_t> history = Board::history;
+
+				Search::Result result = Search::search(limits, false);
+
+				Board::restore(state);
+				Board::history = std::move(history);
+
+				bool mate = result.score > Search::mateScore - Search::maxPly || result.score < -Search::mateScore + Search::maxPly;
+				bool complete = result.depth >= limits.depth || mate;
+
+				std::ostringstream out;
+				out << "result " << result.depth << ' ' << result.score << ' ' << result.nodes << ' ' << complete;
+				for (std::uint16_t m : result.pv) out << ' ' << m;
+
+				std::vector<TT::Entry> deep = TT::table.deepest(std::max(1, result.depth - shareBelow), shareEntries);
+
+				if (!send(fd, "tt" + encode(deep)) || !send(fd, out.str())) return;
+
+			}
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Runs a worker: listens on an address and serves the coordinators that connect, one at a time. With once, it
+	 * exits after the first one disconnects (workers started by cluster spawn).
+	 * \param address
+	 * \param threads
+	 * \param hash
+	 * \param once
+	 */
+	void work(const std::string& address, int threads, int hash, bool once) {
+
+		int server = open(address, true);
+
+		if (server < 0) {
+			std::cout << "info string cannot listen on " << address << std::endl;
+			return;
+		}
+
+		Search::options.threads = threads;
+		Search::options.hash = hash;
+		TT::table.resize(hash);
+
+		std::cout << "info string cluster worker on " << address << ", " << threads << " threads, " << hash << " MB" << std::endl;
+
+		do {
+
+			int coordinator = ::accept(server, nullptr, nullptr);
+			if (coordinator < 0) continue;
+
+			int yes{ 1 };
+			::setsockopt(coordinator, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+			serve(coordinator);
+			::close(coordinator);
+
+		} while (!once);
+
+		::close(server);
+		if (address.find(':') == std::string::npos || address.find('/') != std::string::npos) ::unlink(address.c_str());
+
+	}
+
+	/**
+	 * .
+	 * Connects to a worker and checks it speaks the same protocol.
+	 * \param address
+	 * \return
+	 */
+	bool join(const std::string& address) {
+
+		Peer peer{ address, open(address, false), {}, {} };
+
+		std::string line;
+
+		if (peer.fd < 0 || !send(peer.fd, "hello " + std::to_string(protocol)) || !receive(peer.fd, peer.pending, line)
+			|| line != "hello " + std::to_string(protocol)) {
+			if (peer.fd >= 0) ::close(peer.fd);
+			return false;
+		}
+
+		peers.push_back(std::move(peer));
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Starts local workers on Unix sockets and connects to them.
+	 * \param count
+	 * \param threads
+	 * \param hash
+	 */
+	void spawn(int count, int threads, int hash) {
+
+		for (int i = 0; i < count; i++) {
+
+			std::string address = "/tmp/gorilla-cluster-" + std::to_string(::getpid()) + "-" + std::to_string(peers.size()) + ".sock";
+			std::string threadArg = std::to_string(threads), hashArg = std::to_string(hash);
+
+			::unlink(address.c_str());
+
+			pid_t pid = ::fork();
+
+			if (pid == 0) {
+				const char* args[] = { "GorillaChess", "cluster", "worker", address.c_str(), threadArg.c_str(), hashArg.c_str(), "once", nullptr };
+				::execv("/proc/self/exe", const_cast<char* const*>(args));
+				std::_Exit(1);
+			}
+
+			if (pid < 0) {
+				std::cout << "info string cannot start a cluster worker" << std::endl;
+				return;
+			}
+
+			/*
+			* The worker needs a moment to start listening.
+			*/
+
+			bool joined{ false };
+
+			for (int tries = 0; tries < 100 && !joined; tries++) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				joined = join(address);
+			}
+
+			if (!joined) {
+				std::cout << "info string cannot join cluster worker " << address << std::endl;
+				return;
+			}
+
+		}
+
+	}
+
+#endif
+
+	bool active() {
+		return !peers.empty();
+	}
+
+	/**
+	 * .
+	 * Replaces the workers with the ones at the given comma separated addresses.
+	 * \param addresses
+	 */
+	void connect(const std::string& addresses) {
+
+#ifndef _WIN32
+		for (Peer& peer : peers) if (peer.fd >= 0) ::close(peer.fd);
+		peers.clear();
+
+		std::istringstream reader{ addresses };
+		std::string address;
+
+		while (std::getline(reader, address, ',')) {
+			address.erase(0, address.find_first_not_of(' '));
+			address.erase(address.find_last_not_of(' ') + 1);
+			if (!address.empty() && !join(address)) std::cout << "info string cannot join cluster worker " << address << std::endl;
+		}
+
+		std::cout << "info string cluster of " << peers.size() << " workers" << std::endl;
+#else
+		if (!addresses.empty()) std::cout << "info string cluster mode is not supported on this platform" << std::endl;
+#endif
+
+	}
+
+	void clear() {
+#ifndef _WIN32
+		for (Peer& peer : peers) tell(peer, "clear");
+		std::erase_if(peers, [](const Peer& p) { return p.fd < 0; });
+#endif
+	}
+
+	/**
+	 * .
+	 * Searches the current position on the workers. Falls back to a local search without them.
+	 * \param limits
+	 * \param print
+	 * \return
+	 */
+	Search::Result search(const Search::Limits& limits, bool print) {
+
+		Search::Result result;
+		Search::Limits rest = limits;
+
+#ifndef _WIN32
+		auto start = std::chrono::steady_clock::now();
+		auto elapsed = [&] { return (std::int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(); };
+
+		std::vector<std::uint16_t> order;
+		for (std::uint16_t m : Move::legalMoves()) {
+			if (std::find(limits.exclude.begin(), limits.exclude.end(), m) == limits.exclude.end()) order.push_back(m);
+		}
+
+		/*
+		* Every worker gets the position, with the game's history for repetitions.
+		*/
+
+		std::ostringstream history;
+		history << "history" << std::hex;
+		for (std::uint64_t h : Board::history) history << ' ' << h;
+
+		for (Peer& peer : peers) {
+			peer.shared.clear();
+			if (tell(peer, "fen " + Board::getFEN())) tell(peer, history.str());
+		}
+
+		std::erase_if(peers, [](const Peer& p) { return p.fd < 0; });
+
+		std::uint64_t nodes{ 0 };
+
+		for (int depth = 1; !order.empty() && !peers.empty() && depth <= limits.depth && depth < Search::maxPly; depth++) {
+
+			if (depth > 1 && limits.movetime && elapsed() >= limits.movetime) break;
+			if (depth > 1 && limits.nodes && nodes >= limits.nodes) break;
+
+			std::size_t count = std::min(peers.size(), order.size());
+
+			int movetime = limits.movetime ? std::max(1, limits.movetime - (int)elapsed()) : 0;
+			std::uint64_t nodeShare = limits.nodes ? std::max<std::uint64_t>(1, (limits.nodes - std::min(nodes, limits.nodes)) / count) : 0;
+
+			/*
+			* Hands every worker the others' table entries from the last iteration, then its root moves.
+			*/
+
+			for (std::size_t w = 0; w < count; w++) {
+
+				std::string shared;
+				for (std::size_t other = 0; other < peers.size(); other++) if (other != w) shared += peers[other].shared;
+				if (!shared.empty()) tell(peers[w], "tt" + shared);
+
+				std::ostringstream line;
+				line << "search " << depth << ' ' << movetime << ' ' << nodeShare;
+				for (std::size_t i = w; i < order.size(); i += count) line << ' ' << order[i];
+
+				tell(peers[w], line.str());
+
+			}
+
+			/*
+			* Collects the answers. Each is the best of its worker's root moves.
+			*/
+
+			std::vector<std::pair<int, std::vector<std::uint16_t>>> answers;
+			bool complete{ true };
+			bool lost{ false };
+
+			for (std::size_t w = 0; w < count; w++) {
+
+				Peer& peer = peers[w];
+				std::string line;
+
+				while (peer.fd >= 0) {
+
+					if (!receive(peer.fd, peer.pending, line)) {
+						drop(peer);
+						break;
+					}
+
+					if (line.rfind("tt", 0) == 0) peer.shared = line.substr(2);
+					else if (line.rfind("result ", 0) == 0) break;
+
+				}
+
+				if (peer.fd < 0) {
+					lost = true;
+					continue;
+				}
+
+				std::istringstream reader{ line.substr(7) };
+				int reached{ 0 }, score{ 0 }, move{ 0 }, done{ 0 };
+				std::uint64_t workerNodes{ 0 };
+				std::vector<std::uint16_t> pv;
+
+				reader >> reached >> score >> workerNodes >> done;
+				while (reader >> move) pv.push_back((std::uint16_t)move);
+
+				nodes += workerNodes;
+				if (!done) complete = false;
+				if (!pv.empty()) answers.push_back({ score, pv });
+
+			}
+
+			/*
+			* A worker that dropped out took its moves with it, so the iteration is dealt again to the others.
+			*/
+
+			if (lost) {
+				std::erase_if(peers, [](const Peer& p) { return p.fd < 0; });
+				depth--;
+				continue;
+			}
+
+			if (answers.empty() || (!complete && depth > 1)) break;
+
+			std::stable_sort(answers.begin(), answers.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+			result.bestMove = answers[0].second[0];
+			result.pv = answers[0].second;
+			result.score = answers[0].first;
+			result.depth = depth;
+			result.nodes = nodes;
+			result.time = elapsed();
+
+			if (print) Search::printInfo(result);
+
+			/*
+			* The next iteration deals the workers' best moves first, best to worst, then the rest as they were.
+			*/
+
+			std::vector<std::uint16_t> next;
+			for (const auto& answer : answers) next.push_back(answer.second[0]);
+			for (std::uint16_t m : order) if (std::find(next.begin(), next.end(), m) == next.end()) next.push_back(m);
+			order = std::move(next);
+
+			if (!complete) break;
+			if (result.score > Search::mateScore - Search::maxPly || result.score < -Search::mateScore + Search::maxPly) break;
+
+		}
+
+		if (result.bestMove) {
+			result.nodes = nodes;
+			result.time = elapsed();
+			return result;
+		}
+
+		if (!order.empty()) std::cout << "info string cluster has no workers left, searching locally" << std::endl;
+
+		if (rest.movetime) rest.movetime = std::max(1, limits.movetime - (int)elapsed());
+#endif
+
+		return Search::search(rest, print);
+
+	}
+
+	/**
+	 * .
+	 * Runs the cluster command: cluster worker <address> [threads] [hash] [once], cluster spawn <n> [threads] [hash].
+	 * \param input
+	 */
+	void command(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name, action;
+		int threads{ 1 }, hash{ 64 };
+
+		reader >> name >> action;
+
+#ifndef _WIN32
+		if (action == "worker") {
+
+			std::string address, once;
+			reader >> address;
+			if (!(reader >> threads)) reader.clear();
+			if (!(reader >> hash)) reader.clear();
+			reader >> once;
+
+			if (address.empty()) std::cout << "info string usage: cluster worker <address> [threads] [hash] [once]" << std::endl;
+			else work(address, std::clamp(threads, 1, 256), std::clamp(hash, 1, 65536), once == "once");
+
+		}
+		else if (action == "spawn") {
+
+			int count{ 0 };
+			reader >> count;
+			if (!(reader >> threads)) reader.clear();
+			if (!(reader >> hash)) reader.clear();
+
+			::signal(SIGCHLD, SIG_IGN);
+			spawn(std::clamp(count, 0, 256), std::clamp(threads, 1, 256), std::clamp(hash, 1, 65536));
+
+			std::cout << "info string cluster of " << peers.size() << " workers" << std::endl;
+
+		}
+		else std::cout << "info string usage: cluster worker <address> [threads] [hash] [once] | cluster spawn <n> [threads] [hash]" << std::endl;
+#else
+		std::cout << "info string cluster mode is not supported on this platform" << std::endl;
+#endif
+
+	}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "Search.h"
+
+namespace Cluster {
+
+	extern bool active();
+
+	extern void connect(const std::string& addresses);
+
+	extern Search::Result search(const Search::Limits& limits, bool print);
+
+	extern void clear();
+
+	extern void command(const std::string& input);
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+/*
+What the CPU running the engine supports, for code with a separate AVX2 build (BatchAVX2.cpp, AttackAVX2.cpp)
+that may only run where the instructions exist.
+*/
+
+namespace Cpu {
+
+	/**
+	 * .
+	 * Checks if the CPU (and on Windows, the OS) supports AVX2.
+	 * \return
+	 */
+	inline bool hasAVX2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && defined(_M_X64)
+		int info[4];
+		__cpuid(info, 1);
+		if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return info[1] & (1 << 5);
+#else
+		return false;
+#endif
+	}
+
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "EPD.h"
+#include "Batch.h"
+#include "Board.h"
+#include "Move.h"
+#include "Search.h"
+#include "TT.h"
+
+/*
+Runs EPD test suites. Positions are streamed from the file and handed out to worker threads, each of which sets
+up the position on its own (thread_local) board. Search suites use the bm/am opcodes, perft suites use either
+"perft D n" or the ";D1 20 ;D2 400" style; perft is counted with Batch::perft. Entries whose FEN can't be loaded are reported and skipped.
+*/
+
+namespace EPD {
+
+	/**
+	 * .
+	 * Checks if a string is a non-negative integer.
+	 * \param s
+	 * \return
+	 */
+	bool isNumber(const std::string& s) {
+		return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+	}
+
+	/**
+	 * .
+	 * Removes check, mate and annotation marks so SAN moves can be compared.
+	 * \param san
+	 * \return
+	 */
+	std::string stripSAN(std::string san) {
+		while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) san.pop_back();
+		return san;
+	}
+
+	/**
+	 * .
+	 * Splits an EPD line into the FEN and its opcodes. The first four fields are the position; if they're followed
+	 * by two numbers those are taken as the clocks. Returns false for blank lines and comments.
+	 * \param line
+	 * \param entry
+	 * \return
+	 */
+	bool parse(const std::string& line, Entry& entry) {
+
+		entry = Entry{};
+
+		std::istringstream reader{ line };
+		std::string fields[4];
+
+		reader >> fields[0] >> fields[1] >> fields[2] >> fields[3];
+
+		if (fields[3].empty() || fields[0][0] == '#') return false;
+
+		std::string rest;
+		std::getline(reader, rest);
+
+		/*
+		* Takes the clocks if they're there.
+		*/
+
+		std::istringstream clocks{ rest };
+		std::string half, full;
+		clocks >> half >> full;
+
+		entry.fen = fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3];
+
+		if (isNumber(half) && isNumber(full)) {
+			entry.fen += ' ' + half + ' ' + full;
+			std::getline(clocks, rest);
+		}
+		else entry.fen += " 0 1";
+
+		/*
+		* Goes through the opcodes, which are separated by semicolons.
+		*/
+
+		std::istringstream ops{ rest };
+		std::string op;
+
+		while (std::getline(ops, op, ';')) {
+
+			std::istringstream opReader{ op };
+			std::string name;
+			opReader >> name;
+
+			if (name.empty()) continue;
+
+			if (name == "bm" || name == "am") {
+				std::string move;
+				while (opReader >> move) (name == "bm" ? entry.bm : entry.am).push_back(stripSAN(move));
+			}
+			else if (name == "id") {
+				std::getline(opReader, entry.id);
+				entry.id.erase(0, entry.id.find_first_not_of(" \""));
+				entry.id.erase(entry.id.find_last_not_of(" \"") + 1);
+			}
+			else if (name == "perft") {
+				int depth{ 0 };
+				std::uint64_t count{ 0 };
+				if (opReader >> depth >> count) entry.perft.push_back({ depth, count });
+			}
+			else if (name[0] == 'D' && isNumber(name.substr(1))) {
+				std::uint64_t count{ 0 };
+				if (opReader >> count) entry.perft.push_back({ std::stoi(name.substr(1)), count });
+			}
+
+		}
+
+		std::sort(entry.perft.begin(), entry.perft.end());
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Runs an EPD suite on several threads and reports each position as it finishes, then the totals.
+	 * \param file
+	 * \param limit a node count, or a time per position ending in "ms" (e.g. 500ms)
+	 * \param threads
+	 */
+	void bench(const std::string& file, const std::string& limit, int threads) {
+
+		std::ifstream in{ file };
+
+		if (!in) {
+			std::cout << "info string cannot open " << file << std::endl;
+			return;
+		}
+
+		Search::Limits limits;
+		if (limit.size() > 2 && limit.substr(limit.size() - 2) == "ms") limits.movetime = std::atoi(limit.c_str());
+		else limits.nodes = std::strtoull(limit.c_str(), nullptr, 10);
+
+		if (threads < 1) threads = 1;
+
+		std::mutex inLock, outLock;
+		int next{ 0 };
+
+		std::atomic<int> positions{ 0 }, searched{ 0 }, solved{ 0 }, perftPassed{ 0 }, perftFailed{ 0 }, invalid{ 0 };
+		std::atomic<std::uint64_t> totalNodes{ 0 };
+
+		/*
+		* The options are thread_local, so each worker starts from a copy of the caller's (Hash, Contempt, ...).
+		* Every worker searches a position on its own thread.
+		*/
+
+		Search::Options options = Search::options;
+		options.threads = 1;
+
+		auto start = std::chrono::steady_clock::now();
+
+		/*
+		* Each worker reads the next position under the lock, then works on it alone.
+		*/
+
+		auto worker = [&]() {
+
+			Search::options = options;
+
+			TT::Table table;
+			Search::table = &table;
+
+			while (true) {
+
+				Entry entry;
+				int index{ 0 };
+
+				{
+					std::lock_guard<std::mutex> guard{ inLock };
+					std::string line;
+					bool found{ false };
+					while (!found && std::getline(in, line)) found = parse(line, entry);
+					if (!found) return;
+					index = ++next;
+				}
+
+				if (!Board::validFEN(entry.fen)) {
+					invalid++;
+					std::lock_guard<std::mutex> guard{ outLock };
+					std::cout << std::setw(5) << index << ' ' << (entry.id.empty() ? "-" : entry.id) << " invalid fen" << std::endl;
+					continue;
+				}
+
+				Board::loadFEN(entry.fen);
+
+				auto posStart = std::chrono::steady_clock::now();
+				std::ostringstream report;
+				std::uint64_t posNodes{ 0 };
+
+				if (!entry.perft.empty()) {
+
+					bool ok{ true };
+
+					for (const auto& [depth, expected] : entry.perft) {
+						std::uint64_t count = Batch::perft(depth);
+						posNodes += count;
+						if (count != expected) {
+							ok = false;
+							report << " D" << depth << " " << count << " expected " << expected;
+						}
+					}
+
+					(ok ? perftPassed : perftFailed)++;
+					report << (ok ? " perft ok" : "");
+
+				}
+				else {
+
+					Search::clear();
+
+					Search::Result result = Search::search(limits, false);
+					posNodes = result.nodes;
+
+					std::string played = result.bestMove ? stripSAN(Move::toSAN(result.bestMove)) : "(none)";
+
+					bool good{ !entry.bm.empty() || !entry.am.empty() };
+					if (!entry.bm.empty() && std::find(entry.bm.begin(), entry.bm.end(), played) == entry.bm.end()) good = false;
+					if (std::find(entry.am.begin(), entry.am.end(), played) != entry.am.end()) good = false;
+
+					searched++;
+					if (good) solved++;
+
+					report << (good ? " solved" : " failed") << " played " << played;
+					if (!entry.bm.empty()) report << " bm";
+					for (const std::string& m : entry.bm) report << ' ' << m;
+					if (!entry.am.empty()) report << " am";
+					for (const std::string& m : entry.am) report << ' ' << m;
+					report << " depth " << result.depth;
+
+				}
+
+				auto posTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - posStart).count();
+
+				positions++;
+				totalNodes += posNodes;
+
+				std::lock_guard<std::mutex> guard{ outLock };
+				std::cout << std::setw(5) << index << ' ' << (entry.id.empty() ? "-" : entry.id) << report.str()
+					<< " nodes " << posNodes << " time " << posTime << "ms" << std::endl;
+
+			}
+
+		};
+
+		std::vector<std::thread> pool;
+		for (int i = 0; i < threads; i++) pool.emplace_back(worker);
+		for (std::thread& t : pool) t.join();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "positions " << positions << " threads " << threads << " time " << std::fixed << std::setprecision(2) << seconds << "s\n";
+		if (searched) std::cout << "solved " << solved << '/' << searched << " (" << std::setprecision(1) << 100.0 * solved / searched << "%)\n";
+		if (perftPassed + perftFailed) std::cout << "perft passed " << perftPassed << '/' << perftPassed + perftFailed << '\n';
+		if (invalid) std::cout << "invalid fen " << invalid << " (skipped)\n";
+		std::cout << "nodes " << totalNodes << " nps " << (std::uint64_t)(totalNodes / (seconds > 0 ? seconds : 1))
+			<< " positions/s " << std::setprecision(2) << positions / (seconds > 0 ? seconds : 1) << std::endl;
+
+		std::cout.unsetf(std::ios::fixed);
+
+	}
+
+}
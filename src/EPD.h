@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EPD {
+
+	/*
+	* One line of an EPD file. Only the opcodes the engine uses are kept.
+	*/
+	struct Entry {
+		std::string fen;
+		std::string id;
+		std::vector<std::string> bm;
+		std::vector<std::string> am;
+		std::vector<std::pair<int, std::uint64_t>> perft;
+	};
+
+	extern bool parse(const std::string& line, Entry& entry);
+
+	extern void bench(const std::string& file, const std::string& limit, int threads);
+
+}
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Eval.h"
+#include "Bitbase.h"
+#include "Board.h"
+#include "Magic.h"
+#include "Stats.h"
+#include "Tables.h"
+
+/*
+Static evaluation of the board representation: material and piece-square tables, then mobility, king safety
+(attacks on the squares around the king and the pawn shield in front of it), passed pawns and the bishop pair.
+Scores are in centipawns from the point of view of the side to move.
+
+Every term is a parameter from params times a count, so the values can be tuned without touching the code.
+
+Material and piece-square values are cheap; the rest needs the slider attacks of every piece. When the cheap part is
+so far outside the alpha-beta window that the rest can't bring it back (lazyMargin), it's returned on its own.
+Full evaluations are kept in a small per-thread cache keyed by the Zobrist hash, so transpositions and re-searches
+of a position don't evaluate it again. Endgames covered by the bitbases are scored from them instead.
+*/
+
+namespace Eval {
+
+	/*
+	* Values of P, N, B, R, Q, K.
+	*/
+	const int pieceValue[6] = { 100, 320, 330, 500, 900, 0 };
+
+	/*
+	* Piece-square tables from white's point of view, laid out like the board (index 0 is A8, 63 is H1).
+	* Black uses the same tables mirrored vertically (sq ^ 56). They're the starting values of the pst parameters.
+	*/
+	const int defaultPST[6][64] = {
+		{
+			 0,  0,  0,  0,  0,  0,  0,  0,
+			50, 50, 50, 50, 50, 50, 50, 50,
+			10, 10, 20, 30, 30, 20, 10, 10,
+			 5,  5, 10, 25, 25, 10,  5,  5,
+			 0,  0,  0, 20, 20,  0,  0,  0,
+			 5, -5,-10,  0,  0,-10, -5,  5,
+			 5, 10, 10,-20,-20, 10, 10,  5,
+			 0,  0,  0,  0,  0,  0,  0,  0
+		},
+		{
+			-50,-40,-30,-30,-30,-30,-40,-50,
+			-40,-20,  0,  0,  0,  0,-20,-40,
+			-30,  0, 10, 15, 15, 10,  0,-30,
+			-30,  5, 15, 20, 20, 15,  5,-30,
+			-30,  0, 15, 20, 20, 15,  0,-30,
+			-30,  5, 10, 15, 15, 10,  5,-30,
+			-40,-20,  0,  5,  5,  0,-20,-40,
+			-50,-40,-30,-30,-30,-30,-40,-50
+		},
+		{
+			-20,-10,-10,-10,-10,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5, 10, 10,  5,  0,-10,
+			-10,  5,  5, 10, 10,  5,  5,-10,
+			-10,  0, 10, 10, 10, 10,  0,-10,
+			-10, 10, 10, 10, 10, 10, 10,-10,
+			-10,  5,  0,  0,  0,  0,  5,-10,
+			-20,-10,-10,-10,-10,-10,-10,-20
+		},
+		{
+			 0,  0,  0,  0,  0,  0,  0,  0,
+			 5, 10, 10, 10, 10, 10, 10,  5,
+			-5,  0,  0,  0,  0,  0,  0, -5,
+			-5,  0,  0,  0,  0,  0,  0, -5,
+			-5,  0,  0,  0,  0,  0,  0, -5,
+			-5,  0,  0,  0,  0,  0,  0, -5,
+			-5,  0,  0,  0,  0,  0,  0, -5,
+			 0,  0,  0,  5,  5,  0,  0,  0
+		},
+		{
+			-20,-10,-10, -5, -5,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5,  5,  5,  5,  0,-10,
+			 -5,  0,  5,  5,  5,  5,  0, -5,
+			  0,  0,  5,  5,  5,  5,  0, -5,
+			-10,  5,  5,  5,  5,  5,  0,-10,
+			-10,  0,  5,  0,  0,  0,  0,-10,
+			-20,-10,-10, -5, -5,-10,-10,-20
+		},
+		{
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-20,-30,-30,-40,-40,-30,-30,-20,
+			-10,-20,-20,-20,-20,-20,-20,-10,
+			 20, 20,  0,  0,  0,  0, 20, 20,
+			 20, 30, 10,  0,  0, 10, 30, 20
+		}
+	};
+
+	std::array<int, paramCount> params = [] {
+
+		std::array<int, paramCount> p{};
+
+		for (int i = 0; i < 6; i++) {
+			p[material + i] = pieceValue[i];
+			for (int sq = 0; sq < 64; sq++) p[pst + i * 64 + sq] = defaultPST[i][sq];
+		}
+
+		const int mobilityValues[4] = { 4, 4, 2, 1 };
+		const int kingAttackValues[4] = { 6, 5, 7, 10 };
+		const int passedValues[8] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+
+		for (int i = 0; i < 4; i++) {
+			p[mobility + i] = mobilityValues[i];
+			p[kingAttack + i] = kingAttackValues[i];
+		}
+
+		p[pawnShield] = 10;
+
+		for (int i = 0; i < 8; i++) p[passedPawn + i] = passedValues[i];
+
+		p[bishopPair] = 30;
+
+		return p;
+
+	}();
+
+	//How far material and piece-square values may be outside the window before the other terms are skipped
+
+	constexpr int lazyMargin{ 400 };
+
+	//Bonus for a position the bitbases say is won, on top of material, well below mate scores
+
+	constexpr int knownWin{ 2000 };
+
+	/*
+	* Squares that have to be free of enemy pawns for a pawn to be passed: those ahead of it on its own and the
+	* neighbouring files. [0] is for white pawns, which move towards row 0, [1] for black pawns.
+	*/
+	inline constexpr std::array<Tables::Table, 2> passedMask = [] {
+		std::array<Tables::Table, 2> masks{};
+		for (int sq = 0; sq < 64; sq++) {
+			for (int other = 0; other < 64; other++) {
+				if (other % 8 - sq % 8 > 1 || sq % 8 - other % 8 > 1) continue;
+				if (other / 8 < sq / 8) masks[0][sq] |= 1ULL << other;
+				if (other / 8 > sq / 8) masks[1][sq] |= 1ULL << other;
+			}
+		}
+		return masks;
+	}();
+
+	/*
+	* The pawn shield of a king: its own and the neighbouring files, one and two rows ahead of it.
+	*/
+	inline constexpr std::array<Tables::Table, 2> shieldMask = [] {
+		std::array<Tables::Table, 2> masks{};
+		for (int sq = 0; sq < 64; sq++) {
+			for (int other = 0; other < 64; other++) {
+				if (other % 8 - sq % 8 > 1 || sq % 8 - other % 8 > 1) continue;
+				int ahead = sq / 8 - other / 8;
+				if (ahead == 1 || ahead == 2) masks[0][sq] |= 1ULL << other;
+				if (ahead == -1 || ahead == -2) masks[1][sq] |= 1ULL << other;
+			}
+		}
+		return masks;
+	}();
+
+	/*
+	* The pieces of both sides, by side (0 white, 1 black) and piece (P, N, B, R, Q, K).
+	*/
+	struct Position {
+		std::uint64_t pieces[2][6];
+		std::uint64_t all[2];
+		std::uint64_t occupied;
+		std::uint64_t pawnAttacks[2];
+	};
+
+	/*
+	* Full evaluations by Zobrist hash. Each thread has its own, allocated on its first evaluation.
+	*/
+	struct CacheEntry {
+		std::uint64_t key;
+		int score;
+	};
+
+	constexpr std::size_t cacheSize{ 1 << 15 };
+
+	thread_local std::vector<CacheEntry> cache;
+
+	/**
+	 * .
+	 * Empties this thread's evaluation cache. Needed after the parameters change.
+	 */
+	void clearCache() {
+		cache.assign(cacheSize, CacheEntry{});
+	}
+
+	/*
+	* Collects the terms of the evaluation as a score: each parameter times how often it counts.
+	*/
+	struct Score {
+		int value{ 0 };
+		void add(int param, int count) { value += params[param] * count; }
+	};
+
+	/*
+	* Collects the terms of the evaluation as features, for the tuner.
+	*/
+	struct Features {
+		std::vector<Feature>& out;
+		void add(int param, int count) { out.push_back(Feature{ (std::uint16_t)param, (std::int16_t)count }); }
+	};
+
+	/**
+	 * .
+	 * Material and piece-square terms of both sides, counted positive for white and negative for black.
+	 * \param pos
+	 * \param terms
+	 */
+	template<typename Terms>
+	void materialTerms(const Position& pos, Terms& terms) {
+
+		for (int p = 0; p < 6; p++) {
+			for (std::uint64_t b = pos.pieces[0][p]; b; b &= b - 1) {
+				terms.add(material + p, 1);
+				terms.add(pst + p * 64 + std::countr_zero(b), 1);
+			}
+			for (std::uint64_t b = pos.pieces[1][p]; b; b &= b - 1) {
+				terms.add(material + p, -1);
+				terms.add(pst + p * 64 + (std::countr_zero(b) ^ 56), -1);
+			}
+		}
+
+	}
+
+	/**
+	 * .
+	 * Mobility, attacks on the enemy king's squares, pawn shield, passed pawns and bishop pair of one side.
+	 * Mobility only counts squares that aren't taken by an own piece or attacked by an enemy pawn.
+	 * \param pos
+	 * \param side 0 for white, 1 for black
+	 * \param terms
+	 */
+	template<typename Terms>
+	void positionalTerms(const Position& pos, int side, Terms& terms) {
+
+		int enemy = side ^ 1;
+		int sign = side ? -1 : 1;
+
+		std::uint64_t available = ~pos.all[side] & ~pos.pawnAttacks[enemy];
+
+		int enemyKing = std::countr_zero(pos.pieces[enemy][5]);
+		std::uint64_t zone = enemyKing < 64 ? Tables::kingAttacks[enemyKing] | 1ULL << enemyKing : 0;
+
+		for (int p = 1; p < 5; p++) {
+			for (std::uint64_t b = pos.pieces[side][p]; b; b &= b - 1) {
+
+				int sq = std::countr_zero(b);
+				std::uint64_t attacks{ 0 };
+
+				if (p == 1) attacks = Tables::knightAttacks[sq];
+				if (p == 2 || p == 4) attacks |= Magic::getBishopMove(sq, pos.occupied);
+				if (p == 3 || p == 4) attacks |= Magic::getRookMove(sq, pos.occupied);
+
+				terms.add(mobility + p - 1, sign * std::popcount(attacks & available));
+				terms.add(kingAttack + p - 1, sign * std::popcount(attacks & zone));
+
+			}
+		}
+
+		int king = std::countr_zero(pos.pieces[side][5]);
+		if (king < 64) terms.add(pawnShield, sign * std::popcount(shieldMask[side][king] & pos.pieces[side][0]));
+
+		for (std::uint64_t b = pos.pieces[side][0]; b; b &= b - 1) {
+			int sq = std::countr_zero(b);
+			if (passedMask[side][sq] & pos.pieces[enemy][0]) continue;
+			terms.add(passedPawn + (side ? sq / 8 : 7 - sq / 8), sign);
+		}
+
+		if (std::popcount(pos.pieces[side][2]) >= 2) terms.add(bishopPair, sign);
+
+	}
+
+	/**
+	 * .
+	 * Gathers the pieces of the board representation, with the occupancy and pawn attacks of both sides.
+	 * \return
+	 */
+	Position current() {
+
+		Position pos{
+			{ { Board::WP, Board::WN, Board::WB, Board::WR, Board::WQ, Board::WK },
+			  { Board::BP, Board::BN, Board::BB, Board::BR, Board::BQ, Board::BK } },
+			{ 0, 0 }, 0, { 0, 0 }
+		};
+
+		for (int side = 0; side < 2; side++) {
+			for (int p = 0; p < 6; p++) pos.all[side] |= pos.pieces[side][p];
+		}
+
+		pos.occupied = pos.all[0] | pos.all[1];
+		pos.pawnAttacks[0] = ((Board::WP & ~Board::colA) >> 9) | ((Board::WP & ~Board::colH) >> 7);
+		pos.pawnAttacks[1] = ((Board::BP & ~Board::colA) << 7) | ((Board::BP & ~Board::colH) << 9);
+
+		return pos;
+
+	}
+
+	/**
+	 * .
+	 * Evaluates the position. Returns just material and piece-square values if they're more than lazyMargin
+	 * below alpha or above beta, since the other terms wouldn't change the outcome.
+	 * \param alpha
+	 * \param beta
+	 * \return the score relative to the side to move
+	 */
+	int evaluate(int alpha, int beta) {
+
+		Stats::Timer timer{ Stats::evalNs };
+		Stats::add(Stats::evalCalls);
+
+		if (cache.empty()) clearCache();
+
+		CacheEntry& entry = cache[Board::hash & (cacheSize - 1)];
+
+		if (entry.key == Board::hash) {
+			Stats::add(Stats::evalCacheHits);
+			return entry.score;
+		}
+
+		Position pos = current();
+
+		Score score;
+		materialTerms(pos, score);
+
+		int relative = Board::whiteTurn ? score.value : -score.value;
+
+		/*
+		* In bitbase endgames a draw is exact. A win gets the bonus plus a push of the lone king to the edge and of
+		* the kings together, so the search makes progress towards mate.
+		*/
+
+		Bitbase::Outcome known = Bitbase::probe();
+
+		if (known == Bitbase::draw) return 0;
+
+		if (known == Bitbase::win || known == Bitbase::loss) {
+
+			bool strongWhite = (known == Bitbase::win) == Board::whiteTurn;
+			int strong = std::countr_zero(strongWhite ? Board::WK : Board::BK);
+			int weak = std::countr_zero(strongWhite ? Board::BK : Board::WK);
+
+			int edge = (std::abs(2 * (weak % 8) - 7) + std::abs(2 * (weak / 8) - 7)) / 2;
+			int distance = std::max(std::abs(strong % 8 - weak % 8), std::abs(strong / 8 - weak / 8));
+			int bonus = knownWin + 10 * edge + 5 * (7 - distance);
+
+			return relative + (known == Bitbase::win ? bonus : -bonus);
+
+		}
+
+		if (relative + lazyMargin <= alpha || relative - lazyMargin >= beta) {
+			Stats::add(Stats::lazyExits);
+			return relative;
+		}
+
+		positionalTerms(pos, 0, score);
+		positionalTerms(pos, 1, score);
+
+		relative = Board::whiteTurn ? score.value : -score.value;
+
+		entry = CacheEntry{ Board::hash, relative };
+
+		return relative;
+
+	}
+
+	/**
+	 * .
+	 * Lists the terms of the evaluation of the current position, one feature per parameter that counts, from
+	 * white's point of view: evaluate() of a white to move position is the sum of params[index] * count, except
+	 * where Bitbase::probe() knows the outcome, which evaluate() scores from the bitbase instead.
+	 * \param out cleared first
+	 */
+	void features(std::vector<Feature>& out) {
+
+		out.clear();
+
+		Position pos = current();
+		Features terms{ out };
+
+		materialTerms(pos, terms);
+		positionalTerms(pos, 0, terms);
+		positionalTerms(pos, 1, terms);
+
+		/*
+		* Merges the features of the same parameter and drops those that cancel out (like the two kings' material).
+		*/
+
+		std::sort(out.begin(), out.end(), [](const Feature& a, const Feature& b) { return a.index < b.index; });
+
+		std::size_t kept{ 0 };
+
+		for (std::size_t i = 0; i < out.size(); i++) {
+			if (kept && out[kept - 1].index == out[i].index) out[kept - 1].count += out[i].count;
+			else out[kept++] = out[i];
+			if (out[kept - 1].count == 0) kept--;
+		}
+
+		out.resize(kept);
+
+	}
+
+	/**
+	 * .
+	 * Evaluates the position with every term.
+	 * \return the score relative to the side to move
+	 */
+	int evaluate() {
+		return evaluate(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Eval {
+
+	/*
+	* Indexes of the evaluation parameters in params. Each group is as long as the distance to the next one:
+	* material by piece (P-K), piece-square tables by piece (64 squares each, white's view), mobility and king zone
+	* attacks by piece (N, B, R, Q), the pawn shield, passed pawns by rank (from the pawn's own side) and the
+	* bishop pair.
+	*/
+	enum Param : int {
+		material = 0,
+		pst = material + 6,
+		mobility = pst + 6 * 64,
+		kingAttack = mobility + 4,
+		pawnShield = kingAttack + 4,
+		passedPawn = pawnShield + 1,
+		bishopPair = passedPawn + 8,
+		paramCount = bishopPair + 1
+	};
+
+	extern std::array<int, paramCount> params;
+
+	/*
+	* One term of the evaluation: a parameter and how many times it counts, positive for white and negative for black.
+	*/
+	struct Feature {
+		std::uint16_t index;
+		std::int16_t count;
+	};
+
+	extern int evaluate();
+
+	extern int evaluate(int alpha, int beta);
+
+	extern void clearCache();
+
+	extern void features(std::vector<Feature>& out);
+
+	extern const int pieceValue[6];
+
+}
@@ -0,0 +1,107 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "FileMap.h"
+
+/*
+Read-only mapping of whole files, for data that is read in place instead of parsed into memory: packed positions
+(Pack.h), PGN game files and the endgame bitbases. The file itself is closed once it's mapped; the mapping keeps
+it readable until unmap.
+*/
+
+namespace FileMap {
+
+	/**
+	 * .
+	 * Maps a file. Returns false, with the mapping left empty, if it can't be opened, sized or mapped.
+	 * \param path
+	 * \param mapping
+	 * \param access
+	 * \return
+	 */
+	bool map(const std::string& path, Mapping& mapping, Access access) {
+
+		unmap(mapping);
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			access == sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+
+		if (fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return true;
+		}
+
+		HANDLE object = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!object) return false;
+
+		void* data = MapViewOfFile(object, FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(object);
+			return false;
+		}
+
+		mapping.handle = object;
+		mapping.bytes = (std::size_t)fileSize.QuadPart;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+
+		if (st.st_size == 0) {
+			::close(fd);
+			return true;
+		}
+
+		void* data = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED) return false;
+
+		madvise(data, (std::size_t)st.st_size, access == sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+		mapping.bytes = (std::size_t)st.st_size;
+#endif
+
+		mapping.data = data;
+
+		return true;
+
+	}
+
+	void unmap(Mapping& mapping) {
+
+		if (mapping.data) {
+#ifdef _WIN32
+			UnmapViewOfFile(mapping.data);
+			CloseHandle(mapping.handle);
+#else
+			munmap(const_cast<void*>(mapping.data), mapping.bytes);
+#endif
+		}
+
+		mapping = Mapping{};
+
+	}
+
+}
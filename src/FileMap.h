@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FileMap {
+
+	/*
+	* How the mapping will be read, passed on to the OS as a hint.
+	*/
+	enum Access : std::uint8_t {
+		sequential,		//front to back, once (game files, packed positions)
+		random			//lookups anywhere (bitbases)
+	};
+
+	/*
+	* A whole file mapped read-only. An empty file maps to no data and 0 bytes.
+	*/
+	struct Mapping {
+		const void* data{ nullptr };
+		std::size_t bytes{ 0 };
+		void* handle{ nullptr };	//Windows: the file mapping object
+	};
+
+	extern bool map(const std::string& path, Mapping& mapping, Access access);
+
+	extern void unmap(Mapping& mapping);
+
+}
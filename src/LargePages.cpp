@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "LargePages.h"
+
+/*
+Allocation of big, long lived tables on huge pages. With 4KB pages every few KB of a multi-GB hash table needs
+its own TLB entry, so nearly every probe misses the TLB; 2MB pages cut that by 512 times.
+
+On Linux an allocation first asks for explicit huge pages (MAP_HUGETLB), which only works if the administrator
+reserved some (vm.nr_hugepages). Otherwise it maps normal memory aligned to 2MB and asks for transparent huge pages
+with madvise(MADV_HUGEPAGE). Whether the kernel actually used them can only be seen afterwards, in
+/proc/self/smaps, which is what describe() reports. On Windows large pages are tried before normal pages; they need
+the "Lock pages in memory" privilege, which is enabled on the process first and only granted if the account holds
+it. Elsewhere it's normal pages.
+*/
+
+namespace LargePages {
+
+	/**
+	 * .
+	 * Rounds up to a multiple of the huge page size.
+	 * \param bytes
+	 * \return
+	 */
+	std::size_t roundUp(std::size_t bytes) {
+		return (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+	}
+
+#ifdef _WIN32
+	/**
+	 * .
+	 * Enables the "Lock pages in memory" privilege (SeLockMemoryPrivilege) on the process token, once. Large pages
+	 * can't be allocated without it, and it's only granted if the account holds it.
+	 * \return whether it's enabled
+	 */
+	bool lockMemoryPrivilege() {
+
+		static const bool enabled = [] {
+
+			HANDLE token;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+
+			TOKEN_PRIVILEGES privileges{};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+			//AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED when the account doesn't hold the privilege
+
+			bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+				&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+
+			CloseHandle(token);
+
+			return ok;
+
+		}();
+
+		return enabled;
+
+	}
+#endif
+
+	/**
+	 * .
+	 * Allocates zeroed memory, on huge pages if possible. Returns an empty block if there's no memory at all.
+	 * \param bytes
+	 * \return
+	 */
+	Block allocate(std::size_t bytes) {
+
+		Block block;
+
+		if (bytes == 0) return block;
+
+#ifdef _WIN32
+		SIZE_T largeMinimum = GetLargePageMinimum();
+
+		if (largeMinimum && lockMemoryPrivilege()) {
+			SIZE_T size = (bytes + largeMinimum - 1) / largeMinimum * largeMinimum;
+			block.data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (block.data) {
+				block.bytes = size;
+				block.kind = large;
+				return block;
+			}
+		}
+
+		block.data = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (block.data) {
+			block.bytes = bytes;
+			block.kind = small;
+		}
+#else
+		std::size_t size = bytes >= hugePageSize ? roundUp(bytes) : bytes;
+
+#ifdef MAP_HUGETLB
+		if (bytes >= hugePageSize) {
+			void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (data != MAP_FAILED) {
+				block.data = data;
+				block.bytes = size;
+				block.kind = hugetlb;
+				return block;
+			}
+		}
+#endif
+
+		/*
+		* Maps an extra huge page so the block can start on a 2MB boundary, then gives back what's left over on
+		* either side.
+		*/
+
+		std::size_t extra = bytes >= hugePageSize ? hugePageSize : 0;
+
+		void* mapped = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapped == MAP_FAILED) return block;
+
+		char* start = static_cast<char*>(mapped);
+		char* aligned = extra ? reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(start) + hugePageSize - 1) & ~(std::uintptr_t)(hugePageSize - 1)) : start;
+
+		if (aligned > start) munmap(start, aligned - start);
+		if (start + size + extra > aligned + size) munmap(aligned + size, start + size + extra - (aligned + size));
+
+		block.data = aligned;
+		block.bytes = size;
+		block.kind = small;
+
+#ifdef MADV_HUGEPAGE
+		if (extra && madvise(aligned, size, MADV_HUGEPAGE) == 0) block.kind = transparent;
+#endif
+#endif
+
+		return block;
+
+	}
+
+	void release(Block& block) {
+
+		if (block.data) {
+#ifdef _WIN32
+			VirtualFree(block.data, 0, MEM_RELEASE);
+#else
+			munmap(block.data, block.bytes);
+#endif
+		}
+
+		block = Block{};
+
+	}
+
+	/**
+	 * .
+	 * How much of a block the kernel backs with transparent huge pages, from /proc/self/smaps. Only meaningful once
+	 * the memory has been touched.
+	 * \param block
+	 * \return
+	 */
+	std::size_t transparentBytes(const Block& block) {
+
+		std::ifstream smaps{ "/proc/self/smaps" };
+		std::string line;
+
+		std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(block.data);
+		std::uintptr_t end = begin + block.bytes;
+		bool inside{ false };
+		std::size_t total{ 0 };
+
+		while (std::getline(smaps, line)) {
+
+			/*
+			* A new mapping starts with its address range, e.g. "7f0000000000-7f0000200000 rw-p ...".
+			*/
+
+			std::size_t dash = line.find('-');
+			if (dash != std::string::npos && dash < 17 && line.find(' ') > dash && std::isxdigit((unsigned char)line[0])) {
+				std::uintptr_t from = std::stoull(line.substr(0, dash), nullptr, 16);
+				std::uintptr_t to = std::stoull(line.substr(dash + 1, line.find(' ') - dash - 1), nullptr, 16);
+				inside = from < end && to > begin;
+				continue;
+			}
+
+			if (inside && line.rfind("AnonHugePages:", 0) == 0) {
+				std::istringstream reader{ line.substr(14) };
+				std::size_t kb{ 0 };
+				reader >> kb;
+				total += kb * 1024;
+			}
+
+		}
+
+		return std::min(total, block.bytes);
+
+	}
+
+	/**
+	 * .
+	 * Describes the pages a block is actually on, for info string output.
+	 * \param block
+	 * \return
+	 */
+	std::string describe(const Block& block) {
+
+		std::ostringstream out;
+
+		switch (block.kind) {
+		case none: out << "not allocated"; break;
+		case small:
+			out << "4KB pages";
+#ifdef _WIN32
+			if (!lockMemoryPrivilege()) out << " (large pages need the Lock pages in memory privilege, which was denied)";
+#endif
+			break;
+		case hugetlb: out << "2MB huge pages (MAP_HUGETLB)"; break;
+		case large: out << "large pages"; break;
+		case transparent: {
+			std::size_t huge = transparentBytes(block);
+			if (huge) out << "transparent huge pages (" << huge / (1024 * 1024) << " of " << block.bytes / (1024 * 1024) << " MB)";
+			else out << "4KB pages (transparent huge pages not granted)";
+			break;
+		}
+		}
+
+		return out.str();
+
+	}
+
+}
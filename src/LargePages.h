@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace LargePages {
+
+	/*
+	* The kind of pages a block ended up on.
+	*/
+	enum Kind : std::uint8_t {
+		none,
+		small,			//normal 4KB pages
+		transparent,	//Linux transparent huge pages were asked for (madvise); the kernel decides per 2MB range
+		hugetlb,		//explicit 2MB pages from the reserved pool (MAP_HUGETLB)
+		large			//Windows large pages
+	};
+
+	constexpr std::size_t hugePageSize{ 2 * 1024 * 1024 };
+
+	/*
+	* A zeroed, page aligned allocation. Blocks of 2MB or more are 2MB aligned.
+	*/
+	struct Block {
+		void* data{ nullptr };
+		std::size_t bytes{ 0 };
+		Kind kind{ none };
+	};
+
+	extern Block allocate(std::size_t bytes);
+
+	extern void release(Block& block);
+
+	extern std::string describe(const Block& block);
+
+}
@@ -1,9 +1,17 @@
-#include <unordered_map>
+#include <algorithm>
+#include <bit>
 #include <bitset>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <thread>
 
 #include "Board.h"
+#include "LargePages.h"
 #include "Magic.h"
+#include "MagicNumbers.h"
+#include "Numa.h"
+#include "Tables.h"
 
 namespace Magic {
 
@@ -12,74 +20,82 @@ namespace Magic {
 	*/
 	std::ofstream ost("WritingTests.txt");
 
-	int findNextBit(const std::uint64_t& b);
-	void blockerBoardRook(int index);
-	void blockerBoardRook(int index, std::uint64_t blockerBoard, std::uint64_t blockerMask);
-	void rookBlockerToMove(int index, std::uint64_t blockerBoard);
-	void printBitBoard(const std::uint64_t& b, std::ostream& os);
-	void blockerBoardBishop(int index);
-	void blockerBoardBishop(int index, std::uint64_t blockerBoard, std::uint64_t blockerMask);
-	void bishopBlockerToMove(int index, std::uint64_t blockerBoard);
-
 	/*
-	* Used to hash the moves available for the rook by blocker boards.
-	* magicRook & magicBishop store the magic numbers for each square.
-	* Use an unordered map for rookMasks/bishopMasks if it keeps acting weird.
+	* Fancy magic bitboards. The occupied squares of a slider's blocker mask, multiplied by the square's magic
+	* number and shifted down, give an index into its part of the attack table. The magics, shifts and offsets
+	* are found offline by gorilla-magics (tools/MagicFinder.cpp) and come from MagicNumbers.h, so startup only
+	* fills in the table. Rook and bishop squares share one table and overlap wherever their entries agree.
 	*/
 
-	std::unordered_map<std::uint64_t, std::uint64_t> rookMoves[64];
-	std::uint64_t rookMasks[64];
-	int magicRook[64];
+	struct Slider {
+		std::uint64_t mask;
+		std::uint64_t magic;
+		std::uint32_t offset;
+		std::uint32_t shift;
+	};
 
-	std::unordered_map<std::uint64_t, std::uint64_t> bishopMoves[64];
+	Slider rooks[64];
+	Slider bishops[64];
+
+	std::uint64_t rookMasks[64];
 	std::uint64_t bishopMasks[64];
-	int magicBishop[64];
+
+	/*
+	* The attack table, on huge pages if possible (see LargePages.h). copies[0] is the one built at startup, and
+	* replicate() adds one per NUMA node in copies[1 + node]. Each thread reads the copy in copies[copy].
+	*/
+
+	constexpr int maxCopies{ 1 + 64 };
+
+	LargePages::Block copies[maxCopies];
+	std::mutex replicating;
+
+	thread_local int copy{ 0 };
 
 	/**
 	 * .
-	 * Returns a random integer between 0 and 2^32.
-	 * \return 
+	 * Allocates a copy of the attack table. It's a bit under 1MB, so a whole huge page is asked for to get it
+	 * on a single TLB entry.
+	 * \return
 	 */
-	int getMagic() {
-		int max = pow(2, 32);
-		int min = 0;
-		srand(time(NULL)); // Seed the time
-		int finalNum = rand() % (max - min + 1) + min; // Generate the number, assign to variable.
-		return finalNum;
+	LargePages::Block allocateTable() {
+		return LargePages::allocate(std::max<std::size_t>(tableSize * sizeof(std::uint64_t), LargePages::hugePageSize));
+	}
+
+	/**
+	 * .
+	 * The table built at startup, allocated the first time it's needed.
+	 * \return
+	 */
+	std::uint64_t* table() {
+		if (!copies[0].data) copies[0] = allocateTable();
+		return static_cast<std::uint64_t*>(copies[0].data);
+	}
+
+	/**
+	 * .
+	 * Index of an occupancy in the attack table.
+	 * \param s
+	 * \param occ
+	 * \return
+	 */
+	inline std::uint32_t index(const Slider& s, std::uint64_t occ) {
+		return s.offset + (std::uint32_t)(((occ & s.mask) * s.magic) >> s.shift);
 	}
 
 	/**
 	 * .
 	 * Creates a bitboard of all the candidate blockers for a rook from a certain square.
-	 * It checks the column and row the square is on. From there, it creates a bitboard by or'ing the row and column it's on, then not'ing the edge rows and columns.
+	 * It looks up the column and row the square is on. From there, it creates a bitboard by or'ing the row and column it's on, then not'ing the edge rows and columns.
 	 * This creates all candidate blockers.
 	 * \param square
 	 * \return
 	 */
 	std::uint64_t blockerMaskRook(int square) {
 
-		std::uint64_t sq = pow(2, square);
-		std::uint64_t col{ 0 }, row{ 0 };
-		switch (square / 8) {
-		case 7: row = Board::row1; break;
-		case 6: row = Board::row2; break;
-		case 5: row = Board::row3; break;
-		case 4: row = Board::row4; break;
-		case 3: row = Board::row5; break;
-		case 2: row = Board::row6; break;
-		case 1: row = Board::row7; break;
-		case 0: row = Board::row8; break;
-		}
-		switch (square % 8) {
-		case 0: col = Board::colA; break;
-		case 1: col = Board::colB; break;
-		case 2: col = Board::colC; break;
-		case 3: col = Board::colD; break;
-		case 4: col = Board::colE; break;
-		case 5: col = Board::colF; break;
-		case 6: col = Board::colG; break;
-		case 7: col = Board::colH; break;
-		}
+		std::uint64_t sq = Board::arrOfSquares[square];
+		std::uint64_t row = Tables::rowMask[square];
+		std::uint64_t col = Tables::colMask[square];
 
 		row &= ~(Board::colA | Board::colH);
 		col &= ~(Board::row1 | Board::row8);
@@ -93,40 +109,22 @@ namespace Magic {
 
 	/**
 	 * .
-	 * Creates blocker boards of all permutations (2^numBits) recursively.
+	 * Fills in the attack table for a rook on a square, for every subset of its blocker mask. The subsets are
+	 * walked with the carry-rippler trick: (sub - mask) & mask is the next one after sub.
 	 * \param index
-	 * \param blockerMask
 	 */
 	void blockerBoardRook(int index) {
 
+		std::uint64_t* attacks = table();
 		std::uint64_t blockerMask = blockerMaskRook(index);
-		int count = std::popcount(blockerMask);
-		int magic = getMagic();
-		magicRook[index] = magic;
-		blockerBoardRook(index, 0, blockerMask);
-	}
 
-	/**
-	 * .
-	 * Is recursively called. Calls rookBlockerToMove to generate the moves then hash them for easy access during legal moveGen.
-	 * Essentially, every bit in the blockerMask can either be included in the blockerBoard or not. It then calls itself recursively by doing this
-	 * and not'ing the next bit in the blocker board. This provides all possibilities. Once the amount of bits in the mask is 0, all bits have been used.
-	 * From here, it converts it to a move and hashes it for later use.
-	 * \param index
-	 * \param blockerBoard
-	 * \param blockerMask
-	 */
-	void blockerBoardRook(int index, std::uint64_t blockerBoard, std::uint64_t blockerMask) {
-		int count = std::popcount(blockerMask);
-		if (count == 0) {
-			rookBlockerToMove(index, blockerBoard);
-			return;
-		}
-		int ind = findNextBit(blockerMask);
-		std::uint64_t nextBit = (std::uint64_t)pow(2, ind);
-		blockerMask &= ~(nextBit);
-		blockerBoardRook(index, blockerBoard | nextBit, blockerMask);
-		blockerBoardRook(index, blockerBoard, blockerMask);
+		rooks[index] = Slider{ blockerMask, rookMagics[index], rookOffsets[index], rookShifts[index] };
+
+		std::uint64_t sub{ 0 };
+		do {
+			attacks[Magic::index(rooks[index], sub)] = rookBlockerToMove(index, sub);
+			sub = (sub - blockerMask) & blockerMask;
+		} while (sub);
 
 	}
 
@@ -135,11 +133,13 @@ namespace Magic {
 	 * Converts a blockerboard and an index (where the rook is on) to a move bitboard.
 	 * It simply uses a while loop to repeatedly shift it upwards, downwards, leftwards or rightwards.
 	 * If it encounters a blockerboard it or's it and then quits the while loop.
+	 * This is the reference the magic tables are built and checked from.
 	 * \param index
 	 * \param blockerBoard
+	 * \return
 	 */
-	void rookBlockerToMove(int index, std::uint64_t blockerBoard) {
-		std::uint64_t pos = pow(2, index);
+	std::uint64_t rookBlockerToMove(int index, std::uint64_t blockerBoard) {
+		std::uint64_t pos = Board::arrOfSquares[index];
 		std::uint64_t moves{};
 		std::uint64_t U{ pos }, R{ pos }, L{ pos }, D{ pos };
 		
@@ -165,7 +165,7 @@ namespace Magic {
 		}
 		moves &= ~pos;
 
-		rookMoves[index][blockerBoard] = moves;
+		return moves;
 	}
 
 	/**
@@ -175,7 +175,7 @@ namespace Magic {
 	 * \return 
 	 */
 	std::uint64_t blockerMaskBishop(int square) {
-		std::uint64_t sq = pow(2, square);
+		std::uint64_t sq = Board::arrOfSquares[square];
 		int n{ 1 };
 		std::uint64_t blocker{};
 		std::uint64_t ur = sq, ul = sq, dr = sq, dl = sq;
@@ -194,36 +194,21 @@ namespace Magic {
 
 	/**
 	 * .
-	 * Creates a blocker board for a given index for a bishop.
+	 * Fills in the attack table for a bishop on a square, like blockerBoardRook.
 	 * \param index
 	 */
 	void blockerBoardBishop(int index) {
 
+		std::uint64_t* attacks = table();
 		std::uint64_t blockerMask = blockerMaskBishop(index);
-		int count = std::popcount(blockerMask);
-		int magic = getMagic();
-		magicBishop[index] = magic;
-		blockerBoardBishop(index, 0, blockerMask);
-	}
 
-	/**
-	 * .
-	 * Creates all permutations for blockers on a certain square.
-	 * \param index
-	 * \param blockerBoard
-	 * \param blockerMask
-	 */
-	void blockerBoardBishop(int index, std::uint64_t blockerBoard, std::uint64_t blockerMask) {
-		int count = std::popcount(blockerMask);
-		if (count == 0) {
-			bishopBlockerToMove(index, blockerBoard);
-			return;
-		}
-		int ind = findNextBit(blockerMask);
-		std::uint64_t nextBit = (std::uint64_t)pow(2, ind);
-		blockerMask &= ~(nextBit);
-		blockerBoardBishop(index, blockerBoard | nextBit, blockerMask);
-		blockerBoardBishop(index, blockerBoard, blockerMask);
+		bishops[index] = Slider{ blockerMask, bishopMagics[index], bishopOffsets[index], bishopShifts[index] };
+
+		std::uint64_t sub{ 0 };
+		do {
+			attacks[Magic::index(bishops[index], sub)] = bishopBlockerToMove(index, sub);
+			sub = (sub - blockerMask) & blockerMask;
+		} while (sub);
 
 	}
 
@@ -232,9 +217,10 @@ namespace Magic {
 	 * Creates a list of moves using the bitboards of blockers.
 	 * \param index
 	 * \param blockerBoard
+	 * \return
 	 */
-	void bishopBlockerToMove(int index, std::uint64_t blockerBoard) {
-		std::uint64_t pos = pow(2, index);
+	std::uint64_t bishopBlockerToMove(int index, std::uint64_t blockerBoard) {
+		std::uint64_t pos = Board::arrOfSquares[index];
 		std::uint64_t moves{};
 		std::uint64_t UR { pos }, UL{ pos }, DR{ pos }, DL{ pos };
 
@@ -260,32 +246,7 @@ namespace Magic {
 		}
 		moves &= ~pos;
 
-		bishopMoves[index][blockerBoard] = moves;
-	}
-
-	/**
-	 * .
-	 * Algorithm that counts the amount of "1s" in a bitboard. This isn't needed and we can just use std::popcount(i) if in C++20.
-	 * \param u
-	 * \return
-	 */
-	int onesInBB(std::uint64_t u) {
-		std::uint64_t uCount;
-		uCount = u - ((u >> 1) & 033333333333) - ((u >> 2) & 011111111111);
-		return ((uCount + (uCount >> 3)) & 030707070707) % 63;
-	}
-
-	/**
-	 * .
-	 * Self-explanatory. Used to find the next "1" in a bitboard.
-	 * \param b
-	 * \return
-	 */
-	int findNextBit(const std::uint64_t& b) {
-		for (int i = 0; i < 64; i++) {
-			if (((b >> i) & 1) == 1) return i;
-		}
-		return -1;
+		return moves;
 	}
 
 	/**
@@ -306,35 +267,115 @@ namespace Magic {
 
 	/**
 	 * .
-	 * Returns the rook moves from a square. Make sure it takes specific board params.
+	 * Returns the rook moves from a square with the given occupancy. Only the occupied squares in the blocker mask
+	 * matter, so the rest are cleared before the lookup.
 	 * \param sq
-	 * \return 
+	 * \param occ
+	 * \return
 	 */
-	std::uint64_t getRookMove(int sq) {
+	std::uint64_t getRookMove(int sq, std::uint64_t occ) {
+
+		return static_cast<const std::uint64_t*>(copies[copy].data)[index(rooks[sq], occ)];
+
+	}
+
+	/**
+	 * .
+	 * Returns the bishop moves from a square with the given occupancy.
+	 * \param sq
+	 * \param occ
+	 * \return
+	 */
+	std::uint64_t getBishopMove(int sq, std::uint64_t occ) {
 
-		std::uint64_t blockerMask = rookMasks[sq];
+		return static_cast<const std::uint64_t*>(copies[copy].data)[index(bishops[sq], occ)];
 
-		blockerMask &= (Board::WP | Board::WR | Board::WK | Board::WQ | Board::WN | Board::WB | Board::BP | Board::BR | Board::BK | Board::BQ | Board::BN | Board::BB);
+	}
+
+	/**
+	 * .
+	 * Returns the rook moves from a square on the current board.
+	 * \param sq
+	 * \return 
+	 */
+	std::uint64_t getRookMove(int sq) {
 
-		return Magic::rookMoves[sq][blockerMask];
+		return getRookMove(sq, Board::WP | Board::WR | Board::WK | Board::WQ | Board::WN | Board::WB | Board::BP | Board::BR | Board::BK | Board::BQ | Board::BN | Board::BB);
 
 	}
 
 	/**
 	 * .
-	 * Returns bishop moves from a square. Add params for the board later.
+	 * Returns bishop moves from a square on the current board.
 	 * \param sq
 	 * \return 
 	 */
 	std::uint64_t getBishopMove(int sq) {
 		
-		std::uint64_t blockerMask = bishopMasks[sq];
+		return getBishopMove(sq, Board::WP | Board::WR | Board::WK | Board::WQ | Board::WN | Board::WB | Board::BP | Board::BR | Board::BK | Board::BQ | Board::BN | Board::BB);
+
+	}
+
+	/**
+	 * .
+	 * Builds the rook and bishop move tables for every square. Has to run before any move generation.
+	 */
+	void initialize() {
 
-		blockerMask &= (Board::WP | Board::WR | Board::WK | Board::WQ | Board::WN | Board::WB | Board::BP | Board::BR | Board::BK | Board::BQ | Board::BN | Board::BB);
+		for (int i = 0; i < 64; i++) {
+			blockerBoardRook(i);
+			blockerBoardBishop(i);
+		}
 
-		return Magic::bishopMoves[sq][blockerMask];
+	}
 
+	/**
+	 * .
+	 * Describes the memory the table is on, for info string output.
+	 * \return
+	 */
+	std::string pages() {
+		return std::to_string(tableSize * sizeof(std::uint64_t) / 1024) + " KB on " + LargePages::describe(copies[0]);
 	}
 
-}
+	/**
+	 * .
+	 * Copies the attack table to every NUMA node, each copy made by a thread running on its node so the kernel
+	 * places its pages there. Does nothing on a single node machine or if the copies exist. Safe to call from
+	 * several searches at once; the copies never change once made.
+	 * \param nodes
+	 */
+	void replicate(int nodes) {
+
+		std::lock_guard<std::mutex> lock{ replicating };
+
+		for (int node = 0; nodes > 1 && node < nodes && 1 + node < maxCopies; node++) {
+
+			if (copies[1 + node].data) continue;
 
+			std::thread builder{ [node] {
+				Numa::bind(node);
+				LargePages::Block block = allocateTable();
+				if (block.data) std::memcpy(block.data, copies[0].data, tableSize * sizeof(std::uint64_t));
+				copies[1 + node] = block;
+			} };
+			builder.join();
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Points the calling thread's lookups at the copy on a node, or at the original if there's no copy there.
+	 * \param node
+	 */
+	void useNode(int node) {
+
+		bool replicated = node >= 0 && 1 + node < maxCopies && copies[1 + node].data;
+
+		copy = replicated ? 1 + node : 0;
+
+	}
+
+}
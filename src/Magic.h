@@ -1,12 +1,24 @@
 #pragma once
 #include <iostream>
+#include <cstdint>
+#include <string>
 
 namespace Magic {
 
+	extern void initialize();
+	extern std::string pages();
+	extern void replicate(int nodes);
+	extern void useNode(int node);
 	extern void printBitBoard(const std::uint64_t& b, std::ostream& os);
 	extern void blockerBoardBishop(int index);
 	extern void blockerBoardRook(int index);
+	extern std::uint64_t blockerMaskRook(int square);
+	extern std::uint64_t blockerMaskBishop(int square);
+	extern std::uint64_t rookBlockerToMove(int index, std::uint64_t blockerBoard);
+	extern std::uint64_t bishopBlockerToMove(int index, std::uint64_t blockerBoard);
 	extern std::uint64_t getRookMove(int sq);
 	extern std::uint64_t getBishopMove(int sq);
+	extern std::uint64_t getRookMove(int sq, std::uint64_t occ);
+	extern std::uint64_t getBishopMove(int sq, std::uint64_t occ);
 
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Generated by gorilla-magics (tools/MagicFinder.cpp) with --seed 1 --tries 200000. Don't edit by hand;
+rerun it from the repository root instead. Each square's attacks are at
+offset + ((occupancy & mask) * magic >> shift) in one table of tableSize entries shared by rooks and bishops.
+*/
+
+namespace Magic {
+
+	inline constexpr std::uint32_t tableSize{ 107648 };
+
+	inline constexpr std::uint64_t rookMagics[64] = {
+		0x1280002480400010ULL, 0x1040100040002001ULL, 0x0280200010028008ULL, 0x0480080010000480ULL,
+		0x820020BA00045008ULL, 0x4200020008108104ULL, 0x8200020001480084ULL, 0x0200028500402412ULL,
+		0x0001800040008022ULL, 0x0904400048201000ULL, 0x8006002012004480ULL, 0x0A10801000080083ULL,
+		0x2001000700080010ULL, 0x0200800200800400ULL, 0x8982004401084200ULL, 0x00130000850000C2ULL,
+		0x0040048002814120ULL, 0x0040008020008040ULL, 0x0544410011002008ULL, 0x2300210008100104ULL,
+		0x2088004004004200ULL, 0x8002008002040080ULL, 0x2400040002011008ULL, 0x000A120001005084ULL,
+		0x0040002280004080ULL, 0x1020200240005001ULL, 0x2001001100200040ULL, 0x0510040140180040ULL,
+		0x0000080080040080ULL, 0x0010040080020080ULL, 0x1101000100020004ULL, 0x040110420000811CULL,
+		0x00C0108820800044ULL, 0x00C0004484802002ULL, 0x1000204482001200ULL, 0x0028008008801000ULL,
+		0x0030800800800400ULL, 0x0014040080800200ULL, 0x8008820804009001ULL, 0x4004004102000084ULL,
+		0x8420208040008000ULL, 0x0010024060024000ULL, 0x0010001020008080ULL, 0x0A20080010008080ULL,
+		0x0400040008008080ULL, 0x0001000204010008ULL, 0x0000129108040010ULL, 0x0000408400420001ULL,
+		0x0040008001C4A480ULL, 0x0061002040008100ULL, 0x1082802004100880ULL, 0x02D0008008001080ULL,
+		0x0225001004080100ULL, 0x0CC0800200040080ULL, 0x105C480201100400ULL, 0x0020410400804200ULL,
+		0x4400800102402615ULL, 0x1001A24412008102ULL, 0x0106483082006042ULL, 0x1100042010010009ULL,
+		0x0401000800021005ULL, 0x000100081A040005ULL, 0x8100020110008804ULL, 0x8408032A41028402ULL
+	};
+
+	inline constexpr std::uint8_t rookShifts[64] = {
+		52, 53, 53, 53,
+		53, 53, 53, 52,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		53, 54, 54, 54,
+		54, 54, 54, 53,
+		52, 53, 53, 53,
+		53, 53, 53, 52
+	};
+
+	inline constexpr std::uint32_t rookOffsets[64] = {
+		0, 16384, 18432, 20480,
+		22528, 24576, 26624, 4096,
+		28672, 65536, 66560, 67584,
+		68608, 69632, 70656, 30720,
+		32768, 71680, 72704, 73728,
+		74752, 75776, 76800, 34816,
+		36864, 77824, 78848, 79872,
+		80896, 81920, 82944, 38912,
+		40960, 83968, 84992, 86016,
+		87040, 88064, 89088, 43008,
+		45056, 90112, 91136, 92160,
+		93184, 94208, 95232, 47104,
+		49152, 96256, 97280, 98304,
+		99328, 100352, 101376, 51200,
+		8192, 53248, 55296, 57344,
+		59392, 61440, 63488, 12288
+	};
+
+	inline constexpr std::uint64_t bishopMagics[64] = {
+		0x18D2108109050602ULL, 0x0004041806003300ULL, 0x0004082202506004ULL, 0x00A1104501404204ULL,
+		0x0001104000004401ULL, 0x0091042004004002ULL, 0x1180808808400042ULL, 0x4C02240108184222ULL,
+		0x0080202005024C90ULL, 0x8908A10454124040ULL, 0x1014210821004A82ULL, 0x0105110415802860ULL,
+		0x4200041044821111ULL, 0x0804108804400804ULL, 0x0082004808049000ULL, 0x008102004222100EULL,
+		0x1A13144022320400ULL, 0x0269602008008388ULL, 0x2428081081A0C200ULL, 0x1508000082810000ULL,
+		0x04AA000C00942382ULL, 0x4C02001110500400ULL, 0x4021004048080400ULL, 0x4020881024140200ULL,
+		0xAC986920C0824804ULL, 0x00080430481000A2ULL, 0xA328044048044502ULL, 0x1122008008008202ULL,
+		0x0004082004002002ULL, 0x12C800800CB00400ULL, 0x0124004011180260ULL, 0x0010910092004203ULL,
+		0x0002601000200206ULL, 0x0920884802043020ULL, 0x090A020200011801ULL, 0xC000200500080108ULL,
+		0x9040010100001040ULL, 0x1090100A40282403ULL, 0x0022062402024400ULL, 0x0801020089021440ULL,
+		0x013082104080D201ULL, 0x0001010820000280ULL, 0x8000840041008800ULL, 0x0140084010406200ULL,
+		0x3100400810404200ULL, 0x0040081910400C08ULL, 0x6010840820803040ULL, 0x0081480A08800044ULL,
+		0x0002008404400001ULL, 0x0580420801080100ULL, 0x098800240E080000ULL, 0x1000002020880200ULL,
+		0xA0000110203A0000ULL, 0x0400200481220080ULL, 0x485104312802008AULL, 0x0002080204144000ULL,
+		0xC622008094012000ULL, 0x0888884402011000ULL, 0x8040040202110480ULL, 0x000200401020A808ULL,
+		0x0140000840904100ULL, 0x20010010A0011102ULL, 0x8000C0080200C200ULL, 0x8804200A0C002382ULL
+	};
+
+	inline constexpr std::uint8_t bishopShifts[64] = {
+		58, 59, 59, 59,
+		59, 59, 59, 58,
+		59, 59, 59, 59,
+		59, 59, 59, 59,
+		59, 59, 57, 57,
+		57, 57, 59, 59,
+		59, 59, 57, 55,
+		55, 57, 59, 59,
+		59, 59, 57, 55,
+		55, 57, 59, 59,
+		59, 59, 57, 57,
+		57, 57, 59, 59,
+		59, 59, 59, 59,
+		59, 59, 59, 59,
+		58, 59, 59, 59,
+		59, 59, 59, 58
+	};
+
+	inline constexpr std::uint32_t bishopOffsets[64] = {
+		105984, 106240, 106272, 106304,
+		106336, 106368, 106400, 106048,
+		106432, 106464, 106496, 106528,
+		106560, 106592, 106624, 106656,
+		106688, 106720, 104448, 104576,
+		104704, 104832, 106752, 106784,
+		106816, 106848, 104960, 102400,
+		102912, 105088, 106880, 106912,
+		106944, 106976, 105216, 103424,
+		103936, 105344, 107008, 107040,
+		107072, 107104, 105472, 105600,
+		105728, 105856, 107136, 107168,
+		107200, 107232, 107264, 107296,
+		107328, 107360, 107392, 107424,
+		106112, 107456, 107488, 107520,
+		107552, 107584, 107616, 106176
+	};
+
+}
@@ -0,0 +1,353 @@
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Match.h"
+#include "Board.h"
+#include "EPD.h"
+#include "Move.h"
+#include "Search.h"
+#include "TT.h"
+
+/*
+Plays games between two configurations of the engine inside one process, for A/B testing. Each worker thread plays
+whole games on its own board (the board and search state are thread_local) while the Magic tables are shared.
+Both sides of a game are searched on the same thread, swapping the search options and transposition table before
+every move.
+
+Every opening is played twice with colors swapped. Results are reported as Elo with a 95% error margin, and the
+match stops early once a sequential probability ratio test (SPRT) between elo0 and elo1 accepts either hypothesis.
+*/
+
+namespace Match {
+
+	/*
+	* Everything the match command can set.
+	*/
+	struct Config {
+		int games{ 1000 };
+		int threads{ 1 };
+		Search::Limits limits;
+		std::vector<std::string> openings;
+		Search::Options a, b;
+		double elo0{ 0 };
+		double elo1{ 5 };
+		int maxPlies{ 400 };
+	};
+
+	/**
+	 * .
+	 * Compares two positions for repetition. The clocks don't count.
+	 * \param x
+	 * \param y
+	 * \return
+	 */
+	bool samePosition(const Board::State& x, const Board::State& y) {
+		return x.WP == y.WP && x.WN == y.WN && x.WB == y.WB && x.WR == y.WR && x.WQ == y.WQ && x.WK == y.WK
+			&& x.BP == y.BP && x.BN == y.BN && x.BB == y.BB && x.BR == y.BR && x.BQ == y.BQ && x.BK == y.BK
+			&& x.enPassant == y.enPassant && x.castlingRights == y.castlingRights && x.whiteTurn == y.whiteTurn;
+	}
+
+	/**
+	 * .
+	 * Checks if neither side has enough material to mate: bare kings, or a single minor piece against a bare king.
+	 * \return
+	 */
+	bool insufficientMaterial() {
+
+		if (Board::WP | Board::BP | Board::WR | Board::BR | Board::WQ | Board::BQ) return false;
+
+		std::uint64_t minors = Board::WN | Board::WB | Board::BN | Board::BB;
+
+		return (minors & (minors - 1)) == 0;
+
+	}
+
+	/**
+	 * .
+	 * Plays one game from an opening. Returns 1 if engine A wins, 0 for a draw and -1 if engine B wins.
+	 * \param opening
+	 * \param aWhite
+	 * \param cfg
+	 * \param tables the transposition tables of engine a and b
+	 * \return
+	 */
+	int playGame(const std::string& opening, bool aWhite, const Config& cfg, TT::Table (&tables)[2]) {
+
+		Board::loadFEN(opening);
+
+		for (int i = 0; i < 2; i++) {
+			Search::table = &tables[i];
+			Search::options = i == 0 ? cfg.a : cfg.b;
+			Search::clear();
+		}
+
+		std::vector<Board::State> history;
+
+		for (int ply = 0; ply < cfg.maxPlies; ply++) {
+
+			Board::State state = Board::save();
+
+			/*
+			* Checkmate, stalemate and the draw rules.
+			*/
+
+			if (Move::legalMoves().empty()) {
+				if (!Move::inCheck(Board::whiteTurn)) return 0;
+				return Board::whiteTurn == aWhite ? -1 : 1;
+			}
+
+			if (Board::fiftyDraw >= 100 || insufficientMaterial()) return 0;
+
+			int repeats{ 0 };
+			for (const Board::State& old : history) {
+				if (samePosition(old, state)) repeats++;
+			}
+			if (repeats >= 2) return 0;
+
+			history.push_back(state);
+
+			Search::options = Board::whiteTurn == aWhite ? cfg.a : cfg.b;
+			Search::table = &tables[Board::whiteTurn == aWhite ? 0 : 1];
+
+			Search::Result result = Search::search(cfg.limits, false);
+
+			//Played into Board::history, so both engines see repetitions of the game's earlier positions
+
+			Board::play(result.bestMove);
+
+		}
+
+		return 0;
+
+	}
+
+	/**
+	 * .
+	 * Makes an opening when there's no book by playing a few random legal moves from the starting position.
+	 * The moves are seeded by the pair number so both games of a pair (and every rerun) get the same opening.
+	 * \param seed
+	 * \return
+	 */
+	std::string randomOpening(int seed) {
+
+		std::mt19937 rng(seed);
+
+		while (true) {
+
+			Board::loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+			for (int ply = 0; ply < 8; ply++) {
+				std::vector<std::uint16_t> moves = Move::legalMoves();
+				if (moves.empty()) break;
+				Board::makeMove(moves[rng() % moves.size()]);
+			}
+
+			if (!Move::legalMoves().empty()) return Board::getFEN();
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Converts a score (0 to 1) to an Elo difference.
+	 * \param score
+	 * \return
+	 */
+	double elo(double score) {
+		if (score <= 0) score = 1e-6;
+		if (score >= 1) score = 1 - 1e-6;
+		return -400 * std::log10(1 / score - 1);
+	}
+
+	/**
+	 * .
+	 * Expected score for an Elo difference.
+	 * \param e
+	 * \return
+	 */
+	double expected(double e) {
+		return 1 / (1 + std::pow(10, -e / 400));
+	}
+
+	/**
+	 * .
+	 * Log-likelihood ratio of elo1 against elo0, using the normal approximation to the score distribution.
+	 * \param wins
+	 * \param draws
+	 * \param losses
+	 * \param elo0
+	 * \param elo1
+	 * \return
+	 */
+	double llr(int wins, int draws, int losses, double elo0, double elo1) {
+
+		double n = wins + draws + losses;
+		if (n == 0 || wins + losses == 0) return 0;
+
+		double s = (wins + draws * 0.5) / n;
+		double var = (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / n;
+		if (var <= 0) return 0;
+
+		double s0 = expected(elo0);
+		double s1 = expected(elo1);
+
+		return n * (s1 - s0) * (2 * s - s0 - s1) / (2 * var);
+
+	}
+
+	/**
+	 * .
+	 * Prints the standing of the match: results, Elo with a 95% margin, and the SPRT state.
+	 * \param wins
+	 * \param draws
+	 * \param losses
+	 * \param cfg
+	 * \param lower
+	 * \param upper
+	 */
+	void report(int wins, int draws, int losses, const Config& cfg, double lower, double upper) {
+
+		double n = wins + draws + losses;
+		double s = (wins + draws * 0.5) / n;
+		double var = (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / n;
+		double margin = 1.96 * std::sqrt(var / n);
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "games " << (int)n << " +" << wins << " =" << draws << " -" << losses
+			<< " score " << 100 * s << "% elo " << elo(s) << " +/- " << (elo(s + margin) - elo(s - margin)) / 2
+			<< std::setprecision(2) << " llr " << llr(wins, draws, losses, cfg.elo0, cfg.elo1)
+			<< " [" << lower << ", " << upper << "] (" << cfg.elo0 << ", " << cfg.elo1 << ")" << std::endl;
+
+		std::cout.unsetf(std::ios::fixed);
+
+	}
+
+	/**
+	 * .
+	 * Runs a match: match <games> <threads> <nodes|movetime ms> <book|-> [a.Option=value ...] [b.Option=value ...]
+	 * [elo0=x] [elo1=y] [maxplies=n]. Option names are the UCI setoption names. The book is an EPD or FEN file,
+	 * one opening per line. With "-" each pair of games starts from a few random moves.
+	 * \param input
+	 */
+	void match(const std::string& input) {
+
+		Config cfg;
+
+		std::istringstream reader{ input };
+		std::string name, limit{ "20000" }, book{ "-" }, token;
+
+		reader >> name >> cfg.games >> cfg.threads >> limit >> book;
+
+		if (limit.size() > 2 && limit.substr(limit.size() - 2) == "ms") cfg.limits.movetime = std::atoi(limit.c_str());
+		else cfg.limits.nodes = std::strtoull(limit.c_str(), nullptr, 10);
+
+		/*
+		* Engine options are given as a.Name=value and b.Name=value.
+		*/
+
+		while (reader >> token) {
+
+			std::size_t eq = token.find('=');
+			if (eq == std::string::npos) continue;
+
+			std::string key = token.substr(0, eq);
+			std::string value = token.substr(eq + 1);
+
+			bool ok{ true };
+
+			if (key.rfind("a.", 0) == 0) ok = Search::setOption(cfg.a, key.substr(2), value);
+			else if (key.rfind("b.", 0) == 0) ok = Search::setOption(cfg.b, key.substr(2), value);
+			else if (key == "elo0") cfg.elo0 = std::atof(value.c_str());
+			else if (key == "elo1") cfg.elo1 = std::atof(value.c_str());
+			else if (key == "maxplies") cfg.maxPlies = std::atoi(value.c_str());
+			else ok = false;
+
+			if (!ok) std::cout << "info string unknown match setting " << key << std::endl;
+
+		}
+
+		if (book != "-") {
+
+			std::ifstream in{ book };
+			std::string line;
+			EPD::Entry entry;
+
+			while (std::getline(in, line)) {
+				if (EPD::parse(line, entry)) cfg.openings.push_back(entry.fen);
+			}
+
+			if (cfg.openings.empty()) {
+				std::cout << "info string no openings in " << book << std::endl;
+				return;
+			}
+
+		}
+
+		if (cfg.threads < 1) cfg.threads = 1;
+		if (cfg.games < 2) cfg.games = 2;
+
+		const double alpha{ 0.05 }, beta{ 0.05 };
+		const double lower = std::log(beta / (1 - alpha));
+		const double upper = std::log((1 - beta) / alpha);
+
+		std::atomic<int> nextGame{ 0 };
+		std::atomic<bool> finished{ false };
+		std::mutex lock;
+		int wins{ 0 }, draws{ 0 }, losses{ 0 };
+		int reportEvery = cfg.threads * 2 > 20 ? cfg.threads * 2 : 20;
+
+		auto worker = [&]() {
+
+			TT::Table tables[2];
+
+			while (!finished) {
+
+				int game = nextGame++;
+				if (game >= cfg.games) return;
+
+				int pair = game / 2;
+				std::string opening = cfg.openings.empty() ? randomOpening(pair) : cfg.openings[pair % cfg.openings.size()];
+
+				int result = playGame(opening, game % 2 == 0, cfg, tables);
+
+				std::lock_guard<std::mutex> guard{ lock };
+
+				if (result > 0) wins++;
+				else if (result < 0) losses++;
+				else draws++;
+
+				int played = wins + draws + losses;
+				double ratio = llr(wins, draws, losses, cfg.elo0, cfg.elo1);
+
+				if (ratio <= lower || ratio >= upper) finished = true;
+
+				if (played % reportEvery == 0 && played < cfg.games && !finished) report(wins, draws, losses, cfg, lower, upper);
+
+			}
+
+		};
+
+		std::vector<std::thread> pool;
+		for (int i = 0; i < cfg.threads; i++) pool.emplace_back(worker);
+		for (std::thread& t : pool) t.join();
+
+		report(wins, draws, losses, cfg, lower, upper);
+
+		double ratio = llr(wins, draws, losses, cfg.elo0, cfg.elo1);
+		if (ratio >= upper) std::cout << "SPRT: H1 accepted (A is stronger by at least elo1)" << std::endl;
+		else if (ratio <= lower) std::cout << "SPRT: H0 accepted (A is not stronger by elo1)" << std::endl;
+		else std::cout << "SPRT: inconclusive" << std::endl;
+
+	}
+
+}
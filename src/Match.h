@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+namespace Match {
+
+	extern void match(const std::string& input);
+
+}
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Mate.h"
+#include "Board.h"
+#include "Move.h"
+#include "Search.h"
+
+/*
+Mate solver for "go mate N": depth-first proof-number search (df-pn) on the question "can the side to move mate
+within N moves?". The side to move (the attacker) needs one move that mates, the defender has to be mated after
+every reply, so the tree is an AND/OR tree and the search only cares about proving or disproving it, never about
+scores.
+
+Every node has a proof number (how many leaves still have to be shown to be mates for the attacker to win there)
+and a disproof number (how many to refute it). The search always follows the most proving node: the child with
+the smallest proof number at attacker nodes and the smallest disproof number at defender nodes, staying under
+it until its numbers pass thresholds derived from the siblings. A new node starts with the number of moves the
+defender has as its proof number, so forcing moves like checks are looked at first without special rules.
+
+The numbers live in the solver's own table, keyed by the Zobrist hash and the plies left, so a position reached
+with a different number of plies left is a different node; since the plies only go down the graph has no cycles.
+Mates are searched for in 1, 2, ... N moves, so the first one found is the shortest.
+*/
+
+namespace Mate {
+
+	/*
+	* Proof and disproof numbers. A proved node (there is a mate) has pn 0, a disproved one dn 0.
+	*/
+	struct Numbers {
+		std::uint32_t pn;
+		std::uint32_t dn;
+	};
+
+	constexpr std::uint32_t infinite{ 1u << 30 };
+
+	struct Entry {
+		std::uint64_t key;
+		Numbers numbers;
+	};
+
+	//Table entries (16 bytes each)
+
+	constexpr std::size_t tableSize{ 1 << 20 };
+
+	//Keys mixed into the hash for the number of plies left
+
+	inline constexpr std::array<std::uint64_t, Search::maxPly> plyKeys = [] {
+		std::array<std::uint64_t, Search::maxPly> keys{};
+		std::uint64_t state{ 0x4D415445ULL };
+		for (std::uint64_t& k : keys) {
+			std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			k = z ^ (z >> 31);
+		}
+		return keys;
+	}();
+
+	/*
+	* State of one solve.
+	*/
+	struct Solver {
+
+		std::vector<Entry> table;
+		Search::Limits limits;
+		std::uint64_t nodes{ 0 };
+		bool stopped{ false };
+		std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+		std::int64_t elapsed() const {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		std::uint64_t key(int plies) const {
+			return Board::hash ^ plyKeys[plies];
+		}
+
+		bool probe(std::uint64_t k, Numbers& numbers) const {
+			const Entry& e = table[k & (tableSize - 1)];
+			if (e.key != k) return false;
+			numbers = e.numbers;
+			return true;
+		}
+
+		void store(std::uint64_t k, Numbers numbers) {
+			table[k & (tableSize - 1)] = Entry{ k, numbers };
+		}
+
+		/**
+		 * .
+		 * Numbers of a position that hasn't been searched: mates and stalemates are decided, a position with no plies
+		 * left is disproved, anything else starts from the number of legal moves.
+		 * \param plies
+		 * \param attacker if the attacker is to move
+		 * \return
+		 */
+		Numbers initial(int plies, bool attacker) {
+
+			std::uint32_t count = (std::uint32_t)Move::legalMoves().size();
+
+			if (count == 0) {
+				if (!attacker && Move::inCheck(Board::whiteTurn)) return Numbers{ 0, infinite };
+				return Numbers{ infinite, 0 };
+			}
+
+			if (plies == 0) return Numbers{ infinite, 0 };
+
+			return attacker ? Numbers{ 1, count } : Numbers{ count, 1 };
+
+		}
+
+		/**
+		 * .
+		 * Numbers of the position after a move, from the table or computed and stored.
+		 * \param move
+		 * \param plies plies left after the move
+		 * \param attacker if the attacker is to move after the move
+		 * \return
+		 */
+		Numbers child(std::uint16_t move, int plies, bool attacker) {
+
+			Board::State state = Board::save();
+			Board::makeMove(move);
+
+			std::uint64_t k = key(plies);
+			Numbers numbers;
+
+			if (!probe(k, numbers)) {
+				numbers = initial(plies, attacker);
+				store(k, numbers);
+			}
+
+			Board::restore(state);
+
+			return numbers;
+
+		}
+
+		void checkLimits() {
+			if (limits.nodes && nodes >= limits.nodes) stopped = true;
+			if (limits.movetime && (nodes & 1023) == 0 && elapsed() >= limits.movetime) stopped = true;
+		}
+
+		/**
+		 * .
+		 * Searches a node until it's proved or disproved, or its numbers reach the thresholds. The node's numbers are
+		 * stored in the table.
+		 * \param plies
+		 * \param attacker
+		 * \param thresholdPn
+		 * \param thresholdDn
+		 * \return the node's numbers
+		 */
+		Numbers search(int plies, bool attacker, std::uint32_t thresholdPn, std::uint32_t thresholdDn) {
+
+			nodes++;
+			checkLimits();
+
+			std::vector<std::uint16_t> moves = Move::legalMoves();
+
+			std::uint64_t k = key(plies);
+
+			if (moves.empty() || plies == 0) {
+				Numbers numbers = initial(plies, attacker);
+				store(k, numbers);
+				return numbers;
+			}
+
+			std::vector<Numbers> children(moves.size());
+
+			while (true) {
+
+				/*
+				* Attacker nodes need one proved child and every child disproved, defender nodes the other way round.
+				* "best" is the most proving child: least pn for the attacker, least dn for the defender.
+				*/
+
+				std::uint32_t least{ infinite }, second{ infinite }, sum{ 0 };
+				std::size_t best{ 0 };
+
+				for (std::size_t i = 0; i < moves.size(); i++) {
+
+					children[i] = child(moves[i], plies - 1, !attacker);
+
+					std::uint32_t own = attacker ? children[i].pn : children[i].dn;
+					std::uint32_t other = attacker ? children[i].dn : children[i].pn;
+
+					if (own < least) {
+						second = least;
+						least = own;
+						best = i;
+					}
+					else if (own < second) second = own;
+
+					sum = std::min(infinite, sum + other);
+
+				}
+
+				Numbers numbers = attacker ? Numbers{ least, sum } : Numbers{ sum, least };
+				store(k, numbers);
+
+				if (numbers.pn >= thresholdPn || numbers.dn >= thresholdDn || stopped) return numbers;
+
+				/*
+				* The best child is searched until it stops being the best (its own number passes the second best) or
+				* the sum of the other numbers passes this node's threshold.
+				*/
+
+				std::uint32_t ownThreshold = std::min(attacker ? thresholdPn : thresholdDn, second == infinite ? infinite : second + 1);
+				std::uint32_t otherThreshold = attacker ? thresholdDn - numbers.dn + children[best].dn : thresholdPn - numbers.pn + children[best].pn;
+				otherThreshold = std::min(otherThreshold, infinite);
+
+				Board::State state = Board::save();
+				Board::makeMove(moves[best]);
+
+				if (attacker) search(plies - 1, false, ownThreshold, otherThreshold);
+				else search(plies - 1, true, otherThreshold, ownThreshold);
+
+				Board::restore(state);
+
+			}
+
+		}
+
+		/**
+		 * .
+		 * Shortest number of plies, up to the given one, in which the attacker mates from the current position.
+		 * \param plies
+		 * \param attacker if the attacker is to move
+		 * \return -1 if there's no mate within the plies
+		 */
+		int mateLength(int plies, bool attacker) {
+
+			for (int shorter = plies % 2; shorter <= plies && !stopped; shorter += 2) {
+				if (search(shorter, attacker, infinite, infinite).pn == 0) return shorter;
+			}
+
+			return -1;
+
+		}
+
+		/**
+		 * .
+		 * Follows the proof from the root: at attacker nodes the move that mates fastest, at defender nodes the reply
+		 * that holds out longest. Only moves proved in the table are measured.
+		 * \param plies
+		 * \return
+		 */
+		std::vector<std::uint16_t> principalVariation(int plies) {
+
+			std::vector<std::uint16_t> pv;
+			Board::State root = Board::save();
+
+			for (bool attacker = true; plies > 0; attacker = !attacker) {
+
+				std::uint16_t chosen{ 0 };
+				int chosenLength{ -1 };
+
+				for (std::uint16_t m : Move::legalMoves()) {
+
+					Board::State state = Board::save();
+					Board::makeMove(m);
+
+					Numbers numbers;
+					bool proved = probe(key(plies - 1), numbers) && numbers.pn == 0;
+
+					int length = proved ? mateLength(plies - 1, !attacker) : -1;
+
+					Board::restore(state);
+
+					if (length < 0) continue;
+
+					if (!chosen || (attacker ? length < chosenLength : length > chosenLength)) {
+						chosen = m;
+						chosenLength = length;
+					}
+
+				}
+
+				if (!chosen) break;
+
+				pv.push_back(chosen);
+				Board::makeMove(chosen);
+				plies = chosenLength;
+
+			}
+
+			Board::restore(root);
+
+			return pv;
+
+		}
+
+	};
+
+	/**
+	 * .
+	 * Looks for a mate in at most limits.mate moves for the side to move, within the node and time limits.
+	 * Returns a result without a best move if there is none or it wasn't found in time.
+	 * \param limits
+	 * \param print prints a UCI info line for the mate found
+	 * \return
+	 */
+	Search::Result solve(const Search::Limits& limits, bool print) {
+
+		Solver solver;
+		solver.table.assign(tableSize, Entry{});
+		solver.limits = limits;
+
+		Search::Result result;
+
+		int moves = std::min(limits.mate, (Search::maxPly - 1) / 2);
+
+		for (int n = 1; n <= moves && !solver.stopped; n++) {
+
+			int plies = 2 * n - 1;
+
+			Numbers numbers = solver.search(plies, true, infinite, infinite);
+
+			if (numbers.pn == 0) {
+				result.pv = solver.principalVariation(plies);
+				result.bestMove = result.pv.empty() ? 0 : result.pv[0];
+				result.score = Search::mateScore - plies;
+				result.depth = plies;
+				break;
+			}
+
+		}
+
+		result.nodes = solver.nodes;
+		result.time = solver.elapsed();
+
+		if (print && result.bestMove) Search::printInfo(result);
+		if (print && !result.bestMove) std::cout << "info string no mate in " << limits.mate << " found" << std::endl;
+
+		return result;
+
+	}
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Search.h"
+
+namespace Mate {
+
+	extern Search::Result solve(const Search::Limits& limits, bool print);
+
+}
@@ -1,9 +1,15 @@
 #include <vector>
 #include <bitset>
+#include <bit>
+#include <cstring>
+#include <string>
 
 #include "Move.h"
 #include "Board.h"
+#include "Attack.h"
 #include "Magic.h"
+#include "Stats.h"
+#include "Tables.h"
 
 namespace Move {
 
@@ -12,8 +18,7 @@ namespace Move {
 	Moves are represented by a 16 bit unsigned int.
 	Bits 0-5 represent the destination square (0-63. 0 is A8 and it goes right down to H1. 7 would be H8 and 8 would be A1.
 	Bits 6-11 represent the origin square.
-	Bits 12-13 represent the promo type if promoting. 0 is queen, 1 is knight, 2-3 can either be black queen/black knight OR bishop/rook,
-	depending on whether we care to include those as they're rarely needed
+	Bits 12-13 represent the promo type if promoting. 0 is queen, 1 is knight, 2 is bishop, 3 is rook.
 	Bits 14-15 represent a special move (0 - none, 1 - promo, 2 - en passant, 3 - castling)
 
 	"+" to a position here means right and down. "-" to a position means left and up. Remember it goes
@@ -57,35 +62,16 @@ namespace Move {
 		//A pawn can move up if it location shifted up 8 squares isn't occupied by any piece
 		std::uint64_t pawnUp	{ WP >> 8 & empty & ~Board::row8};
 		std::uint64_t pawnTwoUp	{ ((WP & Board::row2) >> 8 & empty) >> 8 & empty };
-		std::uint64_t pawnCapL	{ WP >> 9 & black & ~Board::row8};
-		std::uint64_t pawnCapR	{ WP >> 7 & black & ~Board::row8};
+		//Captures mask out the column on the far side so a pawn on the edge can't wrap around the board
+		std::uint64_t pawnCapL	{ WP >> 9 & black & ~Board::row8 & ~Board::colH };
+		std::uint64_t pawnCapR	{ WP >> 7 & black & ~Board::row8 & ~Board::colA };
 
 		std::uint64_t pawnPromoU{ WP >> 8 & empty & Board::row8 };
-		std::uint64_t pawnPromoR{ WP >> 7 & black & Board::row8 };
-		std::uint64_t pawnPromoL{ WP >> 9 & black & Board::row8 };
-
-		std::uint64_t enPR		{ WP >> 7 & enPassant};
-		std::uint64_t enPL		{ WP >> 9 & enPassant };
-
-		//The knight move variables here represent the direction they move. The first letter means they move 2 spaces in that direction, the second means they move 1 space.
-		//So "RU" means 2 right, 1 up
-		std::uint64_t knightRU	{ WN >> 6 & ~Board::colA & ~Board::colB & nWhite };
-		std::uint64_t knightLU	{ WN >> 10 & ~Board::colG & ~Board::colH & nWhite };
-		std::uint64_t knightUR	{ WN >> 15 & ~Board::colA & nWhite };
-		std::uint64_t knightUL	{ WN >> 17 & ~Board::colH & nWhite };
-		std::uint64_t knightLD	{ WN << 6 & ~Board::colH & ~Board::colG & nWhite };
-		std::uint64_t knightRD	{ WN << 10 & ~Board::colA & ~Board::colB & nWhite };
-		std::uint64_t knightDL	{ WN << 15 & ~Board::colH & nWhite };
-		std::uint64_t knightDR	{ WN << 17 & ~Board::colA & nWhite };
-		
-		std::uint64_t kingU		{ WK >> 8 & nWhite };
-		std::uint64_t kingR		{ WK << 1 & ~Board::colA & nWhite };
-		std::uint64_t kingL		{ WK >> 1 & ~Board::colH & nWhite };
-		std::uint64_t kingD		{ WK << 8 & nWhite };
-		std::uint64_t kingUR	{ WK >> 7 & ~Board::colA & nWhite };
-		std::uint64_t kingUL	{ WK >> 9 & ~Board::colH & nWhite };
-		std::uint64_t kingDR	{ WK << 9 & ~Board::colA & nWhite };
-		std::uint64_t kingDL	{ WK << 7 & ~Board::colH & nWhite };
+		std::uint64_t pawnPromoR{ WP >> 7 & black & Board::row8 & ~Board::colA };
+		std::uint64_t pawnPromoL{ WP >> 9 & black & Board::row8 & ~Board::colH };
+
+		std::uint64_t enPR		{ WP >> 7 & enPassant & ~Board::colA };
+		std::uint64_t enPL		{ WP >> 9 & enPassant & ~Board::colH };
 
 		for (int i = 0; i < 64; i++) {
 
@@ -102,16 +88,13 @@ namespace Move {
 				moves.push_back(i + (i + 7 << 6));
 			}
 			if (((pawnPromoU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 8 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i + 8 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i + 8 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((pawnPromoR >> i) & 1) == 1) {
-				moves.push_back(i + (i + 7 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i + 7 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i + 7 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((pawnPromoL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 9 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i + 9 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i + 9 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((enPR >> i) & 1) == 1) {
 				moves.push_back(i + (i + 7 << 6) + (2 << 14));
@@ -119,54 +102,6 @@ namespace Move {
 			if (((enPL >> i) & 1) == 1) {
 				moves.push_back(i + (i + 9 << 6) + (2 << 14));
 			}
-			if (((knightRU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 6 << 6));
-			}
-			if (((knightLU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 10 << 6));
-			}
-			if (((knightUR >> i) & 1) == 1) {
-				moves.push_back(i + (i + 15 << 6));
-			}
-			if (((knightUL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 17 << 6));
-			}
-			if (((knightLD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 6 << 6));
-			}
-			if (((knightRD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 10 << 6));
-			}
-			if (((knightDL >> i) & 1) == 1) {
-				moves.push_back(i + (i - 15 << 6));
-			}
-			if (((knightDR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 17 << 6));
-			}
-			if (((kingU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 8 << 6));
-			}
-			if (((kingR >> i) & 1) == 1) {
-				moves.push_back(i + (i -1 << 6));
-			}
-			if (((kingL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 1 << 6));
-			}
-			if (((kingD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 8 << 6));
-			}
-			if (((kingUR >> i) & 1) == 1) {
-				moves.push_back(i + (i + 7 << 6));
-			}
-			if (((kingUL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 9 << 6));
-			}
-			if (((kingDR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 9 << 6));
-			}
-			if (((kingDL >> i) & 1) == 1) {
-				moves.push_back(i + (i - 7 << 6));
-			}
 			if (((WR >> i) & 1) == 1) {
 				std::uint64_t poss = Magic::getRookMove(i) & nWhite;
 				for (int j = 0; j < 64; j++) {
@@ -192,13 +127,28 @@ namespace Move {
 				}
 			}
 		}
-		//Castling moves
-		//For now, castling won't account for attacked squares between king and the rook. This will be added later.
-		if ((empty & Board::shortPathW) == Board::shortPathW && castlingRights & Board::whiteKingside) {
-			moves.push_back(62 + (60 << 6) + (3 << 14));
+		//Knight and king moves are a single table lookup per piece
+		for (std::uint64_t b = WN; b; b &= b - 1) {
+			int from = std::countr_zero(b);
+			for (std::uint64_t t = Tables::knightAttacks[from] & nWhite; t; t &= t - 1) moves.push_back(std::countr_zero(t) + (from << 6));
+		}
+		for (std::uint64_t b = WK; b; b &= b - 1) {
+			int from = std::countr_zero(b);
+			for (std::uint64_t t = Tables::kingAttacks[from] & nWhite; t; t &= t - 1) moves.push_back(std::countr_zero(t) + (from << 6));
 		}
-		if ((empty & Board::longPathW) == Board::longPathW && castlingRights & Board::whiteQueenside) {
-			moves.push_back(58 + (60 << 6) + (3 << 14));
+
+		//Castling moves
+		//The king can't castle out of, through or into check. The attack map is only computed if a path is clear.
+		bool shortOpen = (empty & Board::shortPathW) == Board::shortPathW && castlingRights & Board::whiteKingside;
+		bool longOpen = (empty & Board::longPathW) == Board::longPathW && castlingRights & Board::whiteQueenside;
+		if (shortOpen || longOpen) {
+			std::uint64_t attacked = Attack::attackedBy(false);
+			if (shortOpen && !(attacked & (Board::arrOfSquares[60] | Board::arrOfSquares[61] | Board::arrOfSquares[62]))) {
+				moves.push_back(62 + (60 << 6) + (3 << 14));
+			}
+			if (longOpen && !(attacked & (Board::arrOfSquares[60] | Board::arrOfSquares[59] | Board::arrOfSquares[58]))) {
+				moves.push_back(58 + (60 << 6) + (3 << 14));
+			}
 		}
 
 		return moves;
@@ -236,35 +186,16 @@ namespace Move {
 		//A black pawn can move down if it location shifted down 8 squares isn't occupied by any piece
 		std::uint64_t pawnUp{ BP << 8 & empty & ~Board::row1 };
 		std::uint64_t pawnTwoUp{ ((BP & Board::row7) << 8 & empty) << 8 & empty };
-		std::uint64_t pawnCapL{ BP << 9 & white & ~Board::row1 };
-		std::uint64_t pawnCapR{ BP << 7 & white & ~Board::row1 };
+		//Captures mask out the column on the far side so a pawn on the edge can't wrap around the board
+		std::uint64_t pawnCapL{ BP << 9 & white & ~Board::row1 & ~Board::colA };
+		std::uint64_t pawnCapR{ BP << 7 & white & ~Board::row1 & ~Board::colH };
 
 		std::uint64_t pawnPromoU{ BP << 8 & empty & Board::row1 };
-		std::uint64_t pawnPromoR{ BP << 7 & white & Board::row1 };
-		std::uint64_t pawnPromoL{ BP << 9 & white & Board::row1 };
-
-		std::uint64_t enPR{ BP << 7 & enPassant };
-		std::uint64_t enPL{ BP << 9 & enPassant };
-
-		//The knight move variables here represent the direction they move. The first letter means they move 2 spaces in that direction, the second means they move 1 space.
-		//So "RU" means 2 right, 1 up
-		std::uint64_t knightRU{ BN >> 6 & ~Board::colA & ~Board::colB & nBlack };
-		std::uint64_t knightLU{ BN >> 10 & ~Board::colG & ~Board::colH & nBlack };
-		std::uint64_t knightUR{ BN >> 15 & ~Board::colA & nBlack };
-		std::uint64_t knightUL{ BN >> 17 & ~Board::colH & nBlack };
-		std::uint64_t knightLD{ BN << 6 & ~Board::colH & ~Board::colG & nBlack };
-		std::uint64_t knightRD{ BN << 10 & ~Board::colA & ~Board::colB & nBlack };
-		std::uint64_t knightDL{ BN << 15 & ~Board::colH & nBlack };
-		std::uint64_t knightDR{ BN << 17 & ~Board::colA & nBlack };
-
-		std::uint64_t kingU{ BK >> 8 & nBlack };
-		std::uint64_t kingR{ BK << 1 & ~Board::colA & nBlack };
-		std::uint64_t kingL{ BK >> 1 & ~Board::colH & nBlack };
-		std::uint64_t kingD{ BK << 8 & nBlack };
-		std::uint64_t kingUR{ BK >> 7 & ~Board::colA & nBlack };
-		std::uint64_t kingUL{ BK >> 9 & ~Board::colH & nBlack};
-		std::uint64_t kingDR{ BK << 9 & ~Board::colA & nBlack };
-		std::uint64_t kingDL{ BK << 7 & ~Board::colH & nBlack };
+		std::uint64_t pawnPromoR{ BP << 7 & white & Board::row1 & ~Board::colH };
+		std::uint64_t pawnPromoL{ BP << 9 & white & Board::row1 & ~Board::colA };
+
+		std::uint64_t enPR{ BP << 7 & enPassant & ~Board::colH };
+		std::uint64_t enPL{ BP << 9 & enPassant & ~Board::colA };
 
 		for (int i = 0; i < 64; i++) {
 
@@ -281,70 +212,19 @@ namespace Move {
 				moves.push_back(i + (i - 7 << 6));
 			}
 			if (((pawnPromoU >> i) & 1) == 1) {
-				moves.push_back(i + (i - 8 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i - 8 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i - 8 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((pawnPromoR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 9 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i - 9 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i - 7 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((pawnPromoL >> i) & 1) == 1) {
-				moves.push_back(i + (i - 7 << 6) + (0 << 12) + (1 << 14));
-				moves.push_back(i + (i - 7 << 6) + (1 << 12) + (1 << 14));
+				for (int p = 0; p < 4; p++) moves.push_back(i + (i - 9 << 6) + (p << 12) + (1 << 14));
 			}
 			if (((enPR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 9 << 6) + (2 << 14));
-			}
-			if (((enPL >> i) & 1) == 1) {
 				moves.push_back(i + (i - 7 << 6) + (2 << 14));
 			}
-			if (((knightRU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 6 << 6));
-			}
-			if (((knightLU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 10 << 6));
-			}
-			if (((knightUR >> i) & 1) == 1) {
-				moves.push_back(i + (i + 15 << 6));
-			}
-			if (((knightUL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 17 << 6));
-			}
-			if (((knightLD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 6 << 6));
-			}
-			if (((knightRD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 10 << 6));
-			}
-			if (((knightDL >> i) & 1) == 1) {
-				moves.push_back(i + (i - 15 << 6));
-			}
-			if (((knightDR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 17 << 6));
-			}
-			if (((kingU >> i) & 1) == 1) {
-				moves.push_back(i + (i + 8 << 6));
-			}
-			if (((kingR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 1 << 6));
-			}
-			if (((kingL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 1 << 6));
-			}
-			if (((kingD >> i) & 1) == 1) {
-				moves.push_back(i + (i - 8 << 6));
-			}
-			if (((kingUR >> i) & 1) == 1) {
-				moves.push_back(i + (i + 7 << 6));
-			}
-			if (((kingUL >> i) & 1) == 1) {
-				moves.push_back(i + (i + 9 << 6));
-			}
-			if (((kingDR >> i) & 1) == 1) {
-				moves.push_back(i + (i - 9 << 6));
-			}
-			if (((kingDL >> i) & 1) == 1) {
-				moves.push_back(i + (i - 7 << 6));
+			if (((enPL >> i) & 1) == 1) {
+				moves.push_back(i + (i - 9 << 6) + (2 << 14));
 			}
 			if (((BR >> i) & 1) == 1) {
 				std::uint64_t poss = Magic::getRookMove(i) & nBlack;
@@ -371,16 +251,375 @@ namespace Move {
 				}
 			}
 		}
-		//Castling moves
-		//For now, castling won't account for attacked squares between king and the rook. This will be added later.
-		if ((empty & Board::shortPathB) == Board::shortPathB && castlingRights & Board::blackKingside) {
-			moves.push_back(62 + (60 << 6) + (3 << 14));
+		//Knight and king moves are a single table lookup per piece
+		for (std::uint64_t b = BN; b; b &= b - 1) {
+			int from = std::countr_zero(b);
+			for (std::uint64_t t = Tables::knightAttacks[from] & nBlack; t; t &= t - 1) moves.push_back(std::countr_zero(t) + (from << 6));
 		}
-		if ((empty & Board::longPathB) == Board::longPathB && castlingRights & Board::blackQueenside) {
-			moves.push_back(58 + (60 << 6) + (3 << 14));
+		for (std::uint64_t b = BK; b; b &= b - 1) {
+			int from = std::countr_zero(b);
+			for (std::uint64_t t = Tables::kingAttacks[from] & nBlack; t; t &= t - 1) moves.push_back(std::countr_zero(t) + (from << 6));
+		}
+
+		//Castling moves
+		//The king can't castle out of, through or into check. The attack map is only computed if a path is clear.
+		bool shortOpen = (empty & Board::shortPathB) == Board::shortPathB && castlingRights & Board::blackKingside;
+		bool longOpen = (empty & Board::longPathB) == Board::longPathB && castlingRights & Board::blackQueenside;
+		if (shortOpen || longOpen) {
+			std::uint64_t attacked = Attack::attackedBy(true);
+			if (shortOpen && !(attacked & (Board::arrOfSquares[4] | Board::arrOfSquares[5] | Board::arrOfSquares[6]))) {
+				moves.push_back(6 + (4 << 6) + (3 << 14));
+			}
+			if (longOpen && !(attacked & (Board::arrOfSquares[4] | Board::arrOfSquares[3] | Board::arrOfSquares[2]))) {
+				moves.push_back(2 + (4 << 6) + (3 << 14));
+			}
 		}
 
 		return moves;
 	}
 
+	/**
+	 * .
+	 * Generates the pseudo-legal moves of the side to move in the current board representation.
+	 * \return
+	 */
+	std::vector<std::uint16_t> generate() {
+
+		Stats::Timer timer{ Stats::movegenNs };
+
+		std::vector<std::uint16_t> moves = Board::whiteTurn
+			? whiteMove(Board::WP, Board::WN, Board::WB, Board::WR, Board::WQ, Board::WK, Board::BP, Board::BN, Board::BB, Board::BR, Board::BQ, Board::BK, Board::castlingRights, Board::enPassant)
+			: blackMove(Board::WP, Board::WN, Board::WB, Board::WR, Board::WQ, Board::WK, Board::BP, Board::BN, Board::BB, Board::BR, Board::BQ, Board::BK, Board::castlingRights, Board::enPassant);
+
+		Stats::add(Stats::movegenCalls);
+		Stats::add(Stats::movesGenerated, moves.size());
+
+		return moves;
+
+	}
+
+	/**
+	 * .
+	 * Checks if the king of the given side is attacked.
+	 * \param white
+	 * \return
+	 */
+	bool inCheck(bool white) {
+
+		std::uint64_t king = white ? Board::WK : Board::BK;
+
+		if (!king) return false;
+
+		return Attack::isSquareAttacked(std::countr_zero(king), !white);
+
+	}
+
+	/**
+	 * .
+	 * Plays a pseudo-legal move and checks that it didn't leave the mover's king in check. Castling through check
+	 * is already ruled out by movegen. Returns false if the move is illegal; the board is then left in an
+	 * unspecified state and has to be restored by the caller.
+	 * \param move
+	 * \return
+	 */
+	bool makeLegal(std::uint16_t move) {
+
+		bool white = Board::whiteTurn;
+
+		Board::makeMove(move);
+
+		return !inCheck(white);
+
+	}
+
+	/**
+	 * .
+	 * Generates the legal moves of the side to move.
+	 * \return
+	 */
+	std::vector<std::uint16_t> legalMoves() {
+
+		std::vector<std::uint16_t> moves = generate();
+		std::vector<std::uint16_t> legal;
+
+		Board::State state = Board::save();
+
+		for (std::uint16_t m : moves) {
+			if (makeLegal(m)) legal.push_back(m);
+			Board::restore(state);
+		}
+
+		return legal;
+
+	}
+
+	/**
+	 * .
+	 * Converts a square index to algebraic notation (0 is a8, 63 is h1).
+	 * \param sq
+	 * \return
+	 */
+	std::string squareName(int sq) {
+		std::string name;
+		name += (char)('a' + sq % 8);
+		name += (char)('0' + 8 - sq / 8);
+		return name;
+	}
+
+	/**
+	 * .
+	 * Converts a move to UCI long algebraic notation, e.g. e2e4 or a7a8q.
+	 * \param move
+	 * \return
+	 */
+	std::string toUCI(std::uint16_t move) {
+
+		std::string uci = squareName((move & fromMask) >> 6) + squareName(move & toMask);
+
+		if ((move & specMask) >> 14 == 1) uci += "qnbr"[(move & promoMask) >> 12];
+
+		return uci;
+
+	}
+
+	/**
+	 * .
+	 * Converts a move in UCI long algebraic notation to the 16 bit representation, by finding it among the legal
+	 * moves of the current position (which sets the castling, en passant and promotion flags). Returns 0 if the
+	 * move isn't legal.
+	 * \param uci
+	 * \return
+	 */
+	std::uint16_t fromUCI(const std::string& uci) {
+
+		for (std::uint16_t move : legalMoves()) {
+			if (toUCI(move) == uci) return move;
+		}
+
+		return 0;
+
+	}
+
+	/**
+	 * .
+	 * Converts a legal move in the current position to standard algebraic notation, including check and mate marks.
+	 * \param move
+	 * \return
+	 */
+	std::string toSAN(std::uint16_t move) {
+
+		int to = move & toMask;
+		int from = (move & fromMask) >> 6;
+		int special = (move & specMask) >> 14;
+
+		std::string san;
+
+		if (special == 3) {
+			san = to % 8 == 6 ? "O-O" : "O-O-O";
+		}
+		else {
+
+			int piece = Board::pieceAt(from) % 6;
+			bool capture = Board::pieceAt(to) != -1 || special == 2;
+
+			if (piece == 0) {
+				if (capture) san += (char)('a' + from % 8);
+			}
+			else {
+
+				san += "PNBRQK"[piece];
+
+				/*
+				* If another piece of the same type can reach the same square, add its column, row, or both.
+				*/
+
+				bool ambiguous{ false }, sameCol{ false }, sameRow{ false };
+
+				for (std::uint16_t m : legalMoves()) {
+					int otherFrom = (m & fromMask) >> 6;
+					if ((m & toMask) != to || otherFrom == from || Board::pieceAt(otherFrom) % 6 != piece) continue;
+					ambiguous = true;
+					if (otherFrom % 8 == from % 8) sameCol = true;
+					if (otherFrom / 8 == from / 8) sameRow = true;
+				}
+
+				if (ambiguous) {
+					if (!sameCol) san += (char)('a' + from % 8);
+					else if (!sameRow) san += (char)('0' + 8 - from / 8);
+					else san += squareName(from);
+				}
+
+			}
+
+			if (capture) san += 'x';
+
+			san += squareName(to);
+
+			if (special == 1) {
+				san += '=';
+				san += "QNBR"[(move & promoMask) >> 12];
+			}
+
+		}
+
+		Board::State state = Board::save();
+
+		Board::makeMove(move);
+
+		if (inCheck(Board::whiteTurn)) san += legalMoves().empty() ? '#' : '+';
+
+		Board::restore(state);
+
+		return san;
+
+	}
+
+	/**
+	 * .
+	 * Converts a move in standard algebraic notation (as in PGN: Nbd7, exd6, e8=Q, O-O-O, with or without check
+	 * marks and annotations) to the 16 bit representation. Instead of generating every move, the pieces that can
+	 * reach the destination are found with the attack tables, and only those are tried for legality, usually just
+	 * one. Returns 0 if no legal move fits, or if the notation is ambiguous.
+	 * \param san
+	 * \return
+	 */
+	std::uint16_t fromSAN(const std::string& san) {
+
+		std::size_t length = san.size();
+		while (length && (san[length - 1] == '+' || san[length - 1] == '#' || san[length - 1] == '!' || san[length - 1] == '?')) length--;
+
+		if (length < 2) return 0;
+
+		Board::State state = Board::save();
+		std::uint16_t found{ 0 };
+
+		/*
+		* Castling is rare enough to look up among the generated moves.
+		*/
+
+		if (san[0] == 'O' || san[0] == '0') {
+
+			int column = length >= 5 ? 2 : 6;
+
+			for (std::uint16_t m : generate()) {
+				if ((m & specMask) >> 14 != 3 || (m & toMask) % 8 != column) continue;
+				bool legal = makeLegal(m);
+				Board::restore(state);
+				if (legal) return m;
+			}
+
+			return 0;
+
+		}
+
+		int piece{ 0 }, fromFile{ -1 }, fromRank{ -1 }, promo{ -1 };
+		std::size_t i{ 0 };
+
+		if (const char* p = std::strchr("NBRQK", san[0]); p && *p) {
+			piece = (int)(p - "NBRQK") + 1;
+			i++;
+		}
+
+		/*
+		* A promotion is the last thing before the marks: e8=Q, or e8Q in some files.
+		*/
+
+		if (piece == 0 && length >= 3) {
+			if (const char* p = std::strchr("QNBRqnbr", san[length - 1]); p && *p) {
+				promo = (int)(p - "QNBRqnbr") % 4;
+				length -= san[length - 2] == '=' ? 2 : 1;
+			}
+		}
+
+		if (length < i + 2) return 0;
+
+		int file = san[length - 2] - 'a', rank = san[length - 1] - '1';
+		if (file < 0 || file > 7 || rank < 0 || rank > 7) return 0;
+
+		int to = (7 - rank) * 8 + file;
+
+		for (; i < length - 2; i++) {
+			if (san[i] >= 'a' && san[i] <= 'h') fromFile = san[i] - 'a';
+			else if (san[i] >= '1' && san[i] <= '8') fromRank = 7 - (san[i] - '1');
+			else if (san[i] != 'x' && san[i] != '-' && san[i] != ':') return 0;
+		}
+
+		bool white = Board::whiteTurn;
+		const std::uint64_t own[6] = { white ? Board::WP : Board::BP, white ? Board::WN : Board::BN, white ? Board::WB : Board::BB,
+			white ? Board::WR : Board::BR, white ? Board::WQ : Board::BQ, white ? Board::WK : Board::BK };
+
+		std::uint64_t occupied = Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			| Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK;
+		std::uint64_t ownAll = own[0] | own[1] | own[2] | own[3] | own[4] | own[5];
+
+		if (ownAll >> to & 1) return 0;
+
+		/*
+		* The squares a piece of the type could have come from. A pawn comes from straight behind (one or two
+		* squares) or, capturing, diagonally behind on the given column.
+		*/
+
+		std::uint64_t from{ 0 };
+		int back = white ? 8 : -8;
+
+		switch (piece) {
+		case 0: {
+			if (fromFile >= 0 && fromFile != file) {
+				if (fromFile - file == 1 || file - fromFile == 1) {
+					int sq = to + back + fromFile - file;
+					if (sq >= 0 && sq < 64) from = 1ULL << sq;
+				}
+			}
+			else if (!(occupied >> to & 1)) {
+				int one = to + back;
+				if (one >= 0 && one < 64) {
+					if (own[0] >> one & 1) from = 1ULL << one;
+					else if (!(occupied >> one & 1) && to / 8 == (white ? 4 : 3)) from = 1ULL << (one + back);
+				}
+			}
+			break;
+		}
+		case 1: from = Tables::knightAttacks[to]; break;
+		case 2: from = Magic::getBishopMove(to, occupied); break;
+		case 3: from = Magic::getRookMove(to, occupied); break;
+		case 4: from = Magic::getBishopMove(to, occupied) | Magic::getRookMove(to, occupied); break;
+		case 5: from = Tables::kingAttacks[to]; break;
+		}
+
+		from &= own[piece];
+		if (fromFile >= 0) from &= Board::colA << fromFile;
+		if (fromRank >= 0) from &= 0xFFULL << (fromRank * 8);
+
+		bool lastRank = to / 8 == (white ? 0 : 7);
+
+		if (piece == 0 && lastRank != (promo >= 0)) return 0;
+		if (piece != 0 && promo >= 0) return 0;
+
+		for (; from; from &= from - 1) {
+
+			int sq = std::countr_zero(from);
+			std::uint16_t m = (std::uint16_t)(to | sq << 6);
+
+			if (piece == 0) {
+				if (promo >= 0) m |= promo << 12 | 1 << 14;
+				else if (sq % 8 != to % 8 && !(occupied >> to & 1)) {
+					if (!(Board::enPassant >> to & 1)) continue;
+					m |= 2 << 14;
+				}
+			}
+
+			bool legal = makeLegal(m);
+			Board::restore(state);
+
+			if (!legal) continue;
+			if (found) return 0;
+
+			found = m;
+
+		}
+
+		return found;
+
+	}
+
 }
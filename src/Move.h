@@ -1,6 +1,9 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace Move {
 
@@ -12,6 +15,24 @@ namespace Move {
 		std::uint64_t BP, std::uint64_t BN, std::uint64_t BB, std::uint64_t BR, std::uint64_t BQ, std::uint64_t BK,
 		std::uint8_t castlingRights, std::uint64_t enPassant);
 
+	extern std::vector<std::uint16_t> generate();
+
+	extern bool inCheck(bool white);
+
+	extern bool makeLegal(std::uint16_t move);
+
+	extern std::vector<std::uint16_t> legalMoves();
+
+	extern std::string squareName(int sq);
+
+	extern std::string toUCI(std::uint16_t move);
+
+	extern std::uint16_t fromUCI(const std::string& uci);
+
+	extern std::string toSAN(std::uint16_t move);
+
+	extern std::uint16_t fromSAN(const std::string& san);
+
 	extern std::uint16_t toMask;
 	extern std::uint16_t fromMask;
 	extern std::uint16_t promoMask;
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#include "Numa.h"
+
+/*
+The NUMA layout of the machine, and binding search threads to it. On a multi-socket machine memory belongs to one
+socket's node, and reading another node's memory is slower and shares the link between sockets. Threads are bound
+to cores round robin over the nodes, so they're spread evenly, and each one reads the copy of the read-only tables
+made on its own node (see Magic::replicate).
+
+On Linux the layout comes from /sys/devices/system/node, limited to the CPUs this process may run on, and threads
+are bound with sched_setaffinity. On Windows each node's processor group mask is used. On a machine with a single
+node (or where the layout can't be read) there's nothing to do and bind() doesn't touch the thread.
+*/
+
+namespace Numa {
+
+#ifdef _WIN32
+	using Cpus = GROUP_AFFINITY;
+#else
+	using Cpus = std::vector<int>;
+#endif
+
+	//The CPUs of every node this process can run on, read once
+	std::vector<Cpus> layout;
+	std::once_flag layoutRead;
+
+	//The affinity a thread had before its first bind, for unbind
+
+#ifdef _WIN32
+	thread_local GROUP_AFFINITY before;
+#else
+	thread_local cpu_set_t before;
+#endif
+	thread_local bool bound{ false };
+
+#ifndef _WIN32
+	/**
+	 * .
+	 * Parses a Linux CPU list, like "0-15,32-47".
+	 * \param list
+	 * \return
+	 */
+	std::vector<int> parseList(const std::string& list) {
+
+		std::vector<int> cpus;
+		std::istringstream in{ list };
+		std::string range;
+
+		while (std::getline(in, range, ',')) {
+			if (range.empty() || range[0] < '0' || range[0] > '9') continue;
+			std::size_t dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+		}
+
+		return cpus;
+
+	}
+#endif
+
+	void readLayout() {
+
+#ifdef _WIN32
+		ULONG highest{ 0 };
+		if (!GetNumaHighestNodeNumber(&highest)) return;
+
+		for (USHORT node = 0; node <= highest; node++) {
+			GROUP_AFFINITY affinity{};
+			if (GetNumaNodeProcessorMaskEx(node, &affinity) && affinity.Mask) layout.push_back(affinity);
+		}
+#else
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+
+		std::ifstream online{ "/sys/devices/system/node/online" };
+		std::string list;
+		if (!std::getline(online, list)) return;
+
+		for (int node : parseList(list)) {
+
+			std::ifstream in{ "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist" };
+			std::string cpuList;
+			if (!std::getline(in, cpuList)) continue;
+
+			Cpus cpus;
+			for (int cpu : parseList(cpuList)) {
+				if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+			}
+
+			//Nodes with memory but no usable CPUs can't run threads
+			if (!cpus.empty()) layout.push_back(cpus);
+
+		}
+#endif
+
+	}
+
+	/**
+	 * .
+	 * Returns the number of NUMA nodes threads can run on, at least 1.
+	 * \return
+	 */
+	int nodes() {
+		std::call_once(layoutRead, readLayout);
+		return std::max<int>(1, (int)layout.size());
+	}
+
+	/**
+	 * .
+	 * Binds the calling thread to a core for the given thread number, going round the nodes so consecutive threads
+	 * land on different nodes. Returns the node the thread is on now, the one whose table copies it should read.
+	 * Leaves the thread alone and returns 0 on a single node machine.
+	 * \param thread
+	 * \return
+	 */
+	int bind(int thread) {
+
+		if (nodes() == 1) return 0;
+
+		int node = thread % (int)layout.size();
+
+#ifdef _WIN32
+		if (!bound) bound = GetThreadGroupAffinity(GetCurrentThread(), &before);
+
+		GROUP_AFFINITY affinity = layout[node];
+		if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) return 0;
+#else
+		if (!bound) bound = sched_getaffinity(0, sizeof(before), &before) == 0;
+
+		const Cpus& cpus = layout[node];
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[(thread / layout.size()) % cpus.size()], &set);
+
+		if (sched_setaffinity(0, sizeof(set), &set) != 0) return 0;
+#endif
+
+		return node;
+
+	}
+
+	/**
+	 * .
+	 * Puts the calling thread back on the CPUs it could run on before it was first bound. For threads that outlive
+	 * the search they were bound for, like the one the search is called on.
+	 */
+	void unbind() {
+
+		if (!bound) return;
+
+#ifdef _WIN32
+		SetThreadGroupAffinity(GetCurrentThread(), &before, nullptr);
+#else
+		sched_setaffinity(0, sizeof(before), &before);
+#endif
+
+		bound = false;
+
+	}
+
+	/**
+	 * .
+	 * Describes the layout, for info string output.
+	 * \return
+	 */
+	std::string describe() {
+
+		std::ostringstream out;
+		int count = nodes();
+
+		out << count << (count == 1 ? " node" : " nodes");
+
+#ifndef _WIN32
+		for (std::size_t node = 0; node < layout.size(); node++) out << (node ? ", " : " (") << layout[node].size() << " cpus" << (node + 1 == layout.size() ? ")" : "");
+#endif
+
+		return out.str();
+
+	}
+
+}
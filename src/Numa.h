@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace Numa {
+
+	extern int nodes();
+
+	extern int bind(int thread);
+
+	extern void unbind();
+
+	extern std::string describe();
+
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "PGN.h"
+#include "Board.h"
+#include "FileMap.h"
+#include "Move.h"
+#include "Pack.h"
+
+/*
+Position extraction from PGN game databases:
+
+pgn <file> <out> [threads] [minelo=<rating>] [skip=<plies>] [<Tag>=<value>]...
+
+The file is mapped and split into byte ranges, one per thread; each range is moved forward to the start of a game
+(a tag line after a blank line), so threads parse whole games independently. Nothing is copied out of the mapping
+except the tags a filter needs and each move's few characters. Moves are resolved with Move::fromSAN, which only
+checks the one or two pseudo-legal moves that fit the notation.
+
+Every position of every game that passes the filters is written, from ply skip on, to the output: packed records
+if its name ends in .pack (see Pack.h), otherwise one line per position with the FEN and the game's result, the
+text format the tuner reads. minelo keeps games where both WhiteElo and BlackElo are at least the rating; every
+other key=value must equal a tag of the game exactly (e.g. Result=1-0, Event=Rated Blitz game, with spaces as
+underscores). Games with a FEN tag start from it, and are skipped if it's invalid; games of other variants are
+skipped. A game with a move that can't be read keeps its positions up to that move.
+
+Threads write their output in blocks, so with more than one thread the games are not in the order of the file.
+*/
+
+namespace PGN {
+
+	//Text kept per thread before it's written out, and the same for packed records
+
+	constexpr std::size_t flushBytes{ 1 << 20 };
+	constexpr std::size_t flushRecords{ 1 << 15 };
+
+	struct Config {
+		std::string file;
+		std::string out;
+		int threads{ 1 };
+		int minElo{ 0 };
+		int skip{ 0 };
+		std::vector<std::pair<std::string, std::string>> tags;
+		bool packed{ false };
+	};
+
+	/*
+	* Where the threads' output goes, a block at a time.
+	*/
+	struct Output {
+		std::mutex lock;
+		std::ofstream text;
+		Pack::Writer pack;
+	};
+
+	/*
+	* What the threads counted.
+	*/
+	struct Counts {
+		std::atomic<std::uint64_t> games{ 0 };
+		std::atomic<std::uint64_t> kept{ 0 };
+		std::atomic<std::uint64_t> moves{ 0 };
+		std::atomic<std::uint64_t> positions{ 0 };
+		std::atomic<std::uint64_t> errors{ 0 };
+		std::atomic<std::uint64_t> invalid{ 0 };	//games skipped for a FEN tag that can't be loaded
+	};
+
+	/*
+	* One game's tags. Values point into the mapping and still have their escapes.
+	*/
+	struct Tags {
+		std::vector<std::pair<std::string_view, std::string_view>> list;
+
+		std::string_view operator[](std::string_view name) const {
+			for (const auto& [key, value] : list) if (key == name) return value;
+			return {};
+		}
+	};
+
+	bool space(char c) {
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	/**
+	 * .
+	 * Start of the first game that begins at or after a byte: the first tag line that follows a blank line.
+	 * \param text
+	 * \param at
+	 * \return
+	 */
+	std::size_t gameStart(std::string_view text, std::size_t at) {
+
+		if (at == 0) return 0;
+
+		bool blank{ false };
+
+		for (std::size_t line = text.find('\n', at - 1); line != std::string_view::npos; line = text.find('\n', line + 1)) {
+
+			std::size_t begin = line + 1;
+			if (begin >= text.size()) break;
+
+			if (text[begin] == '[' && blank) return begin;
+
+			std::size_t end = text.find('\n', begin);
+			std::string_view content = text.substr(begin, (end == std::string_view::npos ? text.size() : end) - begin);
+			blank = content.find_first_not_of(" \t\r") == std::string_view::npos;
+
+		}
+
+		return text.size();
+
+	}
+
+	/**
+	 * .
+	 * Reads the tag lines of a game, starting at pos. Leaves pos at the movetext.
+	 * \param text
+	 * \param pos
+	 * \param tags
+	 */
+	void readTags(std::string_view text, std::size_t& pos, Tags& tags) {
+
+		tags.list.clear();
+
+		while (true) {
+
+			while (pos < text.size() && space(text[pos])) pos++;
+			if (pos >= text.size() || text[pos] != '[') return;
+
+			std::size_t end = text.find('\n', pos);
+			if (end == std::string_view::npos) end = text.size();
+
+			std::string_view line = text.substr(pos + 1, end - pos - 1);
+			pos = end;
+
+			std::size_t nameEnd = line.find(' ');
+			std::size_t open = line.find('"');
+			std::size_t close = line.rfind('"');
+
+			if (nameEnd == std::string_view::npos || open == std::string_view::npos || close <= open) continue;
+
+			tags.list.push_back({ line.substr(0, nameEnd), line.substr(open + 1, close - open - 1) });
+
+		}
+
+	}
+
+	/**
+	 * .
+	 * Checks a game's tags against the filters.
+	 * \param tags
+	 * \param cfg
+	 * \return
+	 */
+	bool wanted(const Tags& tags, const Config& cfg) {
+
+		std::string_view variant = tags["Variant"];
+		if (!variant.empty() && variant != "Standard" && variant != "standard" && variant != "From Position") return false;
+
+		if (cfg.minElo) {
+			if (std::atoi(std::string(tags["WhiteElo"]).c_str()) < cfg.minElo) return false;
+			if (std::atoi(std::string(tags["BlackElo"]).c_str()) < cfg.minElo) return false;
+		}
+
+		for (const auto& [name, value] : cfg.tags) {
+			if (tags[name] != value) return false;
+		}
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * The result of a game in Pack's terms, from a tag value or a game termination marker.
+	 * \param result
+	 * \return
+	 */
+	std::uint8_t packResult(std::string_view result) {
+		if (result == "1-0") return Pack::whiteWin;
+		if (result == "0-1") return Pack::blackWin;
+		if (result == "1/2-1/2") return Pack::draw;
+		return Pack::noResult;
+	}
+
+	/*
+	* One thread's work: its own board and output buffers.
+	*/
+	struct Worker {
+
+		const Config& cfg;
+		Output& output;
+		Counts& counts;
+
+		Board::State start;
+		std::string text;
+		std::vector<Pack::Record> records;
+
+		Worker(const Config& c, Output& o, Counts& n) : cfg{ c }, output{ o }, counts{ n } {
+			Board::loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+			start = Board::save();
+		}
+
+		void flush() {
+
+			std::lock_guard<std::mutex> guard{ output.lock };
+
+			if (cfg.packed) for (const Pack::Record& rec : records) output.pack.write(rec);
+			else output.text.write(text.data(), (std::streamsize)text.size());
+
+			records.clear();
+			text.clear();
+
+		}
+
+		void emit(std::uint8_t result, std::string_view resultText) {
+
+			if (cfg.packed) {
+				Pack::Record rec;
+				if (Pack::pack(rec, result)) records.push_back(rec);
+				if (records.size() >= flushRecords) flush();
+			}
+			else {
+				text += Board::getFEN();
+				if (!resultText.empty()) {
+					text += ' ';
+					text += resultText;
+				}
+				text += '\n';
+				if (text.size() >= flushBytes) flush();
+			}
+
+			counts.positions.fetch_add(1, std::memory_order_relaxed);
+
+		}
+
+		/**
+		 * .
+		 * Parses the game at pos and writes its positions if it passes the filters. Leaves pos after the game.
+		 * \param data
+		 * \param pos
+		 * \param tags
+		 */
+		void game(std::string_view data, std::size_t& pos, Tags& tags) {
+
+			readTags(data, pos, tags);
+
+			bool keep = wanted(tags, cfg);
+
+			std::string_view fen = tags["FEN"];
+			std::string_view resultText = tags["Result"];
+			std::uint8_t result = packResult(resultText);
+			if (result == Pack::noResult) resultText = {};
+
+			if (keep && !fen.empty() && !Board::validFEN(std::string(fen))) {
+				keep = false;
+				counts.invalid.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (keep) {
+				if (fen.empty()) Board::restore(start);
+				else Board::loadFEN(std::string(fen));
+			}
+
+			int ply{ 0 };
+			bool broken{ !keep };
+			std::uint64_t moves{ 0 };
+			std::string san;
+
+			/*
+			* The movetext: move numbers, moves, comments ({...} or ; to the end of the line), variations (skipped,
+			* nested), NAGs and the termination marker. The next game's tags also end it.
+			*/
+
+			while (pos < data.size()) {
+
+				char c = data[pos];
+
+				if (space(c)) {
+					pos++;
+					continue;
+				}
+
+				if (c == '[' && pos && data[pos - 1] == '\n') break;
+
+				if (c == '{') {
+					std::size_t end = data.find('}', pos);
+					pos = end == std::string_view::npos ? data.size() : end + 1;
+					continue;
+				}
+
+				if (c == ';' || (c == '%' && pos && data[pos - 1] == '\n')) {
+					std::size_t end = data.find('\n', pos);
+					pos = end == std::string_view::npos ? data.size() : end + 1;
+					continue;
+				}
+
+				if (c == '(') {
+					for (int depth = 0; pos < data.size(); pos++) {
+						if (data[pos] == '{') {
+							std::size_t end = data.find('}', pos);
+							pos = end == std::string_view::npos ? data.size() - 1 : end;
+						}
+						else if (data[pos] == '(') depth++;
+						else if (data[pos] == ')' && --depth == 0) break;
+					}
+					pos++;
+					continue;
+				}
+
+				std::size_t end = pos;
+				while (end < data.size() && !space(data[end]) && data[end] != '{' && data[end] != '(' && data[end] != ')' && data[end] != ';') end++;
+				if (end == pos) end++;
+
+				std::string_view token = data.substr(pos, end - pos);
+				pos = end;
+
+				if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+					if (resultText.empty() && token != "*") {
+						resultText = token;
+						result = packResult(token);
+					}
+					break;
+				}
+
+				if (token[0] == '$' || token[0] == '!' || token[0] == '?') continue;
+
+				//Move numbers, which can be stuck to the move (1.e4, 12...Nf6)
+
+				std::size_t number{ 0 };
+				while (number < token.size() && token[number] >= '0' && token[number] <= '9') number++;
+				if (number < token.size() && token[number] == '.') {
+					while (number < token.size() && token[number] == '.') number++;
+					token.remove_prefix(number);
+				}
+				if (token.empty() || broken) continue;
+
+				san.assign(token);
+				std::uint16_t move = Move::fromSAN(san);
+
+				if (!move) {
+					broken = true;
+					counts.errors.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				if (ply >= cfg.skip) emit(result, resultText);
+
+				Board::makeMove(move);
+				ply++;
+				moves++;
+
+			}
+
+			/*
+			* The final position, when the game could be followed to the end.
+			*/
+
+			if (keep && ply >= cfg.skip && !broken) emit(result, resultText);
+
+			counts.games.fetch_add(1, std::memory_order_relaxed);
+			if (keep) counts.kept.fetch_add(1, std::memory_order_relaxed);
+			counts.moves.fetch_add(moves, std::memory_order_relaxed);
+
+		}
+
+	};
+
+	/**
+	 * .
+	 * Runs the pgn command.
+	 * \param input
+	 */
+	void convert(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name, token;
+		Config cfg;
+
+		reader >> name >> cfg.file >> cfg.out;
+
+		if (cfg.out.empty()) {
+			std::cout << "info string usage: pgn <file> <out> [threads] [minelo=<rating>] [skip=<plies>] [<Tag>=<value>]..." << std::endl;
+			return;
+		}
+
+		while (reader >> token) {
+
+			std::size_t eq = token.find('=');
+
+			if (eq == std::string::npos) {
+				cfg.threads = std::clamp(std::atoi(token.c_str()), 1, 256);
+				continue;
+			}
+
+			std::string key = token.substr(0, eq);
+			std::string value = token.substr(eq + 1);
+
+			if (key == "minelo") cfg.minElo = std::atoi(value.c_str());
+			else if (key == "skip") cfg.skip = std::max(0, std::atoi(value.c_str()));
+			else {
+				std::replace(value.begin(), value.end(), '_', ' ');
+				cfg.tags.push_back({ key, value });
+			}
+
+		}
+
+		cfg.packed = cfg.out.size() > 5 && cfg.out.substr(cfg.out.size() - 5) == ".pack";
+
+		FileMap::Mapping file;
+
+		if (!FileMap::map(cfg.file, file, FileMap::sequential)) {
+			std::cout << "info string cannot read " << cfg.file << std::endl;
+			return;
+		}
+
+		Output output;
+
+		if (cfg.packed ? !output.pack.open(cfg.out) : (output.text.open(cfg.out, std::ios::binary), !output.text)) {
+			std::cout << "info string cannot write " << cfg.out << std::endl;
+			FileMap::unmap(file);
+			return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::string_view data{ static_cast<const char*>(file.data), file.bytes };
+		Counts counts;
+		std::vector<std::thread> workers;
+
+		for (int t = 0; t < cfg.threads; t++) {
+			workers.emplace_back([&, t] {
+
+				std::size_t pos = gameStart(data, data.size() * t / cfg.threads);
+				std::size_t to = gameStart(data, data.size() * (t + 1) / cfg.threads);
+
+				Worker worker{ cfg, output, counts };
+				Tags tags;
+
+				/*
+				* A game belongs to the thread whose range it starts in.
+				*/
+
+				while (true) {
+					while (pos < to && space(data[pos])) pos++;
+					if (pos >= to) break;
+					std::size_t before = pos;
+					worker.game(data, pos, tags);
+					if (pos == before) pos++;
+				}
+
+				worker.flush();
+
+			});
+		}
+
+		for (std::thread& w : workers) w.join();
+
+		FileMap::unmap(file);
+
+		if (cfg.packed) output.pack.close();
+		else output.text.close();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "info string pgn " << counts.games << " games, " << counts.kept << " kept, " << counts.moves << " moves, "
+			<< counts.positions << " positions to " << cfg.out << ", " << counts.errors << " unreadable moves, "
+			<< counts.invalid << " invalid FEN tags, " << seconds << " s, "
+			<< (std::uint64_t)(counts.moves / std::max(seconds, 1e-6)) << " moves/s" << std::endl;
+
+	}
+
+}
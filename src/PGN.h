@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+namespace PGN {
+
+	extern void convert(const std::string& input);
+
+}
@@ -0,0 +1,212 @@
+#include <bit>
+#include <cstring>
+
+#include "Pack.h"
+#include "Board.h"
+
+/*
+Compact binary position format for bulk datasets. Each position is a fixed 32 byte record:
+
+bytes 0-7	occupancy bitboard (little endian, same square layout as the board: bit 0 = A8, bit 63 = H1)
+bytes 8-23	one 4-bit piece code per occupied square, in the order of the occupancy bits (lowest bit first,
+			low nibble first). 1-6 are white P N B R Q K, the same plus 8 for black.
+byte 24		bit 0 is set if white is to play, bits 1-4 hold the castling rights
+byte 25		en passant square (0-63), or 0xFF if there is none
+byte 26		half moves since a capture or pawn advance
+bytes 27-28	full move number (little endian)
+byte 29		game result if known (see Pack.h)
+bytes 30-31	score from white's point of view if known (little endian)
+
+Writer buffers records and writes them out in blocks. Reader maps the whole file and hands out the records in place.
+*/
+
+namespace Pack {
+
+	/*
+	* Number of records the writer keeps before writing them out (2MB).
+	*/
+	constexpr std::size_t bufferRecords{ 1 << 16 };
+
+	/**
+	 * .
+	 * Packs the current board representation into rec. Returns false if there are more than 32 pieces on the board,
+	 * since they wouldn't fit in the piece codes.
+	 * \param rec
+	 * \param result
+	 * \param score
+	 * \return
+	 */
+	bool pack(Record& rec, std::uint8_t result, std::int16_t score) {
+
+		const std::uint64_t pieces[12] = { Board::WP, Board::WN, Board::WB, Board::WR, Board::WQ, Board::WK,
+			Board::BP, Board::BN, Board::BB, Board::BR, Board::BQ, Board::BK };
+
+		std::uint64_t occ{ 0 };
+		for (int p = 0; p < 12; p++) occ |= pieces[p];
+
+		if (std::popcount(occ) > 32) return false;
+
+		std::memset(rec.bytes, 0, sizeof(rec.bytes));
+
+		for (int i = 0; i < 8; i++) rec.bytes[i] = (std::uint8_t)(occ >> (i * 8));
+
+		/*
+		* Walks the occupied squares from the lowest bit up and stores the piece code of each one.
+		*/
+
+		int k{ 0 };
+		for (std::uint64_t b = occ; b; b &= b - 1, k++) {
+
+			std::uint64_t sq = b & (~b + 1);
+			std::uint8_t code{ 0 };
+
+			for (int p = 0; p < 12; p++) {
+				if (pieces[p] & sq) {
+					code = (std::uint8_t)(p < 6 ? p + 1 : p + 3);
+					break;
+				}
+			}
+
+			rec.bytes[8 + k / 2] |= (k & 1) ? code << 4 : code;
+
+		}
+
+		rec.bytes[24] = (Board::whiteTurn ? 1 : 0) | ((Board::castlingRights & 0b00001111) << 1);
+		rec.bytes[25] = Board::enPassant ? (std::uint8_t)std::countr_zero(Board::enPassant) : 0xFF;
+		rec.bytes[26] = Board::fiftyDraw;
+		rec.bytes[27] = (std::uint8_t)(Board::moveNum & 0xFF);
+		rec.bytes[28] = (std::uint8_t)(Board::moveNum >> 8);
+		rec.bytes[29] = result;
+		rec.bytes[30] = (std::uint8_t)((std::uint16_t)score & 0xFF);
+		rec.bytes[31] = (std::uint8_t)((std::uint16_t)score >> 8);
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Sets the board representation to the position stored in rec.
+	 * \param rec
+	 */
+	void unpack(const Record& rec) {
+
+		std::uint64_t* pieces[12] = { &Board::WP, &Board::WN, &Board::WB, &Board::WR, &Board::WQ, &Board::WK,
+			&Board::BP, &Board::BN, &Board::BB, &Board::BR, &Board::BQ, &Board::BK };
+
+		Board::clear();
+
+		int k{ 0 };
+		for (std::uint64_t b = occupancy(rec); b; b &= b - 1, k++) {
+
+			std::uint8_t code = (rec.bytes[8 + k / 2] >> ((k & 1) * 4)) & 0xF;
+			int p = code < 8 ? code - 1 : code - 3;
+
+			if (p >= 0 && p < 12) {
+				*pieces[p] |= b & (~b + 1);
+				Board::pieceOn[std::countr_zero(b)] = p;
+			}
+
+		}
+
+		Board::whiteTurn = rec.bytes[24] & 1;
+		Board::castlingRights = (rec.bytes[24] >> 1) & 0b00001111;
+		Board::enPassant = rec.bytes[25] < 64 ? 1ULL << rec.bytes[25] : 0;
+		Board::fiftyDraw = rec.bytes[26];
+		Board::moveNum = rec.bytes[27] | (rec.bytes[28] << 8);
+		Board::hash = Board::computeHash();
+		Board::version++;
+
+	}
+
+	/**
+	 * .
+	 * Reads the occupancy bitboard straight from the record.
+	 * \param rec
+	 * \return
+	 */
+	std::uint64_t occupancy(const Record& rec) {
+		std::uint64_t occ{ 0 };
+		for (int i = 0; i < 8; i++) occ |= (std::uint64_t)rec.bytes[i] << (i * 8);
+		return occ;
+	}
+
+	bool whiteToMove(const Record& rec) { return rec.bytes[24] & 1; }
+
+	std::uint8_t result(const Record& rec) { return rec.bytes[29]; }
+
+	std::int16_t score(const Record& rec) { return (std::int16_t)(rec.bytes[30] | (rec.bytes[31] << 8)); }
+
+	/**
+	 * .
+	 * Opens (or creates) a packed file for writing. Existing records are kept if append is set.
+	 * \param path
+	 * \param append
+	 * \return
+	 */
+	bool Writer::open(const std::string& path, bool append) {
+		close();
+		out.open(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+		buffer.reserve(bufferRecords);
+		written = 0;
+		return out.is_open();
+	}
+
+	/**
+	 * .
+	 * Adds a record to the buffer, writing the buffer out once it's full.
+	 * \param rec
+	 */
+	void Writer::write(const Record& rec) {
+		buffer.push_back(rec);
+		if (buffer.size() >= bufferRecords) flush();
+	}
+
+	void Writer::flush() {
+		if (!buffer.empty() && out.is_open()) {
+			out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Record));
+			written += buffer.size();
+		}
+		buffer.clear();
+		out.flush();
+	}
+
+	void Writer::close() {
+		if (!out.is_open()) return;
+		flush();
+		out.close();
+	}
+
+	Writer::~Writer() { close(); }
+
+	/**
+	 * .
+	 * Maps a packed file into memory. Trailing bytes that don't make up a whole record are ignored.
+	 * \param path
+	 * \return
+	 */
+	bool Reader::open(const std::string& path) {
+
+		close();
+
+		if (!FileMap::map(path, file, FileMap::sequential)) return false;
+
+		records = static_cast<const Record*>(file.data);
+		count = file.bytes / sizeof(Record);
+
+		return true;
+
+	}
+
+	void Reader::close() {
+
+		FileMap::unmap(file);
+
+		records = nullptr;
+		count = 0;
+
+	}
+
+	Reader::~Reader() { close(); }
+
+}
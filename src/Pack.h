@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FileMap.h"
+
+namespace Pack {
+
+	/*
+	* A position packed into a fixed 32 byte record. See Pack.cpp for the layout.
+	*/
+	struct Record {
+		std::uint8_t bytes[32];
+	};
+
+	static_assert(sizeof(Record) == 32, "Pack::Record must stay 32 bytes");
+
+	constexpr std::uint8_t noResult{ 0 };
+	constexpr std::uint8_t blackWin{ 1 };
+	constexpr std::uint8_t draw{ 2 };
+	constexpr std::uint8_t whiteWin{ 3 };
+
+	extern bool pack(Record& rec, std::uint8_t result = noResult, std::int16_t score = 0);
+	extern void unpack(const Record& rec);
+
+	extern std::uint64_t occupancy(const Record& rec);
+	extern bool whiteToMove(const Record& rec);
+	extern std::uint8_t result(const Record& rec);
+	extern std::int16_t score(const Record& rec);
+
+	/*
+	* Buffers records in memory and writes them out in large blocks.
+	*/
+	struct Writer {
+
+		bool open(const std::string& path, bool append = false);
+		void write(const Record& rec);
+		void flush();
+		void close();
+
+		~Writer();
+
+		std::ofstream out;
+		std::vector<Record> buffer;
+		std::uint64_t written{ 0 };
+
+	};
+
+	/*
+	* Maps a packed file into memory. Records are read in place without any parsing.
+	*/
+	struct Reader {
+
+		bool open(const std::string& path);
+		void close();
+
+		std::size_t size() const { return count; }
+		const Record& operator[](std::size_t i) const { return records[i]; }
+		const Record* begin() const { return records; }
+		const Record* end() const { return records + count; }
+
+		~Reader();
+
+		const Record* records{ nullptr };
+		std::size_t count{ 0 };
+		FileMap::Mapping file;
+
+	};
+
+}
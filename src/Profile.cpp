@@ -0,0 +1,303 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Profile.h"
+#include "Bench.h"
+#include "Board.h"
+#include "Magic.h"
+#include "Search.h"
+
+/*
+The profile command: runs parts of the engine under the CPU's hardware performance counters (Linux perf_event_open)
+and reports each part as a phase: cycles, instructions, IPC, L1 data cache and last level cache misses and branch
+mispredictions. Phases run in the order given:
+
+profile [init] [perft <depth>] [search <depth>] [bench [hash] [threads] [depth]]
+
+init rebuilds the Magic tables, perft counts moves from the current position (movegen and make/unmake), search
+searches the current position, and bench runs the bench command. With no phases it runs init, perft 4 and search 6.
+
+Counters follow threads created during a phase, so multithreaded searches are counted in full. On other systems, or
+when the kernel doesn't allow access to the counters (see /proc/sys/kernel/perf_event_paranoid), only time is shown.
+*/
+
+namespace Profile {
+
+	/*
+	* A counter to open and how to show it.
+	*/
+	struct Event {
+		const char* name;
+		std::uint32_t type;
+		std::uint64_t config;
+	};
+
+	enum : int { cycles, instructions, l1dMisses, llcMisses, branchMisses, eventCount };
+
+#ifdef __linux__
+
+	const Event events[eventCount] = {
+		{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ "L1d misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ "LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+#endif
+
+	/*
+	* The counter values of one phase. A counter that couldn't be opened is marked invalid.
+	*/
+	struct Sample {
+		std::string phase;
+		double ms{ 0 };
+		std::uint64_t value[eventCount]{};
+		bool valid[eventCount]{};
+	};
+
+	/*
+	* The open counters. Each one is opened on its own rather than as a group, so an event the CPU doesn't have
+	* doesn't take the rest down with it. If the kernel has to share the hardware between them, the values are
+	* scaled up by the fraction of time each one was actually counting.
+	*/
+	struct Counters {
+
+		int fd[eventCount];
+		std::string error;
+
+		Counters() {
+			for (int i = 0; i < eventCount; i++) fd[i] = -1;
+		}
+
+		bool open() {
+
+#ifdef __linux__
+			bool any{ false };
+
+			for (int i = 0; i < eventCount; i++) {
+
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = events[i].type;
+				attr.config = events[i].config;
+				attr.disabled = 1;
+				attr.inherit = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+				if (fd[i] >= 0) any = true;
+				else if (error.empty()) error = std::strerror(errno);
+
+			}
+
+			return any;
+#else
+			error = "hardware counters are only supported on Linux";
+			return false;
+#endif
+
+		}
+
+		void start() {
+#ifdef __linux__
+			for (int i = 0; i < eventCount; i++) {
+				if (fd[i] < 0) continue;
+				ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		void stop(Sample& sample) {
+#ifdef __linux__
+			for (int i = 0; i < eventCount; i++) {
+
+				if (fd[i] < 0) continue;
+
+				ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+				std::uint64_t data[3]{};
+				if (read(fd[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+
+				sample.value[i] = data[2] < data[1] ? (std::uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+				sample.valid[i] = true;
+
+			}
+#else
+			(void)sample;
+#endif
+		}
+
+		~Counters() {
+#ifdef __linux__
+			for (int i = 0; i < eventCount; i++) {
+				if (fd[i] >= 0) close(fd[i]);
+			}
+#endif
+		}
+
+	};
+
+	/**
+	 * .
+	 * Runs one phase under the counters.
+	 * \param counters
+	 * \param phase
+	 * \param work
+	 * \return
+	 */
+	Sample measure(Counters& counters, const std::string& phase, const std::function<void()>& work) {
+
+		Sample sample;
+		sample.phase = phase;
+
+		auto start = std::chrono::steady_clock::now();
+		counters.start();
+
+		work();
+
+		counters.stop(sample);
+		sample.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		return sample;
+
+	}
+
+	/**
+	 * .
+	 * Prints one row per phase. Misses are also shown per thousand instructions (MPKI), which is what to compare
+	 * between phases of different lengths.
+	 * \param samples
+	 */
+	void print(const std::vector<Sample>& samples) {
+
+		std::cout << std::left << std::setw(20) << "phase" << std::right << std::setw(10) << "ms"
+			<< std::setw(16) << "cycles" << std::setw(16) << "instructions" << std::setw(7) << "IPC"
+			<< std::setw(14) << "L1d miss" << std::setw(8) << "MPKI" << std::setw(14) << "LLC miss" << std::setw(8) << "MPKI"
+			<< std::setw(14) << "branch miss" << std::setw(8) << "MPKI" << '\n';
+
+		std::cout << std::fixed;
+
+		for (const Sample& s : samples) {
+
+			auto count = [&](int e) {
+				std::ostringstream out;
+				if (s.valid[e]) out << s.value[e];
+				else out << '-';
+				return out.str();
+			};
+
+			auto mpki = [&](int e) {
+				std::ostringstream out;
+				if (s.valid[e] && s.valid[instructions] && s.value[instructions]) out << std::fixed << std::setprecision(2) << 1000.0 * s.value[e] / s.value[instructions];
+				else out << '-';
+				return out.str();
+			};
+
+			std::ostringstream ipc;
+			if (s.valid[cycles] && s.valid[instructions] && s.value[cycles]) ipc << std::fixed << std::setprecision(2) << (double)s.value[instructions] / s.value[cycles];
+			else ipc << '-';
+
+			std::cout << std::left << std::setw(20) << s.phase << std::right << std::setw(10) << std::setprecision(1) << s.ms
+				<< std::setw(16) << count(cycles) << std::setw(16) << count(instructions) << std::setw(7) << ipc.str()
+				<< std::setw(14) << count(l1dMisses) << std::setw(8) << mpki(l1dMisses)
+				<< std::setw(14) << count(llcMisses) << std::setw(8) << mpki(llcMisses)
+				<< std::setw(14) << count(branchMisses) << std::setw(8) << mpki(branchMisses) << '\n';
+
+		}
+
+		std::cout << std::defaultfloat << std::flush;
+
+	}
+
+	/**
+	 * .
+	 * Runs the profile command.
+	 * \param input
+	 */
+	void profile(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name, token;
+		std::vector<std::string> tokens;
+
+		reader >> name;
+		while (reader >> token) tokens.push_back(token);
+
+		if (tokens.empty()) tokens = { "init", "perft", "4", "search", "6" };
+
+		Counters counters;
+		if (!counters.open()) std::cout << "info string hardware counters unavailable: " << counters.error << ", showing time only" << std::endl;
+
+		std::vector<Sample> samples;
+		std::uint64_t result{ 0 };
+
+		auto number = [&](std::size_t& i, int fallback) {
+			if (i + 1 < tokens.size() && std::atoi(tokens[i + 1].c_str()) > 0) return std::atoi(tokens[++i].c_str());
+			return fallback;
+		};
+
+		for (std::size_t i = 0; i < tokens.size(); i++) {
+
+			if (tokens[i] == "init") {
+				samples.push_back(measure(counters, "init", [] { Magic::initialize(); }));
+			}
+
+			else if (tokens[i] == "perft") {
+				int depth = number(i, 4);
+				samples.push_back(measure(counters, "perft " + std::to_string(depth), [&] { result = Search::perft(depth); }));
+				std::cout << "info string perft " << depth << " nodes " << result << std::endl;
+			}
+
+			else if (tokens[i] == "search") {
+				Search::Limits limits;
+				limits.depth = number(i, 6);
+				Search::clear();
+				samples.push_back(measure(counters, "search " + std::to_string(limits.depth), [&] { result = Search::search(limits, false).nodes; }));
+				std::cout << "info string search depth " << limits.depth << " nodes " << result << std::endl;
+			}
+
+			/*
+			* Everything up to the next phase name is passed on to the bench command.
+			*/
+			else if (tokens[i] == "bench") {
+				std::string args{ "bench" };
+				while (i + 1 < tokens.size() && std::atoi(tokens[i + 1].c_str()) > 0) args += ' ' + tokens[++i];
+				Board::State saved = Board::save();
+				samples.push_back(measure(counters, args, [&] { Bench::bench(args); }));
+				Board::restore(saved);
+			}
+
+			else {
+				std::cout << "usage: profile [init] [perft <depth>] [search <depth>] [bench [hash] [threads] [depth]]" << std::endl;
+				return;
+			}
+
+		}
+
+		print(samples);
+
+	}
+
+}
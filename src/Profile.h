@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+namespace Profile {
+
+	extern void profile(const std::string& input);
+
+}
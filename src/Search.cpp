@@ -0,0 +1,680 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Search.h"
+#include "Bitbase.h"
+#include "Board.h"
+#include "Eval.h"
+#include "Magic.h"
+#include "Move.h"
+#include "Numa.h"
+#include "Stats.h"
+#include "Trace.h"
+
+/*
+Alpha-beta search over the board representation. Iterative deepening with a quiescence search on captures and
+promotions, a transposition table, null-move pruning, repetition draws and bitbase draws. All search state is thread_local, so several searches can run at once on
+different threads as long as each one has set up its own board.
+
+With the Threads option above 1 the search is a lazy SMP: helper threads search the same position on copies of
+the board, sharing only the transposition table, and the main thread's result is played.
+
+negamax and quiescence are thin wrappers that record the node in the trace (see Trace.h) around searchNode and
+searchQuiescence; without GORILLA_TRACE they are plain calls.
+*/
+
+namespace Search {
+
+	int negamax(int depth, int ply, int alpha, int beta);
+	int quiescence(int ply, int alpha, int beta);
+	int searchNode(int depth, int ply, int alpha, int beta);
+	int searchQuiescence(int ply, int alpha, int beta);
+
+	/*
+	* Per-thread search state. The principal variation is kept in a triangular table.
+	*/
+
+	thread_local Options options;
+
+	thread_local Limits limits;
+	thread_local std::uint64_t nodes;
+	thread_local bool stopped;
+	thread_local std::chrono::steady_clock::time_point start;
+
+	thread_local std::uint16_t pvTable[maxPly][maxPly];
+	thread_local int pvLength[maxPly];
+
+	thread_local std::uint16_t rootBest;
+	thread_local bool rootWhite;
+
+	//Hash of the position at each ply of the line being searched, for finding repetitions
+
+	thread_local std::uint64_t path[maxPly];
+
+	//Ply of the first position after the last null move of the line being searched, -1 without one
+
+	thread_local int nullPly{ -1 };
+
+	//Transposition table used by this thread's searches. Matches point each engine at its own table.
+
+	thread_local TT::Table* table{ &TT::table };
+
+	//Set by the main thread to stop its helpers
+
+	thread_local const std::atomic<bool>* abortFlag{ nullptr };
+
+	//Depth taken off the search after a null move, on top of the move itself
+
+	constexpr int nullReduction{ 2 };
+
+	/**
+	 * .
+	 * Sets an option by its UCI name. Returns false if there's no option with that name.
+	 * \param opts
+	 * \param name
+	 * \param value
+	 * \return
+	 */
+	bool setOption(Options& opts, const std::string& name, const std::string& value) {
+
+		if (name == "Contempt") opts.contempt = std::atoi(value.c_str());
+		else if (name == "Quiescence") opts.quiescence = value == "true";
+		else if (name == "NullMove") opts.nullMove = value == "true";
+		else if (name == "Hash") opts.hash = std::clamp(std::atoi(value.c_str()), 1, 65536);
+		else if (name == "Threads") opts.threads = std::clamp(std::atoi(value.c_str()), 1, 256);
+		else if (name == "NumaAffinity") opts.numa = value == "true";
+		else return false;
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Prints the options for the uci command.
+	 */
+	void printOptions() {
+		std::cout << "option name Contempt type spin default 0 min -100 max 100\n";
+		std::cout << "option name Quiescence type check default true\n";
+		std::cout << "option name NullMove type check default true\n";
+		std::cout << "option name Hash type spin default 16 min 1 max 65536\n";
+		std::cout << "option name Threads type spin default 1 min 1 max 256\n";
+		std::cout << "option name NumaAffinity type check default true\n";
+	}
+
+	/**
+	 * .
+	 * Forgets everything learned from previous searches, so the next search behaves as in a fresh engine.
+	 */
+	void clear() {
+		if (table->megabytes() != (std::size_t)options.hash) table->resize(options.hash);
+		table->clear();
+		Eval::clearCache();
+	}
+
+	/**
+	 * .
+	 * Score of a draw for the side to move. A positive contempt makes the engine avoid draws.
+	 * \return
+	 */
+	int drawScore() {
+		return Board::whiteTurn == rootWhite ? -options.contempt : options.contempt;
+	}
+
+	/**
+	 * .
+	 * Checks if the position at this ply appeared before, in the line being searched or in the game before the root
+	 * (Board::history). Only every other position can match, and none from before the last capture or pawn move,
+	 * or before the last null move: a position can't repeat across a pass, which isn't a move of the game.
+	 * A single repetition counts as a draw: whatever was possible the first time still is.
+	 * \param ply
+	 * \return
+	 */
+	bool repeated(int ply) {
+
+		int played = (int)Board::history.size();
+		int limit = nullPly < 0 ? Board::fiftyDraw : std::min<int>(Board::fiftyDraw, ply - nullPly);
+
+		for (int back = 4; back <= limit; back += 2) {
+
+			int at = ply - back;
+			if (at < -played) break;
+
+			std::uint64_t key = at >= 0 ? path[at] : Board::history[played + at];
+			if (key == Board::hash) return true;
+
+		}
+
+		return false;
+
+	}
+
+	/**
+	 * .
+	 * Milliseconds since the search started.
+	 * \return
+	 */
+	std::int64_t elapsed() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/**
+	 * .
+	 * Stops the search once the node or time limit runs out. Time is only checked every 1024 nodes.
+	 */
+	void checkLimits() {
+		if (limits.nodes && nodes >= limits.nodes) stopped = true;
+		if (limits.movetime && (nodes & 1023) == 0 && elapsed() >= limits.movetime) stopped = true;
+		if (abortFlag && abortFlag->load(std::memory_order_relaxed)) stopped = true;
+	}
+
+	/*
+	* Mate scores count plies from the root, but in the table they're stored counting from the node so they stay
+	* right when the position is reached at another ply.
+	*/
+
+	int toTT(int score, int ply) {
+		if (score > mateScore - maxPly) return score + ply;
+		if (score < -mateScore + maxPly) return score - ply;
+		return score;
+	}
+
+	int fromTT(int score, int ply) {
+		if (score > mateScore - maxPly) return score - ply;
+		if (score < -mateScore + maxPly) return score + ply;
+		return score;
+	}
+
+	/**
+	 * .
+	 * Sorts moves so the most promising ones are searched first: the best move from the previous iteration, then
+	 * promotions, then captures by most valuable victim / least valuable attacker, then quiet moves.
+	 * \param moves
+	 * \param best
+	 */
+	void orderMoves(std::vector<std::uint16_t>& moves, std::uint16_t best) {
+
+		std::vector<std::pair<int, std::uint16_t>> scored;
+		scored.reserve(moves.size());
+
+		for (std::uint16_t m : moves) {
+
+			int score{ 0 };
+			int special = (m & Move::specMask) >> 14;
+
+			if (m == best) score = 1000000;
+			else {
+				int victim = Board::pieceAt(m & Move::toMask);
+				if (victim != -1) score = 10000 + Eval::pieceValue[victim % 6] * 10 - Eval::pieceValue[Board::pieceAt((m & Move::fromMask) >> 6) % 6] / 10;
+				else if (special == 2) score = 10000 + Eval::pieceValue[0] * 10 - Eval::pieceValue[0] / 10;
+				if (special == 1) score += ((m & Move::promoMask) >> 12) == 0 ? 50000 : -5000;
+			}
+
+			scored.push_back({ score, m });
+
+		}
+
+		std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		for (std::size_t i = 0; i < moves.size(); i++) moves[i] = scored[i].second;
+
+	}
+
+	/**
+	 * .
+	 * Searches captures and promotions until the position is quiet, so the static evaluation isn't taken in the
+	 * middle of an exchange.
+	 * \param ply
+	 * \param alpha
+	 * \param beta
+	 * \return
+	 */
+	int searchQuiescence(int ply, int alpha, int beta) {
+
+		nodes++;
+		Stats::add(Stats::qnodes);
+		checkLimits();
+		if (stopped) return 0;
+
+		int standPat = Eval::evaluate(alpha, beta);
+
+		if (ply >= maxPly - 1) return standPat;
+		if (standPat >= beta) {
+			Trace::note(Trace::standPat);
+			return standPat;
+		}
+		if (standPat > alpha) alpha = standPat;
+
+		std::vector<std::uint16_t> moves = Move::generate();
+
+		std::uint64_t enemy = Board::whiteTurn ? (Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK)
+			: (Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK);
+
+		std::vector<std::uint16_t> noisy;
+		for (std::uint16_t m : moves) {
+			int special = (m & Move::specMask) >> 14;
+			if ((enemy >> (m & Move::toMask) & 1) || special == 2 || (special == 1 && (m & Move::promoMask) == 0)) noisy.push_back(m);
+		}
+
+		orderMoves(noisy, 0);
+
+		Board::State state = Board::save();
+
+		int searched{ 0 };
+
+		for (std::uint16_t m : noisy) {
+
+			if (!Move::makeLegal(m)) {
+				Board::restore(state);
+				continue;
+			}
+
+			searched++;
+			Trace::move(m, searched);
+
+			int score = -quiescence(ply + 1, -beta, -alpha);
+
+			Board::restore(state);
+
+			if (stopped) return 0;
+
+			if (score >= beta) {
+				Trace::note(Trace::betaCutoff, m, searched);
+				return score;
+			}
+			if (score > alpha) alpha = score;
+
+		}
+
+		return alpha;
+
+	}
+
+	/**
+	 * .
+	 * Fail-hard alpha-beta search. Scores are from the point of view of the side to move. Mates are scored
+	 * by distance from the root. Results are stored in the transposition table, and a stored result that went deep
+	 * enough ends the search of a node early (except at the root, which always needs a move).
+	 * \param depth
+	 * \param ply
+	 * \param alpha
+	 * \param beta
+	 * \return
+	 */
+	int searchNode(int depth, int ply, int alpha, int beta) {
+
+		pvLength[ply] = ply;
+
+		if (depth <= 0) return options.quiescence ? quiescence(ply, alpha, beta) : Eval::evaluate(alpha, beta);
+
+		nodes++;
+		Stats::add(Stats::nodes);
+		checkLimits();
+		if (stopped) return 0;
+
+		path[ply] = Board::hash;
+
+		if (ply && (Board::fiftyDraw >= 100 || repeated(ply) || Bitbase::probe() == Bitbase::draw)) {
+			Trace::note(Trace::draw);
+			return drawScore();
+		}
+		if (ply >= maxPly - 1) return Eval::evaluate(alpha, beta);
+
+		std::uint16_t ttMove{ 0 };
+		TT::Hit hit;
+
+		Stats::add(Stats::ttProbes);
+
+		if (table->probe(Board::hash, hit)) {
+
+			Stats::add(Stats::ttHits);
+			ttMove = hit.move;
+
+			if (Trace::active()) Trace::hit(ply, hit.depth, hit.move);
+
+			if (ply && hit.depth >= depth) {
+				int score = fromTT(hit.score, ply);
+				bool cut = hit.bound == TT::exact || (hit.bound == TT::lower && score >= beta) || (hit.bound == TT::upper && score <= alpha);
+				if (cut) {
+					Stats::add(Stats::ttCutoffs);
+					Trace::note(Trace::ttCutoff, hit.move);
+					return std::clamp(score, alpha, beta);
+				}
+			}
+
+		}
+
+		bool checked = Move::inCheck(Board::whiteTurn);
+
+		/*
+		* Null-move pruning: if passing the turn still fails high in a reduced search, a real move almost certainly
+		* would too. Skipped in check (passing would be illegal) and without pieces other than pawns, where being
+		* forced to move can be a disadvantage (zugzwang).
+		*/
+
+		std::uint64_t pieces = Board::whiteTurn ? (Board::WN | Board::WB | Board::WR | Board::WQ) : (Board::BN | Board::BB | Board::BR | Board::BQ);
+
+		if (options.nullMove && ply && depth >= 3 && !checked && pieces && beta < mateScore - maxPly) {
+
+			Stats::add(Stats::nullTries);
+
+			Board::State state = Board::save();
+			Board::makeNullMove();
+			Trace::move(0, 0);
+
+			int outerNull = nullPly;
+			nullPly = ply + 1;
+
+			int score = -negamax(depth - 1 - nullReduction, ply + 1, -beta, -beta + 1);
+
+			nullPly = outerNull;
+			Board::restore(state);
+
+			if (stopped) return 0;
+
+			if (score >= beta) {
+				Stats::add(Stats::nullCutoffs);
+				Trace::note(Trace::nullCutoff);
+				return beta;
+			}
+
+		}
+
+		std::vector<std::uint16_t> moves = Move::generate();
+
+		orderMoves(moves, ply == 0 && rootBest ? rootBest : ttMove);
+
+		Board::State state = Board::save();
+
+		int legal{ 0 };
+		std::uint16_t bestMove{ 0 };
+
+		for (std::uint16_t m : moves) {
+
+			if (ply == 0 && std::find(limits.exclude.begin(), limits.exclude.end(), m) != limits.exclude.end()) continue;
+
+			if (!Move::makeLegal(m)) {
+				Board::restore(state);
+				continue;
+			}
+
+			legal++;
+			Trace::move(m, legal);
+
+			int score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+
+			Board::restore(state);
+
+			if (stopped) return 0;
+
+			if (score >= beta) {
+				Stats::add(Stats::betaCutoffs);
+				if (legal == 1) Stats::add(Stats::firstMoveCutoffs);
+				Trace::note(Trace::betaCutoff, m, legal);
+				if (ply || limits.exclude.empty()) table->store(Board::hash, m, toTT(beta, ply), depth, TT::lower);
+				return beta;
+			}
+
+			if (score > alpha) {
+
+				alpha = score;
+				bestMove = m;
+
+				pvTable[ply][ply] = m;
+				for (int i = ply + 1; i < pvLength[ply + 1]; i++) pvTable[ply][i] = pvTable[ply + 1][i];
+				pvLength[ply] = pvLength[ply + 1];
+
+			}
+
+		}
+
+		if (legal == 0) {
+			if (!checked) Trace::note(Trace::draw);
+			return checked ? -mateScore + ply : drawScore();
+		}
+
+		/*
+		* A root searched without some of its moves doesn't have its real score, so it isn't stored.
+		*/
+
+		if (ply || limits.exclude.empty()) table->store(Board::hash, bestMove, toTT(alpha, ply), depth, bestMove ? TT::exact : TT::upper);
+
+		return alpha;
+
+	}
+
+	/**
+	 * .
+	 * searchNode, recorded in the trace when tracing is on. Nodes below the horizon are recorded by quiescence.
+	 * \param depth
+	 * \param ply
+	 * \param alpha
+	 * \param beta
+	 * \return
+	 */
+	int negamax(int depth, int ply, int alpha, int beta) {
+
+		if (!Trace::active() || depth <= 0) return searchNode(depth, ply, alpha, beta);
+
+		Trace::enter(Trace::enterNode, ply, depth, alpha, beta, Board::hash);
+		int score = searchNode(depth, ply, alpha, beta);
+		if (stopped) Trace::note(Trace::stopped);
+		Trace::exit(ply, depth, score, alpha);
+
+		return score;
+
+	}
+
+	/**
+	 * .
+	 * searchQuiescence, recorded in the trace when tracing is on.
+	 * \param ply
+	 * \param alpha
+	 * \param beta
+	 * \return
+	 */
+	int quiescence(int ply, int alpha, int beta) {
+
+		if (!Trace::active()) return searchQuiescence(ply, alpha, beta);
+
+		Trace::enter(Trace::enterQuiescence, ply, 0, alpha, beta, Board::hash);
+		int score = searchQuiescence(ply, alpha, beta);
+		if (stopped) Trace::note(Trace::stopped);
+		Trace::exit(ply, 0, score, alpha);
+
+		return score;
+
+	}
+
+	/**
+	 * .
+	 * Prints a UCI info line for a finished iteration.
+	 * \param result
+	 */
+	void printInfo(const Result& result) {
+
+		std::cout << "info depth " << result.depth << " score ";
+
+		if (result.score > mateScore - maxPly) std::cout << "mate " << (mateScore - result.score + 1) / 2;
+		else if (result.score < -mateScore + maxPly) std::cout << "mate " << -(mateScore + result.score) / 2;
+		else std::cout << "cp " << result.score;
+
+		std::cout << " nodes " << result.nodes << " nps " << result.nodes * 1000 / (result.time + 1) << " time " << result.time << " pv";
+
+		for (std::uint16_t m : result.pv) std::cout << ' ' << Move::toUCI(m);
+
+		std::cout << std::endl;
+
+	}
+
+	/**
+	 * .
+	 * Iterative deepening on the current position until a limit is reached. Only completed iterations are used for
+	 * the result, except the first one, so there's always a move to play if there's a legal one.
+	 * \param lim
+	 * \param firstDepth helper threads start at different depths so they don't all search the same tree
+	 * \param print prints UCI info lines after each iteration
+	 * \return
+	 */
+	Result iterate(const Limits& lim, int firstDepth, bool print) {
+
+		limits = lim;
+		nodes = 0;
+		stopped = false;
+		start = std::chrono::steady_clock::now();
+		rootBest = 0;
+		rootWhite = Board::whiteTurn;
+
+		if (table->megabytes() != (std::size_t)options.hash) table->resize(options.hash);
+
+		Result result;
+
+		for (int depth = firstDepth; depth <= limits.depth && depth < maxPly; depth++) {
+
+			int score = negamax(depth, 0, -infinity, infinity);
+
+			if (stopped && depth > firstDepth) break;
+
+			if (pvLength[0] > 0) {
+				result.bestMove = pvTable[0][0];
+				result.pv.assign(pvTable[0], pvTable[0] + pvLength[0]);
+			}
+
+			result.score = score;
+			result.depth = depth;
+			result.nodes = nodes;
+			result.time = elapsed();
+			rootBest = result.bestMove;
+
+			if (print) printInfo(result);
+
+			if (stopped) break;
+
+			/*
+			* There's no point searching deeper once a mate has been found.
+			*/
+
+			if (score > mateScore - maxPly || score < -mateScore + maxPly) break;
+
+		}
+
+		result.nodes = nodes;
+		result.time = elapsed();
+
+		/*
+		* If every move scored below alpha there's no pv, so play any legal move.
+		*/
+
+		if (!result.bestMove) {
+			for (std::uint16_t m : Move::legalMoves()) {
+				if (std::find(limits.exclude.begin(), limits.exclude.end(), m) != limits.exclude.end()) continue;
+				result.bestMove = m;
+				break;
+			}
+		}
+
+		return result;
+
+	}
+
+	/**
+	 * .
+	 * Searches the current position until a limit is reached, with options.threads threads. Helpers only search
+	 * to fill the transposition table; they stop when the main thread is done and their nodes are added to its count.
+	 * \param lim
+	 * \param print prints UCI info lines after each iteration
+	 * \return
+	 */
+	Result search(const Limits& lim, bool print) {
+
+		if (options.threads <= 1) return iterate(lim, 1, print);
+
+		if (table->megabytes() != (std::size_t)options.hash) table->resize(options.hash);
+
+		Board::State root = Board::save();
+		std::vector<std::uint64_t> history = Board::history;
+		Options shared = options;
+		TT::Table* sharedTable = table;
+
+		/*
+		* With NumaAffinity every thread, the calling one as thread 0 included, is bound to a core spread over the
+		* NUMA nodes and reads the Magic tables copied to its own node. The calling thread gets its affinity back
+		* afterwards. Nothing happens on a single node machine.
+		*/
+
+		if (shared.numa) {
+			Magic::replicate(Numa::nodes());
+			Magic::useNode(Numa::bind(0));
+		}
+
+		std::atomic<bool> helpersStop{ false };
+		std::atomic<std::uint64_t> helperNodes{ 0 };
+		std::vector<std::thread> helpers;
+
+		for (int i = 1; i < shared.threads; i++) {
+			helpers.emplace_back([&, i] {
+
+				Board::restore(root);
+				Board::history = history;
+				options = shared;
+				table = sharedTable;
+				abortFlag = &helpersStop;
+
+				if (shared.numa) Magic::useNode(Numa::bind(i));
+
+				Limits helperLimits;
+				helperLimits.depth = lim.depth;
+				helperLimits.exclude = lim.exclude;
+
+				iterate(helperLimits, 1 + i % 2, false);
+				helperNodes += nodes;
+
+			});
+		}
+
+		Result result = iterate(lim, 1, print);
+
+		helpersStop = true;
+		for (std::thread& t : helpers) t.join();
+
+		if (shared.numa) {
+			Numa::unbind();
+			Magic::useNode(-1);
+		}
+
+		result.nodes += helperNodes;
+
+		return result;
+
+	}
+
+	/**
+	 * .
+	 * Counts the leaf nodes of the legal move tree to a given depth. Used to verify move generation.
+	 * \param depth
+	 * \return
+	 */
+	std::uint64_t perft(int depth) {
+
+		if (depth <= 0) return 1;
+
+		std::vector<std::uint16_t> moves = Move::generate();
+		Board::State state = Board::save();
+
+		std::uint64_t count{ 0 };
+
+		for (std::uint16_t m : moves) {
+			if (Move::makeLegal(m)) count += depth == 1 ? 1 : perft(depth - 1);
+			Board::restore(state);
+		}
+
+		return count;
+
+	}
+
+}
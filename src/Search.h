@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TT.h"
+
+namespace Search {
+
+	/*
+	* Limits on a search. A value of 0 means no limit (depth always applies). Root moves in exclude aren't searched,
+	* which is how several best lines (multipv) are found one after another. A mate limit (go mate N) is handled by
+	* the mate solver instead (Mate::solve).
+	*/
+	struct Limits {
+		int depth{ 64 };
+		std::uint64_t nodes{ 0 };
+		int movetime{ 0 };
+		int mate{ 0 };
+		std::vector<std::uint16_t> exclude;
+	};
+
+	/*
+	* Settings that change how the engine plays. Set through setoption, or per engine in a match.
+	*/
+	struct Options {
+		int contempt{ 0 };
+		bool quiescence{ true };
+		bool nullMove{ true };
+		int hash{ 16 };
+		int threads{ 1 };
+		bool numa{ true };
+	};
+
+	struct Result {
+		std::uint16_t bestMove{ 0 };
+		int score{ 0 };
+		int depth{ 0 };
+		std::uint64_t nodes{ 0 };
+		std::int64_t time{ 0 };
+		std::vector<std::uint16_t> pv;
+	};
+
+	constexpr int infinity{ 32500 };
+	constexpr int mateScore{ 32000 };
+	constexpr int maxPly{ 128 };
+
+	extern thread_local Options options;
+
+	extern thread_local TT::Table* table;
+
+	extern bool setOption(Options& opts, const std::string& name, const std::string& value);
+
+	extern void printOptions();
+
+	extern Result search(const Limits& limits, bool print);
+
+	extern void printInfo(const Result& result);
+
+	extern void clear();
+
+	extern std::uint64_t perft(int depth);
+
+}
@@ -0,0 +1,536 @@
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Serve.h"
+#include "Board.h"
+#include "Move.h"
+#include "Search.h"
+#include "TT.h"
+
+/*
+Batch analysis server: serve [threads] [hash] [socket path]
+
+Reads one JSON request per line and analyzes requests concurrently on a pool of worker threads. Each worker has
+its own board (the board and search state are thread_local) and every worker shares one transposition table.
+Results are written back as one JSON line each, as soon as they're done, so they can come back out of order;
+the id of the request is echoed to match them up.
+
+Request:	{"id": "a1", "fen": "<fen>", "depth": 10, "nodes": 100000, "movetime": 500, "multipv": 3}
+Result:		{"id": "a1", "bestmove": "e2e4", "nodes": 12345, "time": 87, "lines": [{"multipv": 1, "depth": 10,
+			"score": {"cp": 31}, "pv": ["e2e4", "e7e5"]}, ...]}
+Error:		{"id": "a1", "error": "..."}
+
+Only fen is required. Without any limit a request is searched to depth 8. Requests come from stdin and results go
+to stdout, unless a socket path is given: then the server listens on a Unix domain socket and every connection
+gets the results of its own requests. Input ends with EOF (stdin) or when the client closes the connection.
+*/
+
+namespace Serve {
+
+	constexpr int defaultDepth{ 8 };
+	constexpr int maxMultiPV{ 16 };
+
+	/*
+	* Where results go: stdout, or a client connection. Shared by all the jobs of a connection, and the connection
+	* is closed once the last of them has written its result.
+	*/
+	struct Sink {
+
+		int fd{ -1 };
+		std::mutex lock;
+
+		void write(const std::string& line) {
+
+			std::lock_guard<std::mutex> guard{ lock };
+
+			if (fd < 0) {
+				std::cout << line << std::endl;
+				return;
+			}
+
+#ifndef _WIN32
+			std::string data = line + '\n';
+			for (std::size_t sent = 0; sent < data.size();) {
+				ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+				if (n <= 0) return;
+				sent += n;
+			}
+#endif
+
+		}
+
+		~Sink() {
+#ifndef _WIN32
+			if (fd >= 0) ::close(fd);
+#endif
+		}
+
+	};
+
+	/*
+	* One request from the input, parsed.
+	*/
+	struct Job {
+		std::string id;
+		bool idIsString{ true };
+		std::string fen;
+		Search::Limits limits;
+		int multipv{ 1 };
+		std::shared_ptr<Sink> sink;
+	};
+
+	/*
+	* The queue of requests waiting for a worker. closed is set when there's no more input.
+	*/
+	std::mutex queueLock;
+	std::condition_variable queueReady;
+	std::deque<Job> queue;
+	bool closed{ false };
+
+	/**
+	 * .
+	 * Escapes a string for a JSON string literal.
+	 * \param s
+	 * \return
+	 */
+	std::string quote(const std::string& s) {
+
+		std::string out{ "\"" };
+
+		for (char c : s) {
+			if (c == '"' || c == '\\') out += '\\';
+			if (c == '\n') out += "\\n";
+			else if ((unsigned char)c >= 0x20) out += c;
+		}
+
+		return out + '"';
+
+	}
+
+	/**
+	 * .
+	 * Whether a value written without quotes is a JSON number, true, false or null, so it can be echoed as written.
+	 * \param s
+	 * \return
+	 */
+	bool literal(const std::string& s) {
+
+		if (s == "true" || s == "false" || s == "null") return true;
+
+		std::size_t i{ 0 };
+		auto digits = [&]() {
+			std::size_t first = i;
+			while (i < s.size() && s[i] >= '0' && s[i] <= '9') i++;
+			return i > first;
+		};
+
+		if (i < s.size() && s[i] == '-') i++;
+		if (i < s.size() && s[i] == '0') i++;
+		else if (!digits()) return false;
+		if (i < s.size() && s[i] == '.') {
+			i++;
+			if (!digits()) return false;
+		}
+		if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+			i++;
+			if (i < s.size() && (s[i] == '+' || s[i] == '-')) i++;
+			if (!digits()) return false;
+		}
+
+		return i == s.size();
+
+	}
+
+	/**
+	 * .
+	 * Parses a flat JSON object (string, number, boolean and null values) into key/value pairs. String values are
+	 * unescaped, the rest are kept as written. Returns false if the line isn't such an object.
+	 * \param line
+	 * \param fields the key, the value and whether the value was a string
+	 * \return
+	 */
+	bool parseObject(const std::string& line, std::vector<std::pair<std::string, std::pair<std::string, bool>>>& fields) {
+
+		std::size_t i{ 0 };
+
+		auto skip = [&]() { while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) i++; };
+
+		auto readString = [&](std::string& out) {
+			if (i >= line.size() || line[i] != '"') return false;
+			for (i++; i < line.size() && line[i] != '"'; i++) {
+				if (line[i] == '\\' && i + 1 < line.size()) {
+					i++;
+					switch (line[i]) {
+					case 'n': out += '\n'; break;
+					case 't': out += '\t'; break;
+					case 'u': i += 4; break;
+					default: out += line[i];
+					}
+				}
+				else out += line[i];
+			}
+			if (i >= line.size()) return false;
+			i++;
+			return true;
+		};
+
+		skip();
+		if (i >= line.size() || line[i] != '{') return false;
+		i++;
+		skip();
+
+		if (i < line.size() && line[i] == '}') return true;
+
+		while (i < line.size()) {
+
+			std::string key, value;
+			bool isString{ false };
+
+			skip();
+			if (!readString(key)) return false;
+			skip();
+			if (i >= line.size() || line[i] != ':') return false;
+			i++;
+			skip();
+
+			if (i < line.size() && line[i] == '"') {
+				if (!readString(value)) return false;
+				isString = true;
+			}
+			else {
+				while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ' ') value += line[i++];
+				if (!literal(value)) return false;
+			}
+
+			fields.push_back({ key, { value, isString } });
+
+			skip();
+			if (i < line.size() && line[i] == ',') {
+				i++;
+				continue;
+			}
+			return i < line.size() && line[i] == '}';
+
+		}
+
+		return false;
+
+	}
+
+	/**
+	 * .
+	 * Turns a request line into a job. Returns an error message, or an empty string if the request is fine.
+	 * \param line
+	 * \param job
+	 * \return
+	 */
+	std::string parseRequest(const std::string& line, Job& job) {
+
+		std::vector<std::pair<std::string, std::pair<std::string, bool>>> fields;
+
+		if (!parseObject(line, fields)) return "request is not a flat JSON object";
+
+		bool limited{ false };
+
+		for (const auto& [key, field] : fields) {
+
+			const std::string& value = field.first;
+
+			if (key == "id") {
+				job.id = value;
+				job.idIsString = field.second;
+			}
+			else if (key == "fen") job.fen = value;
+			else if (key == "depth") {
+				job.limits.depth = std::clamp(std::atoi(value.c_str()), 1, Search::maxPly - 1);
+				limited = true;
+			}
+			else if (key == "nodes") {
+				job.limits.nodes = std::strtoull(value.c_str(), nullptr, 10);
+				limited = true;
+			}
+			else if (key == "movetime") {
+				job.limits.movetime = std::max(1, std::atoi(value.c_str()));
+				limited = true;
+			}
+			else if (key == "multipv") job.multipv = std::clamp(std::atoi(value.c_str()), 1, maxMultiPV);
+		}
+
+		if (!limited) job.limits.depth = defaultDepth;
+
+		if (job.fen.empty()) return "missing fen";
+		if (!Board::validFEN(job.fen)) return "invalid fen";
+
+		return "";
+
+	}
+
+	std::string idField(const Job& job) {
+		return "\"id\": " + (job.idIsString ? quote(job.id) : job.id);
+	}
+
+	std::string scoreField(int score) {
+		if (score > Search::mateScore - Search::maxPly) return "{\"mate\": " + std::to_string((Search::mateScore - score + 1) / 2) + "}";
+		if (score < -Search::mateScore + Search::maxPly) return "{\"mate\": " + std::to_string(-(Search::mateScore + score) / 2) + "}";
+		return "{\"cp\": " + std::to_string(score) + "}";
+	}
+
+	/**
+	 * .
+	 * Analyzes one job on the calling thread and returns the result line. For multipv the position is searched once
+	 * per line, each time without the best moves of the lines before it.
+	 * \param job
+	 * \return
+	 */
+	std::string analyze(Job& job) {
+
+		Board::loadFEN(job.fen);
+
+		if (std::popcount(Board::WK) != 1 || std::popcount(Board::BK) != 1 || Move::inCheck(!Board::whiteTurn)) {
+			return "{" + idField(job) + ", \"error\": \"illegal position\"}";
+		}
+
+		int legal = (int)Move::legalMoves().size();
+		int lines = std::min(job.multipv, std::max(legal, 1));
+
+		std::ostringstream out;
+		std::ostringstream pvs;
+		std::uint16_t best{ 0 };
+		std::uint64_t nodes{ 0 };
+		std::int64_t time{ 0 };
+
+		for (int k = 0; k < lines; k++) {
+
+			Search::Result result = Search::search(job.limits, false);
+
+			nodes += result.nodes;
+			time += result.time;
+			if (k == 0) best = result.bestMove;
+
+			pvs << (k ? ", " : "") << "{\"multipv\": " << k + 1 << ", \"depth\": " << result.depth << ", \"score\": " << scoreField(result.score) << ", \"pv\": [";
+			for (std::size_t i = 0; i < result.pv.size(); i++) pvs << (i ? ", " : "") << quote(Move::toUCI(result.pv[i]));
+			pvs << "]}";
+
+			if (!result.bestMove) break;
+
+			job.limits.exclude.push_back(result.bestMove);
+			Board::loadFEN(job.fen);
+
+		}
+
+		out << "{" << idField(job) << ", \"bestmove\": " << (best ? quote(Move::toUCI(best)) : "null")
+			<< ", \"nodes\": " << nodes << ", \"time\": " << time << ", \"lines\": [" << pvs.str() << "]}";
+
+		return out.str();
+
+	}
+
+	/**
+	 * .
+	 * Parses a request line and queues it, or answers straight away if it's malformed.
+	 * \param line
+	 * \param sink
+	 */
+	void submit(const std::string& line, const std::shared_ptr<Sink>& sink) {
+
+		if (line.find_first_not_of(" \t\r") == std::string::npos) return;
+
+		Job job;
+		job.sink = sink;
+
+		std::string error = parseRequest(line, job);
+
+		if (!error.empty()) {
+			sink->write("{" + idField(job) + ", \"error\": " + quote(error) + "}");
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard{ queueLock };
+			queue.push_back(std::move(job));
+		}
+
+		queueReady.notify_one();
+
+	}
+
+	/**
+	 * .
+	 * Takes jobs off the queue until it's closed and empty.
+	 * \param options
+	 */
+	void worker(const Search::Options& options) {
+
+		Search::options = options;
+
+		while (true) {
+
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> guard{ queueLock };
+				queueReady.wait(guard, [] { return closed || !queue.empty(); });
+				if (queue.empty()) return;
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			job.sink->write(analyze(job));
+
+		}
+
+	}
+
+#ifndef _WIN32
+
+	/**
+	 * .
+	 * Listens on a Unix domain socket. Every connection is read on its own thread and shares the worker pool.
+	 * Runs until the process is stopped.
+	 * \param path
+	 */
+	void listen(const std::string& path) {
+
+		int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+
+		if (server < 0 || path.size() >= sizeof(address.sun_path)) {
+			std::cout << "info string cannot create socket " << path << std::endl;
+			return;
+		}
+
+		path.copy(address.sun_path, path.size());
+		::unlink(path.c_str());
+
+		if (::bind(server, (sockaddr*)&address, sizeof(address)) < 0 || ::listen(server, 16) < 0) {
+			std::cout << "info string cannot listen on " << path << std::endl;
+			::close(server);
+			return;
+		}
+
+		std::cout << "info string serving on " << path << std::endl;
+
+		while (true) {
+
+			int client = ::accept(server, nullptr, nullptr);
+			if (client < 0) continue;
+
+			std::thread([client] {
+
+				auto sink = std::make_shared<Sink>();
+				sink->fd = client;
+
+				std::string pending;
+				char buffer[65536];
+
+				while (true) {
+
+					ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+					if (n <= 0) break;
+
+					pending.append(buffer, n);
+
+					for (std::size_t end; (end = pending.find('\n')) != std::string::npos; pending.erase(0, end + 1)) {
+						submit(pending.substr(0, end), sink);
+					}
+
+				}
+
+				if (!pending.empty()) submit(pending, sink);
+
+				/*
+				* Stop reading but leave the socket open for the results still being searched. The last job
+				* holding the sink closes it.
+				*/
+				::shutdown(client, SHUT_RD);
+
+			}).detach();
+
+		}
+
+	}
+
+#endif
+
+	/**
+	 * .
+	 * Runs the serve command.
+	 * \param input
+	 */
+	void serve(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name;
+		int threads{ (int)std::max(1u, std::thread::hardware_concurrency()) };
+		int hash{ 256 };
+		std::string socketPath;
+
+		reader >> name;
+		if (!(reader >> threads)) reader.clear();
+		if (!(reader >> hash)) reader.clear();
+		reader >> socketPath;
+
+		threads = std::clamp(threads, 1, 256);
+		hash = std::clamp(hash, 1, 65536);
+
+		/*
+		* The table is sized once here. Workers search with the same Hash value so none of them resizes it.
+		*/
+
+		Search::Options options = Search::options;
+		options.threads = 1;
+		options.hash = hash;
+
+		TT::table.resize(hash);
+
+		closed = false;
+
+		std::vector<std::thread> pool;
+		for (int i = 0; i < threads; i++) pool.emplace_back(worker, options);
+
+		if (!socketPath.empty()) {
+#ifndef _WIN32
+			listen(socketPath);
+#else
+			std::cout << "info string sockets are not supported on this platform" << std::endl;
+#endif
+		}
+		else {
+
+			auto sink = std::make_shared<Sink>();
+
+			std::string line;
+			while (std::getline(std::cin, line)) submit(line, sink);
+
+		}
+
+		{
+			std::lock_guard<std::mutex> guard{ queueLock };
+			closed = true;
+		}
+
+		queueReady.notify_all();
+		for (std::thread& t : pool) t.join();
+
+	}
+
+}
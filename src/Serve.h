@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+namespace Serve {
+
+	extern void serve(const std::string& input);
+
+}
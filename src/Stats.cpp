@@ -0,0 +1,92 @@
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "Stats.h"
+
+/*
+Aggregates the per-thread counters. Every thread's block registers itself when the thread first counts something,
+and adds its totals to the retired counts when the thread exits, so print() sees the work of finished helper and
+worker threads as well as running ones.
+*/
+
+namespace Stats {
+
+#ifdef GORILLA_STATS
+
+	std::mutex lock;
+	std::vector<Block*> live;
+	std::uint64_t retired[counterCount];
+
+	thread_local Block local;
+
+	Block::Block() {
+		std::lock_guard<std::mutex> guard{ lock };
+		live.push_back(this);
+	}
+
+	Block::~Block() {
+		std::lock_guard<std::mutex> guard{ lock };
+		for (int c = 0; c < counterCount; c++) retired[c] += values[c].load(std::memory_order_relaxed);
+		std::erase(live, this);
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> guard{ lock };
+		for (int c = 0; c < counterCount; c++) retired[c] = 0;
+		for (Block* b : live) {
+			for (int c = 0; c < counterCount; c++) b->values[c].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * .
+	 * Prints the totals over all threads as info string lines, with the ratios that matter for tuning the search.
+	 */
+	void print() {
+
+		std::uint64_t t[counterCount]{};
+
+		{
+			std::lock_guard<std::mutex> guard{ lock };
+			for (int c = 0; c < counterCount; c++) t[c] = retired[c];
+			for (Block* b : live) {
+				for (int c = 0; c < counterCount; c++) t[c] += b->values[c].load(std::memory_order_relaxed);
+			}
+		}
+
+		auto percent = [](std::uint64_t part, std::uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; };
+
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(1);
+
+		out << "info string stats nodes " << t[nodes] << " qnodes " << t[qnodes]
+			<< " qnodes% " << percent(t[qnodes], t[nodes] + t[qnodes]) << '\n';
+		out << "info string stats movegen calls " << t[movegenCalls] << " moves/call "
+			<< (t[movegenCalls] ? (double)t[movesGenerated] / t[movegenCalls] : 0.0) << '\n';
+		out << "info string stats tt probes " << t[ttProbes] << " hits " << t[ttHits] << " hit% " << percent(t[ttHits], t[ttProbes])
+			<< " cutoffs " << t[ttCutoffs] << '\n';
+		out << "info string stats betacutoffs " << t[betaCutoffs] << " firstmove% " << percent(t[firstMoveCutoffs], t[betaCutoffs]) << '\n';
+		out << "info string stats nullmove tries " << t[nullTries] << " cutoffs " << t[nullCutoffs]
+			<< " success% " << percent(t[nullCutoffs], t[nullTries]) << '\n';
+		out << "info string stats eval calls " << t[evalCalls] << " cachehit% " << percent(t[evalCacheHits], t[evalCalls])
+			<< " lazy% " << percent(t[lazyExits], t[evalCalls]) << '\n';
+		out << "info string stats time movegen " << t[movegenNs] / 1000000 << "ms eval " << t[evalNs] / 1000000 << "ms" << '\n';
+
+		std::cout << out.str() << std::flush;
+
+	}
+
+#else
+
+	void reset() {}
+
+	void print() {
+		std::cout << "info string stats are disabled in this build (define GORILLA_STATS)" << std::endl;
+	}
+
+#endif
+
+}
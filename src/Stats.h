@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef GORILLA_STATS
+#include <atomic>
+#include <chrono>
+#endif
+
+/*
+Search instrumentation. Counting only happens in builds with GORILLA_STATS defined (cmake -DGORILLA_STATS=ON, or
+the preprocessor definition in Visual Studio). Without it add() and Timer are empty and compile to nothing.
+*/
+
+namespace Stats {
+
+	enum Counter : int {
+		nodes,
+		qnodes,
+		movegenCalls,
+		movesGenerated,
+		ttProbes,
+		ttHits,
+		ttCutoffs,
+		betaCutoffs,
+		firstMoveCutoffs,
+		nullTries,
+		nullCutoffs,
+		evalCalls,
+		evalCacheHits,
+		lazyExits,
+		movegenNs,
+		evalNs,
+		counterCount
+	};
+
+#ifdef GORILLA_STATS
+
+	inline constexpr bool enabled{ true };
+
+	/*
+	* One thread's counters. Only the owning thread writes them, so the atomics are just there to make reading
+	* them from another thread well defined; the increments are plain loads and stores.
+	*/
+	struct Block {
+		std::atomic<std::uint64_t> values[counterCount]{};
+		Block();
+		~Block();
+	};
+
+	extern thread_local Block local;
+
+	inline void add(Counter c, std::uint64_t n = 1) {
+		std::atomic<std::uint64_t>& v = local.values[c];
+		v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	/*
+	* Adds the nanoseconds between its construction and destruction to a counter.
+	*/
+	struct Timer {
+		explicit Timer(Counter c) : counter{ c }, start{ std::chrono::steady_clock::now() } {}
+		~Timer() { add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()); }
+		Counter counter;
+		std::chrono::steady_clock::time_point start;
+	};
+
+#else
+
+	inline constexpr bool enabled{ false };
+
+	inline void add(Counter, std::uint64_t = 1) {}
+
+	struct Timer {
+		explicit Timer(Counter) {}
+	};
+
+#endif
+
+	extern void reset();
+
+	extern void print();
+
+}
@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "TT.h"
+
+/*
+The transposition table. Every entry is 16 bytes: the Zobrist key xored with the data, then the data itself:
+
+bits 0-15	best move (16 bit representation)
+bits 16-31	score (signed, mates stored relative to the node, not the root)
+bits 32-39	depth searched
+bits 40-41	bound
+
+The table size is a power of two so the index is the low bits of the key. There are no buckets: an entry is
+replaced by any search of another position, or by a search of the same position that went at least as deep.
+
+A table can be saved to a file and loaded back later to warm start a new session. The file is a 4096 byte header
+(see FileHeader) followed by the entries exactly as they are in memory. Loading maps the file copy-on-write and
+uses the mapping as the table, so nothing is read until the search touches it and the file itself never changes.
+*/
+
+namespace TT {
+
+	//The table used by UCI searches. Matches and test suites give each thread its own table.
+
+	Table table;
+
+	/*
+	* Start of a saved table. The header takes a whole page so the entries after it stay page aligned when mapped.
+	*/
+	struct FileHeader {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t entrySize;
+		std::uint64_t count;
+		std::uint64_t megabytes;
+	};
+
+	constexpr char fileMagic[8] = { 'G', 'o', 'r', 'i', 'l', 'l', 'a', 'T' };
+	constexpr std::uint32_t fileVersion{ 1 };
+	constexpr std::size_t headerBytes{ 4096 };
+
+	static_assert(sizeof(FileHeader) <= headerBytes, "the header has to fit in its page");
+
+	/**
+	 * .
+	 * Reallocates the table with the largest power of two number of entries that fits in the given megabytes.
+	 * The contents are lost.
+	 * \param megabytes
+	 */
+	void Table::resize(std::size_t megabytes) {
+
+		release();
+		mb = megabytes;
+
+		std::size_t fit = (megabytes << 20) / sizeof(Entry);
+		if (fit == 0) return;
+
+		std::size_t entryCount{ 1 };
+		while (entryCount * 2 <= fit) entryCount *= 2;
+
+		/*
+		* The block comes zeroed. Clearing it anyway touches every page now, so the first searches don't pay for
+		* the page faults and the kernel has backed it with huge pages by the time pages() looks.
+		*/
+
+		block = LargePages::allocate(entryCount * sizeof(Entry));
+		if (!block.data) return;
+
+		entries = static_cast<Entry*>(block.data);
+		count = entryCount;
+		clear();
+
+	}
+
+	void Table::clear() {
+		if (entries) std::memset(entries, 0, count * sizeof(Entry));
+	}
+
+	/**
+	 * .
+	 * Looks up a position. Returns false if it isn't in the table.
+	 * \param key
+	 * \param hit
+	 * \return
+	 */
+	bool Table::probe(std::uint64_t key, Hit& hit) const {
+
+		if (!count) return false;
+
+		const Entry& e = entries[key & (count - 1)];
+		std::uint64_t data = e.data;
+
+		if ((e.check ^ data) != key || data == 0) return false;
+
+		hit.move = (std::uint16_t)data;
+		hit.score = (std::int16_t)(data >> 16);
+		hit.depth = (std::uint8_t)(data >> 32);
+		hit.bound = (Bound)((data >> 40) & 0b11);
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Stores the result of searching a position. Keeps the old best move if the new search didn't find one.
+	 * \param key
+	 * \param move
+	 * \param score
+	 * \param depth
+	 * \param bound
+	 */
+	void Table::store(std::uint64_t key, std::uint16_t move, int score, int depth, Bound bound) {
+
+		if (!count) return;
+
+		Entry& e = entries[key & (count - 1)];
+		std::uint64_t old = e.data;
+		bool same = (e.check ^ old) == key;
+
+		if (same && depth < (int)(std::uint8_t)(old >> 32) && bound != exact) return;
+		if (same && !move) move = (std::uint16_t)old;
+
+		std::uint64_t data = move
+			| (std::uint64_t)(std::uint16_t)score << 16
+			| (std::uint64_t)(std::uint8_t)depth << 32
+			| (std::uint64_t)bound << 40;
+
+		e.data = data;
+		e.check = key ^ data;
+
+	}
+
+	/**
+	 * .
+	 * The entries searched at least minDepth deep, deepest first, at most max of them. Used to share the most
+	 * expensive results with another process (see Cluster.cpp). Scans the whole table.
+	 * \param minDepth
+	 * \param max
+	 * \return
+	 */
+	std::vector<Entry> Table::deepest(int minDepth, std::size_t max) const {
+
+		std::vector<Entry> found;
+
+		for (std::size_t i = 0; i < count; i++) {
+			Entry e = entries[i];
+			if (e.data && (int)(std::uint8_t)(e.data >> 32) >= minDepth) found.push_back(e);
+		}
+
+		auto depth = [](const Entry& e) { return (std::uint8_t)(e.data >> 32); };
+
+		if (found.size() > max) {
+			std::nth_element(found.begin(), found.begin() + max, found.end(), [&](const Entry& a, const Entry& b) { return depth(a) > depth(b); });
+			found.resize(max);
+		}
+
+		std::sort(found.begin(), found.end(), [&](const Entry& a, const Entry& b) { return depth(a) > depth(b); });
+
+		return found;
+
+	}
+
+	/**
+	 * .
+	 * Stores an entry taken from another table, with the same replacement rule as store().
+	 * \param e
+	 */
+	void Table::merge(const Entry& e) {
+
+		if (!e.data) return;
+
+		store(e.check ^ e.data, (std::uint16_t)e.data, (std::int16_t)(e.data >> 16), (std::uint8_t)(e.data >> 32), (Bound)((e.data >> 40) & 0b11));
+
+	}
+
+	/**
+	 * .
+	 * Writes the table to a file. It's written to a temporary file first and then renamed over the old one, so a
+	 * table that was loaded from the same file keeps working while it's replaced, and a failed save leaves the
+	 * previous file as it was.
+	 * \param path
+	 * \return
+	 */
+	bool Table::save(const std::string& path) const {
+
+		if (!count) return false;
+
+		std::string temporary = path + ".tmp";
+
+		{
+			std::ofstream out{ temporary, std::ios::binary | std::ios::trunc };
+			if (!out) return false;
+
+			char header[headerBytes]{};
+			FileHeader h{};
+			std::memcpy(h.magic, fileMagic, sizeof(h.magic));
+			h.version = fileVersion;
+			h.entrySize = sizeof(Entry);
+			h.count = count;
+			h.megabytes = mb;
+			std::memcpy(header, &h, sizeof(h));
+
+			out.write(header, sizeof(header));
+			out.write(reinterpret_cast<const char*>(entries), count * sizeof(Entry));
+			out.close();
+
+			if (!out) {
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+
+		//Replaces an existing file in one step, on Windows too, so the previous snapshot is never lost
+
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+
+		if (error) {
+			std::remove(temporary.c_str());
+			return false;
+		}
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Replaces the table with one saved by save(). The table takes the size it was saved with. Returns false, and
+	 * leaves the table as it was, if the file can't be read or wasn't written by this version.
+	 * \param path
+	 * \return
+	 */
+	bool Table::load(const std::string& path) {
+
+		FileHeader h{};
+
+		{
+			std::ifstream in{ path, std::ios::binary };
+			if (!in.read(reinterpret_cast<char*>(&h), sizeof(h))) return false;
+		}
+
+		if (std::memcmp(h.magic, fileMagic, sizeof(h.magic)) != 0 || h.version != fileVersion || h.entrySize != sizeof(Entry)) return false;
+		if (h.count == 0 || (h.count & (h.count - 1)) != 0) return false;
+
+		std::size_t bytes = headerBytes + h.count * sizeof(Entry);
+
+#ifdef _WIN32
+		/*
+		* A copy-on-write view would keep the file locked, so on Windows the entries are read into memory instead.
+		*/
+
+		std::ifstream in{ path, std::ios::binary };
+		in.seekg(0, std::ios::end);
+		if ((std::size_t)in.tellg() < bytes) return false;
+
+		LargePages::Block loaded = LargePages::allocate(h.count * sizeof(Entry));
+		in.seekg(headerBytes);
+		if (!loaded.data || !in.read(static_cast<char*>(loaded.data), h.count * sizeof(Entry))) {
+			LargePages::release(loaded);
+			return false;
+		}
+
+		release();
+		block = loaded;
+		entries = static_cast<Entry*>(block.data);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < bytes) {
+			::close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED) return false;
+
+		madvise(data, bytes, MADV_RANDOM);
+
+		release();
+		memory = mapped;
+		mapping = data;
+		mappingBytes = bytes;
+		entries = reinterpret_cast<Entry*>(static_cast<char*>(data) + headerBytes);
+#endif
+
+		count = h.count;
+		mb = h.megabytes;
+
+		return true;
+
+	}
+
+	/**
+	 * .
+	 * Frees the entries, however they were allocated.
+	 */
+	void Table::release() {
+
+		if (memory == mapped) {
+#ifndef _WIN32
+			munmap(mapping, mappingBytes);
+#endif
+		}
+		else LargePages::release(block);
+
+		entries = nullptr;
+		mapping = nullptr;
+		mappingBytes = 0;
+		memory = allocated;
+		count = 0;
+
+	}
+
+	/**
+	 * .
+	 * Describes the memory the table is on, for info string output.
+	 * \return
+	 */
+	std::string Table::pages() const {
+		if (memory == mapped) return "a copy-on-write mapping of the saved file";
+		return LargePages::describe(block);
+	}
+
+	Table::~Table() { release(); }
+
+}
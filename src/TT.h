@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LargePages.h"
+
+namespace TT {
+
+	/*
+	* What a stored score says about the real score: exact, at most (upper) or at least (lower).
+	*/
+	enum Bound : std::uint8_t { none, upper, lower, exact };
+
+	/*
+	* One slot of the table. The key is stored xored with the data, so an entry torn by two threads writing at
+	* once fails the key check instead of returning another position's data.
+	*/
+	struct Entry {
+		std::uint64_t check;
+		std::uint64_t data;
+	};
+
+	static_assert(sizeof(Entry) == 16, "TT::Entry must stay 16 bytes");
+
+	/*
+	* The unpacked contents of an entry.
+	*/
+	struct Hit {
+		std::uint16_t move;
+		int score;
+		int depth;
+		Bound bound;
+	};
+
+	/*
+	* A hash table of search results, indexed by the Zobrist hash of the position. It's safe to share between
+	* search threads without locking.
+	*/
+	struct Table {
+
+		Table() = default;
+		Table(const Table&) = delete;
+		Table& operator=(const Table&) = delete;
+
+		void resize(std::size_t mb);
+		void clear();
+
+		bool probe(std::uint64_t key, Hit& hit) const;
+		void store(std::uint64_t key, std::uint16_t move, int score, int depth, Bound bound);
+
+		std::vector<Entry> deepest(int minDepth, std::size_t max) const;
+		void merge(const Entry& e);
+
+		bool save(const std::string& path) const;
+		bool load(const std::string& path);
+
+		std::size_t megabytes() const { return mb; }
+
+		void release();
+
+		~Table();
+
+		Entry* entries{ nullptr };
+		std::size_t count{ 0 };
+		std::size_t mb{ 0 };
+
+		std::string pages() const;
+
+		/*
+		* How the entries were allocated, so they're freed the same way. A new table is a (huge page) block; a loaded
+		* table maps its file, and then mapping is the start of the mapping (the file header) rather than the first entry.
+		*/
+		enum Memory : std::uint8_t { allocated, mapped };
+		Memory memory{ allocated };
+		LargePages::Block block;
+		void* mapping{ nullptr };
+		std::size_t mappingBytes{ 0 };
+
+	};
+
+	extern Table table;
+
+}
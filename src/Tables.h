@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "Board.h"
+
+/*
+Lookup tables built at compile time. They use the same square layout as the board: index 0 is A8, index 63 is H1,
+so row 0 is the eighth rank and column 0 is the A file. Everything here is constexpr, so there's nothing to
+initialize at startup and the compiler can fold lookups with constant squares.
+*/
+
+namespace Tables {
+
+	using Table = std::array<std::uint64_t, 64>;
+
+	/**
+	 * .
+	 * Bit of the square at a row and column, or 0 if it's off the board.
+	 * \param row
+	 * \param col
+	 * \return
+	 */
+	constexpr std::uint64_t bit(int row, int col) {
+		return (row >= 0 && row < 8 && col >= 0 && col < 8) ? 1ULL << (row * 8 + col) : 0;
+	}
+
+	/**
+	 * .
+	 * Builds the attacks of a piece that jumps by fixed (row, column) offsets.
+	 * \param offsets
+	 * \return
+	 */
+	template<std::size_t N>
+	constexpr Table leaper(const int (&offsets)[N][2]) {
+		Table table{};
+		for (int sq = 0; sq < 64; sq++) {
+			for (std::size_t i = 0; i < N; i++) table[sq] |= bit(sq / 8 + offsets[i][0], sq % 8 + offsets[i][1]);
+		}
+		return table;
+	}
+
+	/**
+	 * .
+	 * Builds a mask per square of all squares that share some property with it (e.g. the same row).
+	 * \param same
+	 * \return
+	 */
+	template<typename F>
+	constexpr Table maskBy(F same) {
+		Table table{};
+		for (int sq = 0; sq < 64; sq++) {
+			for (int other = 0; other < 64; other++) {
+				if (same(sq, other)) table[sq] |= 1ULL << other;
+			}
+		}
+		return table;
+	}
+
+	constexpr int knightOffsets[8][2] = { { -2, -1 }, { -2, 1 }, { -1, -2 }, { -1, 2 }, { 1, -2 }, { 1, 2 }, { 2, -1 }, { 2, 1 } };
+	constexpr int kingOffsets[8][2] = { { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, -1 }, { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 } };
+	constexpr int whitePawnOffsets[2][2] = { { -1, -1 }, { -1, 1 } };
+	constexpr int blackPawnOffsets[2][2] = { { 1, -1 }, { 1, 1 } };
+
+	inline constexpr Table knightAttacks = leaper(knightOffsets);
+	inline constexpr Table kingAttacks = leaper(kingOffsets);
+
+	//pawnAttacks[0] are the squares a white pawn attacks, pawnAttacks[1] a black pawn
+	inline constexpr std::array<Table, 2> pawnAttacks = { leaper(whitePawnOffsets), leaper(blackPawnOffsets) };
+
+	//Row (rank) and column (file) through each square
+	inline constexpr Table rowMask = maskBy([](int a, int b) { return a / 8 == b / 8; });
+	inline constexpr Table colMask = maskBy([](int a, int b) { return a % 8 == b % 8; });
+
+	//Diagonal (A8-H1 direction) and anti-diagonal (A1-H8 direction) through each square
+	inline constexpr Table diagonalMask = maskBy([](int a, int b) { return a / 8 - a % 8 == b / 8 - b % 8; });
+	inline constexpr Table antiDiagonalMask = maskBy([](int a, int b) { return a / 8 + a % 8 == b / 8 + b % 8; });
+
+	/**
+	 * .
+	 * Walks from one square towards another one step at a time. If they share a row, column or diagonal,
+	 * returns the squares strictly between them (between) or the whole line through both (line). Otherwise 0.
+	 * \param a
+	 * \param b
+	 * \param wholeLine
+	 * \return
+	 */
+	constexpr std::uint64_t ray(int a, int b, bool wholeLine) {
+
+		if (a == b) return 0;
+
+		int dr = b / 8 - a / 8;
+		int dc = b % 8 - a % 8;
+
+		if (dr != 0 && dc != 0 && dr != dc && dr != -dc) return 0;
+
+		int stepR = (dr > 0) - (dr < 0);
+		int stepC = (dc > 0) - (dc < 0);
+
+		std::uint64_t squares{ 0 };
+
+		if (wholeLine) {
+			for (int r = a / 8, c = a % 8; bit(r, c); r -= stepR, c -= stepC) squares |= bit(r, c);
+			for (int r = a / 8, c = a % 8; bit(r, c); r += stepR, c += stepC) squares |= bit(r, c);
+		}
+		else {
+			for (int r = a / 8 + stepR, c = a % 8 + stepC; r * 8 + c != b; r += stepR, c += stepC) squares |= bit(r, c);
+		}
+
+		return squares;
+
+	}
+
+	constexpr std::array<Table, 64> rays(bool wholeLine) {
+		std::array<Table, 64> table{};
+		for (int a = 0; a < 64; a++) {
+			for (int b = 0; b < 64; b++) table[a][b] = ray(a, b, wholeLine);
+		}
+		return table;
+	}
+
+	inline constexpr std::array<Table, 64> between = rays(false);
+	inline constexpr std::array<Table, 64> line = rays(true);
+
+	/**
+	 * .
+	 * SplitMix64 pseudo-random numbers, so the Zobrist keys are fixed at compile time and the same in every build.
+	 * \param state
+	 * \return
+	 */
+	constexpr std::uint64_t splitMix(std::uint64_t& state) {
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	/*
+	* Zobrist hashing keys: one per piece (WP ... BK, 0-11) per square, one per castling rights combination,
+	* one per en passant column, and one for black to move.
+	*/
+	struct ZobristKeys {
+		std::uint64_t piece[12][64];
+		std::uint64_t castling[16];
+		std::uint64_t enPassant[8];
+		std::uint64_t blackToMove;
+	};
+
+	constexpr ZobristKeys makeZobrist() {
+		ZobristKeys keys{};
+		std::uint64_t state{ 0x476F72696C6C61ULL };
+		for (int p = 0; p < 12; p++) {
+			for (int sq = 0; sq < 64; sq++) keys.piece[p][sq] = splitMix(state);
+		}
+		for (int c = 0; c < 16; c++) keys.castling[c] = splitMix(state);
+		for (int f = 0; f < 8; f++) keys.enPassant[f] = splitMix(state);
+		keys.blackToMove = splitMix(state);
+		return keys;
+	}
+
+	inline constexpr ZobristKeys zobrist = makeZobrist();
+
+	static_assert(knightAttacks[0] == (Board::arrOfSquares[10] | Board::arrOfSquares[17]), "knight on A8 attacks C7 and B6");
+	static_assert(kingAttacks[63] == (Board::arrOfSquares[54] | Board::arrOfSquares[55] | Board::arrOfSquares[62]), "king on H1");
+	static_assert(rowMask[0] == Board::row8 && colMask[0] == Board::colA, "masks agree with Board");
+	static_assert(between[56][63] == (Board::row1 & ~(Board::colA | Board::colH)), "between A1 and H1");
+
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "Trace.h"
+
+/*
+The trace command and the bookkeeping of the per-thread buffers: trace on [events per thread], trace off,
+trace clear, trace dump <file>. Every ring registers itself and takes a slot when its thread first records, and
+hands its events over to the slot's retired events when the thread exits, so helper threads of finished searches
+are in the dump too. Dumping and clearing are meant for when no search is running.
+*/
+
+namespace Trace {
+
+#ifdef GORILLA_TRACE
+
+	std::atomic<bool> recording{ false };
+
+	std::mutex lock;
+	std::vector<Ring*> live;
+	std::vector<std::vector<Event>> retired;		//per slot, the newest events of the threads that exited, oldest first
+
+	//Events kept per thread, a power of 2
+
+	std::size_t capacity{ 1 << 20 };
+
+	thread_local Ring ring;
+
+	/**
+	 * .
+	 * The events of a ring, oldest first.
+	 * \param r
+	 * \return
+	 */
+	std::vector<Event> ordered(const Ring& r) {
+
+		std::uint64_t head = r.head.load(std::memory_order_acquire);
+		std::size_t size = r.events.size();
+
+		std::vector<Event> out;
+		if (size == 0) return out;
+
+		for (std::uint64_t i = head > size ? head - size : 0; i < head; i++) out.push_back(r.events[i & (size - 1)]);
+
+		return out;
+
+	}
+
+	/**
+	 * .
+	 * Appends events to older ones of the same slot, keeping the newest capacity events.
+	 * \param to
+	 * \param from
+	 */
+	void append(std::vector<Event>& to, const std::vector<Event>& from) {
+		to.insert(to.end(), from.begin(), from.end());
+		if (to.size() > capacity) to.erase(to.begin(), to.end() - capacity);
+	}
+
+	Ring::Ring() {
+
+		std::lock_guard<std::mutex> guard{ lock };
+
+		while (std::any_of(live.begin(), live.end(), [this](const Ring* r) { return r->slot == slot; })) slot++;
+
+		live.push_back(this);
+
+	}
+
+	Ring::~Ring() {
+
+		std::lock_guard<std::mutex> guard{ lock };
+
+		std::vector<Event> kept = ordered(*this);
+
+		if (!kept.empty()) {
+			if (retired.size() <= slot) retired.resize(slot + 1);
+			append(retired[slot], kept);
+		}
+
+		std::erase(live, this);
+
+	}
+
+	void Ring::push(const Event& e) {
+
+		if (events.size() != capacity) {
+			events.assign(capacity, Event{});
+			head.store(0, std::memory_order_relaxed);
+		}
+
+		std::uint64_t h = head.load(std::memory_order_relaxed);
+		events[h & (capacity - 1)] = e;
+		head.store(h + 1, std::memory_order_release);
+
+	}
+
+	void command(const std::string& input) {
+
+		std::istringstream reader{ input };
+		std::string name, action, arg;
+
+		reader >> name >> action >> arg;
+
+		if (action == "on") {
+			if (!arg.empty()) {
+				std::size_t events = std::strtoull(arg.c_str(), nullptr, 10);
+				std::size_t size{ 1 };
+				while (size < events) size <<= 1;
+				capacity = size;
+			}
+			recording = true;
+			std::cout << "info string trace on, " << capacity << " events per thread" << std::endl;
+		}
+		else if (action == "off") {
+			recording = false;
+		}
+		else if (action == "clear") {
+			std::lock_guard<std::mutex> guard{ lock };
+			retired.clear();
+			retired.shrink_to_fit();
+			for (Ring* r : live) r->head.store(0, std::memory_order_relaxed);
+		}
+		else if (action == "dump" && !arg.empty()) {
+
+			std::vector<std::vector<Event>> threads;
+
+			/*
+			* A slot's retired events are older than those of the thread holding it now.
+			*/
+
+			{
+				std::lock_guard<std::mutex> guard{ lock };
+
+				std::vector<std::vector<Event>> slots = retired;
+
+				for (Ring* r : live) {
+					if (slots.size() <= r->slot) slots.resize(r->slot + 1);
+					append(slots[r->slot], ordered(*r));
+				}
+
+				for (std::vector<Event>& events : slots) {
+					if (!events.empty()) threads.push_back(std::move(events));
+				}
+			}
+
+			std::ofstream out{ arg, std::ios::binary };
+
+			std::uint32_t magic{ fileMagic }, count{ (std::uint32_t)threads.size() };
+			out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+			out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+			std::uint64_t total{ 0 };
+
+			for (const std::vector<Event>& events : threads) {
+				std::uint64_t n = events.size();
+				out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+				out.write(reinterpret_cast<const char*>(events.data()), (std::streamsize)(n * sizeof(Event)));
+				total += n;
+			}
+
+			if (!out) std::cout << "info string cannot write " << arg << std::endl;
+			else std::cout << "info string trace wrote " << total << " events of " << threads.size() << " threads to " << arg << std::endl;
+
+		}
+		else std::cout << "info string usage: trace on [events] | off | clear | dump <file>" << std::endl;
+
+	}
+
+#else
+
+	void command(const std::string&) {
+		std::cout << "info string trace is disabled in this build (define GORILLA_TRACE)" << std::endl;
+	}
+
+#endif
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef GORILLA_TRACE
+#include <atomic>
+#endif
+
+/*
+Search tracing for debugging node count blowups. Recording only exists in builds with GORILLA_TRACE defined (cmake
+-DGORILLA_TRACE=ON); without it every call below is empty and compiles to nothing, like Stats. Even in a tracing
+build nothing is recorded until "trace on", and the search only tests a flag per node until then.
+
+Each thread records into its own ring buffer, keeping the newest events. Only the owning thread writes to it, so
+recording takes no lock. "trace dump <file>" writes every thread's buffer to a file that gorilla-trace
+(tools/TraceView.cpp) turns back into trees and summarizes.
+
+Threads come and go (lazy SMP starts new helpers for every search), so buffers are kept per slot rather than per
+thread: a thread takes the lowest slot no running thread has, and when it exits its events are appended to the
+slot's retired events, of which only the newest "events per thread" are kept. There are only as many slots as
+threads ever ran at once, so a long session holds at most two buffers per slot (the running thread's and the
+retired one) however many searches it traces, and the dump has one stream of events per slot.
+*/
+
+namespace Trace {
+
+	enum Kind : std::uint8_t {
+		enterNode,			//a full width node (negamax)
+		enterQuiescence,	//a quiescence node
+		leave,				//the node entered last returns
+		ttHit				//the transposition table had the node's position
+	};
+
+	/*
+	* Why a node returned.
+	*/
+	enum Reason : std::uint8_t {
+		exact,		//searched every move, the score is inside the window
+		failLow,	//searched every move, none reached alpha
+		betaCutoff,	//a move reached beta
+		ttCutoff,	//the transposition table had a deep enough result
+		nullCutoff,	//null-move pruning
+		draw,		//fifty moves, repetition or a bitbase draw
+		standPat,	//quiescence: the static evaluation was already good enough
+		stopped		//a limit ran out
+	};
+
+	/*
+	* One event, 16 bytes.
+	*/
+	struct Event {
+		Kind kind;
+		std::uint8_t ply;
+		std::int8_t depth;
+		Reason reason;			//leave
+		std::uint16_t move;		//enter: the move played into the node, leave: the move that cut off, ttHit: the table's move
+		std::uint16_t order;	//enter: the move's place among the node's siblings (1 is first), leave: the cutoff move's place
+		std::int16_t a;			//enter: alpha, leave: the score
+		std::int16_t b;			//enter: beta
+		std::uint32_t key;		//enter: low half of the Zobrist hash
+	};
+
+	static_assert(sizeof(Event) == 16, "Trace::Event must stay 16 bytes");
+
+	/*
+	* Layout of a dump: the magic and the number of thread slots, then for each slot its event count and its events,
+	* oldest first.
+	*/
+	constexpr std::uint32_t fileMagic{ 0x43525447 };	//"GTRC"
+
+#ifdef GORILLA_TRACE
+
+	inline constexpr bool enabled{ true };
+
+	extern std::atomic<bool> recording;
+
+	/*
+	* One thread's ring buffer, plus what the search told it about the node being entered or left.
+	*/
+	struct Ring {
+
+		std::vector<Event> events;
+		std::atomic<std::uint64_t> head{ 0 };
+
+		std::uint16_t nextMove{ 0 };
+		std::uint16_t nextOrder{ 0 };
+		Reason reason{ exact };
+		bool noted{ false };
+		std::uint16_t cutMove{ 0 };
+		std::uint16_t cutOrder{ 0 };
+
+		std::size_t slot{ 0 };
+
+		Ring();
+		~Ring();
+
+		void push(const Event& e);
+
+	};
+
+	extern thread_local Ring ring;
+
+	inline bool active() {
+		return recording.load(std::memory_order_relaxed);
+	}
+
+	/*
+	* The move about to be searched and its place among its siblings. Taken by the next enter.
+	*/
+	inline void move(std::uint16_t m, int order) {
+		ring.nextMove = m;
+		ring.nextOrder = (std::uint16_t)order;
+	}
+
+	inline void enter(Kind kind, int ply, int depth, int alpha, int beta, std::uint64_t key) {
+		ring.push(Event{ kind, (std::uint8_t)ply, (std::int8_t)depth, exact, ring.nextMove, ring.nextOrder, (std::int16_t)alpha, (std::int16_t)beta, (std::uint32_t)key });
+		ring.noted = false;
+	}
+
+	/*
+	* Why the current node is about to return, when it isn't just the score against the window.
+	*/
+	inline void note(Reason reason, std::uint16_t m = 0, int order = 0) {
+		ring.reason = reason;
+		ring.cutMove = m;
+		ring.cutOrder = (std::uint16_t)order;
+		ring.noted = true;
+	}
+
+	inline void exit(int ply, int depth, int score, int alpha) {
+		Reason r = ring.noted ? ring.reason : score > alpha ? exact : failLow;
+		ring.push(Event{ leave, (std::uint8_t)ply, (std::int8_t)depth, r, ring.noted ? ring.cutMove : (std::uint16_t)0,
+			ring.noted ? ring.cutOrder : (std::uint16_t)0, (std::int16_t)score, 0, 0 });
+		ring.noted = false;
+	}
+
+	inline void hit(int ply, int depth, std::uint16_t m) {
+		ring.push(Event{ ttHit, (std::uint8_t)ply, (std::int8_t)depth, exact, m, 0, 0, 0, 0 });
+	}
+
+#else
+
+	inline constexpr bool enabled{ false };
+
+	inline constexpr bool active() { return false; }
+	inline void move(std::uint16_t, int) {}
+	inline void enter(Kind, int, int, int, int, std::uint64_t) {}
+	inline void note(Reason, std::uint16_t = 0, int = 0) {}
+	inline void exit(int, int, int, int) {}
+	inline void hit(int, int, std::uint16_t) {}
+
+#endif
+
+	extern void command(const std::string& input);
+
+}
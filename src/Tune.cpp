@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Tune.h"
+#include "Bitbase.h"
+#include "Board.h"
+#include "Eval.h"
+#include "Move.h"
+#include "Pack.h"
+
+/*
+Texel tuning of the evaluation parameters (Eval::params) from positions labeled with the result of their game.
+
+tune <file> [epochs] [threads] [rate=<cp per step>] [k=<scale>] [out=<file>]
+
+The file is either text, one position per line with its result (FEN or EPD followed by 1-0, 0-1, 1/2-1/2 or [1.0],
+[0.5], [0.0], quotes and semicolons allowed), or packed records (a name ending in .pack, see Pack.h) with the result
+byte set. Positions without a result or with an invalid FEN are skipped, and so are those that resolve into an
+endgame Bitbase::probe() knows: the engine scores them from the bitbase, not from the parameters.
+
+Each position is first resolved with a quiescence search on captures, and the quiet position it ends in is turned
+into its evaluation features (Eval::features): the parameters it uses and how often. The evaluation is linear in
+the parameters, so from there on no board is touched: a position's score is the dot product of its features with
+the parameters. The error is the mean squared difference between the result and a sigmoid of the score, and Adam
+minimizes it over full passes (epochs) through the data.
+
+Every thread loads, resolves and later scores its own slice of the positions. The features of a slice are stored
+as flat arrays (compressed rows), so a pass is a linear walk through memory, and each thread adds its gradient up
+in its own array, summed once per epoch.
+
+The tuned values are rounded into Eval::params, so the running engine uses them right away, and written to out.
+*/
+
+namespace Tune {
+
+	struct Config {
+		std::string file;
+		int epochs{ 500 };
+		int threads{ (int)std::max(1u, std::thread::hardware_concurrency()) };
+		double rate{ 1.0 };
+		double k{ 0 };
+		std::string out{ "gorilla.params" };
+	};
+
+	/*
+	* The positions of one thread, as sparse feature vectors: the features of position i are index[j], count[j]
+	* for j from begin[i] to begin[i + 1] - 1. Results are from white's point of view (1 win, 0.5 draw, 0 loss).
+	*/
+	struct Slice {
+		std::vector<std::uint16_t> index;
+		std::vector<std::int16_t> count;
+		std::vector<std::uint32_t> begin{ 0 };
+		std::vector<float> result;
+	};
+
+	//Longest capture sequence followed when resolving a position
+
+	constexpr int maxQuietPlies{ 16 };
+
+	/**
+	 * .
+	 * Quiescence search that also returns the position its principal variation ends in.
+	 * \param alpha
+	 * \param beta
+	 * \param plies captures left before the search stops
+	 * \param leaf set to the quiet position
+	 * \return the score relative to the side to move
+	 */
+	int quiet(int alpha, int beta, int plies, Board::State& leaf) {
+
+		leaf = Board::save();
+
+		int standPat = Eval::evaluate();
+
+		if (plies == 0 || standPat >= beta) return standPat;
+		if (standPat > alpha) alpha = standPat;
+
+		/*
+		* Captures and queen promotions, most valuable victim first, then least valuable attacker.
+		*/
+
+		std::vector<std::pair<int, std::uint16_t>> noisy;
+
+		for (std::uint16_t m : Move::generate()) {
+			int special = (m & Move::specMask) >> 14;
+			int victim = Board::pieceAt(m & Move::toMask);
+			if (victim == -1 && special != 2 && !(special == 1 && (m & Move::promoMask) == 0)) continue;
+			int order = (victim == -1 ? Eval::pieceValue[0] : Eval::pieceValue[victim % 6]) * 10 - Eval::pieceValue[Board::pieceAt((m & Move::fromMask) >> 6) % 6] / 10;
+			noisy.push_back({ order, m });
+		}
+
+		std::sort(noisy.begin(), noisy.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		Board::State state = leaf;
+		Board::State childLeaf;
+
+		for (const auto& [order, m] : noisy) {
+
+			if (!Move::makeLegal(m)) {
+				Board::restore(state);
+				continue;
+			}
+
+			int score = -quiet(-beta, -alpha, plies - 1, childLeaf);
+
+			Board::restore(state);
+
+			if (score > alpha) {
+				alpha = score;
+				leaf = childLeaf;
+				if (score >= beta) break;
+			}
+
+		}
+
+		return alpha;
+
+	}
+
+	/**
+	 * .
+	 * Finds the result in the rest of a text line, after the position. Returns a negative number if there is none.
+	 * \param line
+	 * \return
+	 */
+	float parseResult(const std::string& line) {
+
+		std::istringstream reader{ line };
+		std::string token;
+
+		for (int field = 0; reader >> token; field++) {
+
+			if (field < 4) continue;
+
+			bool bracketed = token.find('[') != std::string::npos;
+			token.erase(std::remove_if(token.begin(), token.end(), [](char c) { return c == '"' || c == ';' || c == '[' || c == ']'; }), token.end());
+
+			if (token == "1-0") return 1.0f;
+			if (token == "0-1") return 0.0f;
+			if (token == "1/2-1/2") return 0.5f;
+
+			//Bare numbers would be the clocks, so only bracketed ones count
+			if (bracketed && (token == "1.0" || token == "1")) return 1.0f;
+			if (bracketed && token == "0.5") return 0.5f;
+			if (bracketed && (token == "0.0" || token == "0")) return 0.0f;
+
+		}
+
+		return -1.0f;
+
+	}
+
+	/**
+	 * .
+	 * Resolves the position on the board and adds its features to a slice, unless it ends in a bitbase endgame.
+	 * \param slice
+	 * \param result
+	 * \param features scratch space
+	 */
+	void add(Slice& slice, float result, std::vector<Eval::Feature>& features) {
+
+		Board::State leaf;
+		quiet(-Eval::pieceValue[4] * 10, Eval::pieceValue[4] * 10, maxQuietPlies, leaf);
+		Board::restore(leaf);
+
+		if (Bitbase::probe() != Bitbase::unknown) return;
+
+		Eval::features(features);
+
+		for (const Eval::Feature& f : features) {
+			slice.index.push_back(f.index);
+			slice.count.push_back(f.count);
+		}
+
+		slice.begin.push_back((std::uint32_t)slice.index.size());
+		slice.result.push_back(result);
+
+	}
+
+	/**
+	 * .
+	 * Loads the positions, each thread taking an even share of the file, and turns them into features.
+	 * \param cfg
+	 * \return one slice per thread, or nothing if the file can't be read
+	 */
+	std::vector<Slice> load(const Config& cfg) {
+
+		std::vector<Slice> slices(cfg.threads);
+		std::vector<std::thread> workers;
+
+		bool packed = cfg.file.size() > 5 && cfg.file.substr(cfg.file.size() - 5) == ".pack";
+
+		if (packed) {
+
+			Pack::Reader reader;
+			if (!reader.open(cfg.file)) return {};
+
+			for (int t = 0; t < cfg.threads; t++) {
+				workers.emplace_back([&, t] {
+
+					std::vector<Eval::Feature> features;
+
+					for (std::size_t i = reader.size() * t / cfg.threads; i < reader.size() * (t + 1) / cfg.threads; i++) {
+
+						std::uint8_t result = Pack::result(reader[i]);
+						if (result == Pack::noResult) continue;
+
+						Pack::unpack(reader[i]);
+						add(slices[t], result == Pack::whiteWin ? 1.0f : result == Pack::draw ? 0.5f : 0.0f, features);
+
+					}
+
+				});
+			}
+
+			for (std::thread& w : workers) w.join();
+
+			return slices;
+
+		}
+
+		/*
+		* Text is read whole, then split into byte ranges that are moved forward to the next line.
+		*/
+
+		std::ifstream in{ cfg.file, std::ios::binary };
+		if (!in) return {};
+
+		std::string text{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+
+		for (int t = 0; t < cfg.threads; t++) {
+			workers.emplace_back([&, t] {
+
+				auto lineStart = [&](std::size_t at) {
+					if (at == 0 || at >= text.size()) return std::min(at, text.size());
+					std::size_t nl = text.find('\n', at - 1);
+					return nl == std::string::npos ? text.size() : nl + 1;
+				};
+
+				std::size_t from = lineStart(text.size() * t / cfg.threads);
+				std::size_t to = lineStart(text.size() * (t + 1) / cfg.threads);
+
+				std::vector<Eval::Feature> features;
+
+				while (from < to) {
+
+					std::size_t nl = text.find('\n', from);
+					if (nl == std::string::npos || nl > to) nl = to;
+
+					std::string line = text.substr(from, nl - from);
+					from = nl + 1;
+
+					float result = parseResult(line);
+					if (result < 0 || !Board::validFEN(line)) continue;
+
+					Board::loadFEN(line);
+					add(slices[t], result, features);
+
+				}
+
+			});
+		}
+
+		for (std::thread& w : workers) w.join();
+
+		return slices;
+
+	}
+
+	/**
+	 * .
+	 * Mean squared error of the predictions over all positions, and optionally its gradient. Each thread works on
+	 * its own slice and gradient.
+	 * \param slices
+	 * \param params
+	 * \param k sigmoid scale
+	 * \param gradient if not null, set to the gradient of the error by parameter
+	 * \return
+	 */
+	double error(const std::vector<Slice>& slices, const std::vector<float>& params, double k, std::vector<double>* gradient) {
+
+		std::vector<double> errors(slices.size(), 0);
+		std::vector<std::vector<double>> gradients(gradient ? slices.size() : 0, std::vector<double>(params.size(), 0));
+		std::vector<std::thread> workers;
+
+		const float scale = (float)(k * std::log(10.0) / 400);
+
+		for (std::size_t t = 0; t < slices.size(); t++) {
+			workers.emplace_back([&, t] {
+
+				const Slice& s = slices[t];
+				double sum{ 0 };
+
+				for (std::size_t i = 0; i < s.result.size(); i++) {
+
+					float score{ 0 };
+					for (std::uint32_t j = s.begin[i]; j < s.begin[i + 1]; j++) score += params[s.index[j]] * s.count[j];
+
+					float predicted = 1.0f / (1.0f + std::exp(-scale * score));
+					float diff = predicted - s.result[i];
+					sum += diff * diff;
+
+					if (gradient) {
+						float g = diff * predicted * (1.0f - predicted) * scale;
+						for (std::uint32_t j = s.begin[i]; j < s.begin[i + 1]; j++) gradients[t][s.index[j]] += g * s.count[j];
+					}
+
+				}
+
+				errors[t] = sum;
+
+			});
+		}
+
+		for (std::thread& w : workers) w.join();
+
+		std::size_t positions{ 0 };
+		for (const Slice& s : slices) positions += s.result.size();
+
+		double total{ 0 };
+		for (double e : errors) total += e;
+
+		if (gradient) {
+			gradient->assign(params.size(), 0);
+			for (const std::vector<double>& g : gradients) {
+				for (std::size_t i = 0; i < g.size(); i++) (*gradient)[i] += 2 * g[i] / positions;
+			}
+		}
+
+		return total / positions;
+
+	}
+
+	/**
+	 * .
+	 * Finds the sigmoid scale that fits the current parameters best, first in steps of 0.1 and then 0.01.
+	 * \param slices
+	 * \param params
+	 * \return
+	 */
+	double fitK(const std::vector<Slice>& slices, const std::vector<float>& params) {
+
+		double best{ 1.0 }, bestError{ error(slices, params, best, nullptr) };
+
+		for (double step : { 0.1, 0.01 }) {
+			double center = best;
+			for (int i = -10; i <= 10; i++) {
+				double k = center + i * step;
+				if (k <= 0) continue;
+				double e = error(slices, params, k, nullptr);
+				if (e < bestError) {
+					best = k;
+					bestError = e;
+				}
+			}
+		}
+
+		return best;
+
+	}
+
+	/**
+	 * .
+	 * Name of a parameter, like pst[2][35] or passedPawn[5].
+	 * \param i
+	 * \return
+	 */
+	std::string paramName(int i) {
+
+		if (i < Eval::pst) return "material[" + std::to_string(i - Eval::material) + "]";
+		if (i < Eval::mobility) return "pst[" + std::to_string((i - Eval::pst) / 64) + "][" + std::to_string((i - Eval::pst) % 64) + "]";
+		if (i < Eval::kingAttack) return "mobility[" + std::to_string(i - Eval::mobility) + "]";
+		if (i < Eval::pawnShield) return "kingAttack[" + std::to_string(i - Eval::kingAttack) + "]";
+		if (i < Eval::passedPawn) return "pawnShield";
+		if (i < Eval::bishopPair) return "passedPawn[" + std::to_string(i - Eval::passedPawn) + "]";
+		return "bishopPair";
+
+	}
+
+	void tune(const std::string& input) {
+
+		Config cfg;
+
+		std::istringstream reader{ input };
+		std::string name, token;
+
+		reader >> name >> cfg.file;
+
+		for (int positional = 0; reader >> token;) {
+
+			std::size_t eq = token.find('=');
+
+			if (eq == std::string::npos) {
+				if (positional == 0) cfg.epochs = std::atoi(token.c_str());
+				else if (positional == 1) cfg.threads = std::max(1, std::atoi(token.c_str()));
+				positional++;
+				continue;
+			}
+
+			std::string key = token.substr(0, eq);
+			std::string value = token.substr(eq + 1);
+
+			if (key == "rate") cfg.rate = std::atof(value.c_str());
+			else if (key == "k") cfg.k = std::atof(value.c_str());
+			else if (key == "out") cfg.out = value;
+			else std::cout << "info string unknown tune setting " << key << std::endl;
+
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto seconds = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+		std::vector<Slice> slices = load(cfg);
+
+		std::size_t positions{ 0 }, features{ 0 };
+		for (const Slice& s : slices) {
+			positions += s.result.size();
+			features += s.index.size();
+		}
+
+		if (positions == 0) {
+			std::cout << "info string no labeled positions in " << cfg.file << std::endl;
+			return;
+		}
+
+		std::cout << "info string tune " << positions << " positions, " << (double)features / positions << " features each, loaded in "
+			<< seconds() << " s" << std::endl;
+
+		std::vector<float> params(Eval::paramCount);
+		for (int i = 0; i < Eval::paramCount; i++) params[i] = (float)Eval::params[i];
+
+		if (cfg.k <= 0) cfg.k = fitK(slices, params);
+
+		std::cout << "info string tune k " << cfg.k << " error " << error(slices, params, cfg.k, nullptr) << std::endl;
+
+		/*
+		* Adam over full passes, on double copies of the parameters.
+		*/
+
+		const double beta1{ 0.9 }, beta2{ 0.999 }, epsilon{ 1e-8 };
+
+		std::vector<double> values(params.begin(), params.end());
+		std::vector<double> m(Eval::paramCount, 0), v(Eval::paramCount, 0), gradient;
+
+		for (int epoch = 1; epoch <= cfg.epochs; epoch++) {
+
+			double e = error(slices, params, cfg.k, &gradient);
+
+			for (int i = 0; i < Eval::paramCount; i++) {
+				m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+				v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+				double mHat = m[i] / (1 - std::pow(beta1, epoch));
+				double vHat = v[i] / (1 - std::pow(beta2, epoch));
+				values[i] -= cfg.rate * mHat / (std::sqrt(vHat) + epsilon);
+				params[i] = (float)values[i];
+			}
+
+			if (epoch % 50 == 0 || epoch == cfg.epochs) {
+				std::cout << "info string tune epoch " << epoch << " error " << e << " time " << seconds() << " s" << std::endl;
+			}
+
+		}
+
+		for (int i = 0; i < Eval::paramCount; i++) Eval::params[i] = (int)std::lround(values[i]);
+		Eval::clearCache();
+
+		std::ofstream out{ cfg.out };
+		for (int i = 0; i < Eval::paramCount; i++) out << paramName(i) << ' ' << Eval::params[i] << '\n';
+
+		std::cout << "info string tune final error " << error(slices, params, cfg.k, nullptr) << ", parameters written to " << cfg.out << std::endl;
+
+	}
+
+}
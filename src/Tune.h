@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+namespace Tune {
+
+	extern void tune(const std::string& input);
+
+}
@@ -1,7 +1,29 @@
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "UCI.h"
+#include "Batch.h"
+#include "Bench.h"
+#include "Bitbase.h"
 #include "Board.h"
+#include "Cluster.h"
+#include "EPD.h"
+#include "Match.h"
+#include "Magic.h"
+#include "Mate.h"
+#include "Move.h"
+#include "Numa.h"
+#include "PGN.h"
+#include "Profile.h"
+#include "Search.h"
+#include "Serve.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "TT.h"
+#include "Tune.h"
 
 namespace UCI {
 
@@ -10,6 +32,11 @@ namespace UCI {
 	void getUCINewGame();
 	void getPosition(std::string input);
 	void getGo(std::string input);
+	void getBenchEPD(std::string input);
+	void getHash(std::string input);
+
+	//File used by the SaveHash and LoadHash options
+	std::string hashFile{ "gorilla.hash" };
 
 	/**
 	 * .
@@ -17,59 +44,177 @@ namespace UCI {
 	 */
 	void UCI() {
 
-		while (true) {
+		/*
+		* Reading a line from the UI. Done through simple input & output
+		*/
 
-			/*
-			* Reading a line from the UI. Done through simple input & output
-			*/
+		std::string ln;
 
-			std::string ln;
-			std::getline(std::cin, ln);
+		while (std::getline(std::cin, ln)) {
 
-			/*
-			* Sets the engine to UCI mode. Move this to the main function later.
-			*/
-			if (ln == "uci") {
-				getUCI();
-			}
+			if (!command(ln)) break;
 
-			/*
-			* Sets options of the engine
-			*/
-			else if (ln.find("setoption") != std::string::npos) {
-				getSetOption(ln);
-			}
+		}
 
-			/*
-			* Starts a new game. Resets representation of board.
-			*/
-			else if (ln == "ucinewgame") {
-				getUCINewGame();
-			}
+	}
 
-			/*
-			* Changes the position of the board.
-			*/
-			else if (ln.find("position") != std::string::npos) {
-				getPosition(ln);
-			}
+	/**
+	 * .
+	 * Runs a single command, either from the UI or from the command line. Returns false on quit.
+	 * \param ln
+	 * \return
+	 */
+	bool command(std::string ln) {
 
-			/*
-			* Prompts engine for a move.
-			*/
-			else if (ln.find("go") != std::string::npos) {
-				getGo(ln);
-			}
+		if (ln == "quit") {
+			return false;
+		}
 
-			/*
-			* Helper command from user to help debug engine
-			*/
-			else if (ln == "print") {
-				Board::printBoard(); 
-			}
+		/*
+		* Sets the engine to UCI mode. Move this to the main function later.
+		*/
+		else if (ln == "uci") {
+			getUCI();
+		}
+
+		/*
+		* Sets options of the engine
+		*/
+		else if (ln.find("setoption") != std::string::npos) {
+			getSetOption(ln);
+		}
+
+		/*
+		* Starts a new game. Resets representation of board.
+		*/
+		else if (ln == "ucinewgame") {
+			getUCINewGame();
+		}
+
+		/*
+		* Runs an EPD test suite on several threads.
+		*/
+		else if (ln.rfind("bench-epd", 0) == 0) {
+			getBenchEPD(ln);
+		}
+
+		/*
+		* Searches the built-in bench positions: bench [hash] [threads] [depth].
+		*/
+		else if (ln == "bench" || ln.rfind("bench ", 0) == 0) {
+			Bench::bench(ln);
+		}
+
+		/*
+		* Checks batch move generation against the per-position generator: batchcheck [plies].
+		*/
+		else if (ln.rfind("batchcheck", 0) == 0) {
+			Batch::check(ln);
+		}
+
+		/*
+		* Plays games between two configurations of the engine.
+		*/
+		else if (ln.rfind("match", 0) == 0) {
+			Match::match(ln);
+		}
+
+		/*
+		* Runs as a cluster worker, or starts local workers: cluster worker <address> [threads] [hash],
+		* cluster spawn <n> [threads] [hash].
+		*/
+		else if (ln.rfind("cluster", 0) == 0) {
+			Cluster::command(ln);
+		}
+
+		/*
+		* Extracts the positions of a PGN file: pgn <file> <out> [threads] [filters].
+		*/
+		else if (ln.rfind("pgn", 0) == 0) {
+			PGN::convert(ln);
+		}
+
+		/*
+		* Builds the endgame bitbases: bitbase generate [dir] [threads].
+		*/
+		else if (ln.rfind("bitbase", 0) == 0) {
+			Bitbase::generate(ln);
+		}
+
+		/*
+		* Tunes the evaluation parameters on labeled positions.
+		*/
+		else if (ln.rfind("tune", 0) == 0) {
+			Tune::tune(ln);
+		}
 
+		/*
+		* Leaves UCI for the batch analysis server: JSON requests in, JSON results out.
+		*/
+		else if (ln.rfind("serve", 0) == 0) {
+			Serve::serve(ln);
 		}
 
+		/*
+		* Runs phases of the engine under the hardware performance counters.
+		*/
+		else if (ln.rfind("profile", 0) == 0) {
+			Profile::profile(ln);
+		}
+
+		/*
+		* Saves or loads the transposition table: hash save <file>, hash load <file>.
+		*/
+		else if (ln.rfind("hash ", 0) == 0) {
+			getHash(ln);
+		}
+
+		/*
+		* Prints the search counters, or clears them with "stats reset". Only counts in GORILLA_STATS builds.
+		*/
+		else if (ln == "stats") {
+			Stats::print();
+		}
+
+		else if (ln == "stats reset") {
+			Stats::reset();
+		}
+
+		/*
+		* Records the search into per-thread ring buffers: trace on [events], trace off, trace clear,
+		* trace dump <file>. Only records in GORILLA_TRACE builds.
+		*/
+		else if (ln.rfind("trace", 0) == 0) {
+			Trace::command(ln);
+		}
+
+		else if (ln == "isready") {
+			std::cout << "readyok" << std::endl;
+		}
+
+		/*
+		* Changes the position of the board.
+		*/
+		else if (ln.find("position") != std::string::npos) {
+			getPosition(ln);
+		}
+
+		/*
+		* Prompts engine for a move.
+		*/
+		else if (ln.find("go") != std::string::npos) {
+			getGo(ln);
+		}
+
+		/*
+		* Helper command from user to help debug engine
+		*/
+		else if (ln == "print") {
+			Board::printBoard(); 
+		}
+
+		return true;
+
 	}
 
 	/**
@@ -80,18 +225,72 @@ namespace UCI {
 		
 		std::cout << "id name GorillaChess\n";
 		std::cout << "id author TheGameMonkey\n";
-		std::cout << "uciok\n";
+		Search::printOptions();
+		std::cout << "option name HashFile type string default gorilla.hash\n";
+		std::cout << "option name SaveHash type button\n";
+		std::cout << "option name LoadHash type button\n";
+		std::cout << "option name BitbasePath type string default bitbases\n";
+		std::cout << "option name ClusterWorkers type string default <empty>\n";
+
+		/*
+		* Allocates the hash now so the pages it got can be reported.
+		*/
+		if (TT::table.megabytes() != (std::size_t)Search::options.hash) TT::table.resize(Search::options.hash);
+		std::cout << "info string Hash " << TT::table.megabytes() << " MB on " << TT::table.pages() << '\n';
+		std::cout << "info string Magic tables " << Magic::pages() << '\n';
+		std::cout << "info string NUMA " << Numa::describe() << '\n';
+		std::cout << "info string Bitbases " << Bitbase::describe() << '\n';
+
+		std::cout << "uciok" << std::endl;
 
 	}
 
 	/**
 	 * .
-	 * Sets up the options of the engine. Not implemented yet.
+	 * Sets up the options of the engine: setoption name <name> value <value>.
 	 * \param input
 	 */
 	void getSetOption(std::string input) {
 
+		std::size_t namePos = input.find("name ");
+		std::size_t valuePos = input.find(" value ");
+
+		if (namePos == std::string::npos) return;
+
+		std::string name = input.substr(namePos + 5, valuePos == std::string::npos ? std::string::npos : valuePos - namePos - 5);
+		std::string value = valuePos == std::string::npos ? "" : input.substr(valuePos + 7);
+
+		/*
+		* The hash file options are actions on the table rather than search settings.
+		*/
+
+		if (name == "HashFile") {
+			hashFile = value;
+			return;
+		}
+		if (name == "SaveHash" || name == "LoadHash") {
+			getHash(std::string("hash ") + (name == "SaveHash" ? "save " : "load ") + hashFile);
+			return;
+		}
+		if (name == "ClusterWorkers") {
+			Cluster::connect(value == "<empty>" ? "" : value);
+			return;
+		}
+		if (name == "BitbasePath") {
+			Bitbase::load(value);
+			std::cout << "info string Bitbases " << Bitbase::describe() << std::endl;
+			return;
+		}
 
+		if (!Search::setOption(Search::options, name, value)) {
+			std::cout << "info string unknown option " << name << std::endl;
+			return;
+		}
+
+		if (name == "Hash") {
+			TT::table.resize(Search::options.hash);
+			std::cout << "info string Hash " << TT::table.megabytes() << " MB on " << TT::table.pages() << std::endl;
+		}
 
 	}
 
@@ -100,26 +299,69 @@ namespace UCI {
 	 * Resets the representation of the board. Prepares for a new game.
 	 */
 	void getUCINewGame() {
-
+		Search::clear();
+		Cluster::clear();
 	}
 
+	/*
+	* The last position command: where it started (startpos or a FEN), the moves it played, and the hash it left.
+	* GUIs resend the whole game before every go, so when a command only adds moves to the last one and the board
+	* hasn't been changed by anything else since, just the new moves are played.
+	*/
+	std::string lastStart;
+	std::vector<std::string> lastMoves;
+	std::uint64_t lastHash{ 0 };
+
 	/**
 	 * .
-	 * Changes the position of the board's representation. Can provide moves, a FEN string, or set it to startpos.
+	 * Changes the position of the board's representation: position [startpos | fen <FEN>] [moves <move>...].
+	 * The moves are played with Board::play, so the search sees the game's positions for repetitions.
+	 * \param input
 	 */
 	void getPosition(std::string input) {
-		
-		if (input.find("startpos") != std::string::npos) {
-			Board::loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-		}
 
-		else if (input.find("fen") != std::string::npos) {
-			Board::loadFEN(input.substr(13));
+		std::istringstream reader{ input };
+		std::string token, start;
+		std::vector<std::string> moves;
+
+		reader >> token;
+
+		while (reader >> token && token != "moves") {
+			if (token == "startpos") start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+			else if (token != "fen") start += (start.empty() ? "" : " ") + token;
 		}
-		else if (input.find("moves") != std::string::npos) {
-			//make moves
+
+		while (reader >> token) moves.push_back(token);
+
+		if (start.empty()) return;
+
+		std::size_t played{ 0 };
+
+		bool extends = start == lastStart && Board::hash == lastHash && moves.size() >= lastMoves.size()
+			&& std::equal(lastMoves.begin(), lastMoves.end(), moves.begin());
+
+		if (extends) played = lastMoves.size();
+		else Board::loadFEN(start);
+
+		for (; played < moves.size(); played++) {
+
+			std::uint16_t move = Move::fromUCI(moves[played]);
+
+			if (!move) {
+				std::cout << "info string illegal move " << moves[played] << std::endl;
+				break;
+			}
+
+			Board::play(move);
+
 		}
 
+		moves.resize(played);
+
+		lastStart = start;
+		lastMoves = std::move(moves);
+		lastHash = Board::hash;
+
 	}
 
 	/**
@@ -128,7 +370,120 @@ namespace UCI {
 	 * \param input
 	 */
 	void getGo(std::string input) {
-		//get best move
+
+		Search::Limits limits;
+
+		int wtime{ 0 }, btime{ 0 }, winc{ 0 }, binc{ 0 }, movestogo{ 0 };
+
+		std::istringstream reader{ input };
+		std::string token;
+
+		while (reader >> token) {
+			if (token == "depth") reader >> limits.depth;
+			else if (token == "nodes") reader >> limits.nodes;
+			else if (token == "movetime") reader >> limits.movetime;
+			else if (token == "mate") reader >> limits.mate;
+			else if (token == "wtime") reader >> wtime;
+			else if (token == "btime") reader >> btime;
+			else if (token == "winc") reader >> winc;
+			else if (token == "binc") reader >> binc;
+			else if (token == "movestogo") reader >> movestogo;
+		}
+
+		/*
+		* With a clock, spend an even share of the remaining time plus most of the increment.
+		*/
+
+		int time = Board::whiteTurn ? wtime : btime;
+		int inc = Board::whiteTurn ? winc : binc;
+
+		if (time && !limits.movetime) {
+			limits.movetime = time / (movestogo ? movestogo + 1 : 30) + inc * 3 / 4;
+			if (limits.movetime > time - 50) limits.movetime = time > 100 ? time - 50 : time / 2;
+			if (limits.movetime < 1) limits.movetime = 1;
+		}
+
+		Stats::reset();
+
+		/*
+		* go mate N asks the mate solver first. If it finds nothing, a normal search as deep as the mate would be
+		* still picks a move in the time that's left.
+		*/
+
+		Search::Result result;
+
+		if (limits.mate > 0) result = Mate::solve(limits, true);
+
+		if (!result.bestMove) {
+			if (limits.mate > 0) {
+				limits.depth = std::min(limits.depth, 2 * limits.mate);
+				if (limits.movetime) limits.movetime = std::max(1, limits.movetime - (int)result.time);
+			}
+			result = Cluster::active() ? Cluster::search(limits, true) : Search::search(limits, true);
+		}
+
+		if (Stats::enabled) Stats::print();
+
+		std::cout << "bestmove " << (result.bestMove ? Move::toUCI(result.bestMove) : "0000") << std::endl;
+
+	}
+
+	/**
+	 * .
+	 * Runs an EPD suite: bench-epd <file> <nodes|movetime> <threads>. The limit is a node count, or a time per
+	 * position ending in ms (e.g. 500ms).
+	 * \param input
+	 */
+	void getBenchEPD(std::string input) {
+
+		std::istringstream reader{ input };
+		std::string name, file, limit{ "100000" };
+		int threads{ 1 };
+
+		reader >> name >> file >> limit >> threads;
+
+		if (file.empty()) {
+			std::cout << "usage: bench-epd <file> <nodes|movetime ms> <threads>" << std::endl;
+			return;
+		}
+
+		EPD::bench(file, limit, threads);
+
+	}
+
+	/**
+	 * .
+	 * Saves the transposition table to a file, or loads one saved before. A loaded table keeps the size it was
+	 * saved with, and the Hash option follows it so the next search doesn't throw it away.
+	 * \param input
+	 */
+	void getHash(std::string input) {
+
+		std::istringstream reader{ input };
+		std::string name, action, file;
+
+		reader >> name >> action;
+		std::getline(reader >> std::ws, file);
+
+		if ((action != "save" && action != "load") || file.empty()) {
+			std::cout << "usage: hash save <file> | hash load <file>" << std::endl;
+			return;
+		}
+
+		if (action == "save") {
+			bool ok = TT::table.save(file);
+			std::cout << "info string " << (ok ? "saved hash to " : "cannot save hash to ") << file << std::endl;
+			return;
+		}
+
+		if (!TT::table.load(file)) {
+			std::cout << "info string cannot load hash from " << file << std::endl;
+			return;
+		}
+
+		Search::options.hash = (int)TT::table.megabytes();
+		std::cout << "info string loaded " << TT::table.megabytes() << " MB hash from " << file << std::endl;
+
 	}
 
 }
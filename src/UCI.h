@@ -1,7 +1,11 @@
 #pragma once
 
+#include <string>
+
 namespace UCI {
 
 	extern void UCI();
 
+	extern bool command(std::string ln);
+
 }
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Magic.h"
+
+/*
+Offline search for the magic numbers behind the slider attack table (see Magic.cpp). Writes MagicNumbers.h, which
+the engine is built with, so nothing is searched at startup.
+
+For every rook and bishop square the finder looks for a sparse 64-bit magic (the AND of three random numbers) that
+maps every subset of the square's blocker mask to a slot without two different attack sets colliding. It starts
+with as many index bits as the mask has, then tries one bit fewer, and among the magics that work keeps the one
+whose highest used slot is lowest, so the square's table can be cut short. Squares are searched in parallel.
+
+The tables of all 128 squares are then packed into one array, each placed at the lowest offset where it only lands
+on free slots or on slots holding the same attack set. Every entry is checked against the reference move
+generation (rookBlockerToMove, bishopBlockerToMove) before the header is written.
+
+Usage: gorilla-magics [--threads N] [--seed N] [--tries N] [--out file]
+
+--tries is the number of candidates tried per square for each of the reduced searches; more finds smaller tables.
+*/
+
+namespace MagicFinder {
+
+	struct Settings {
+		int threads{ (int)std::max(1u, std::thread::hardware_concurrency()) };
+		std::uint64_t seed{ 1 };
+		std::uint64_t tries{ 200000 };
+		std::string out{ "src/MagicNumbers.h" };
+	};
+
+	/*
+	* One square of one slider, with every subset of its blocker mask and the attacks for each.
+	*/
+	struct Square {
+		bool rook{ false };
+		int sq{ 0 };
+		std::uint64_t mask{ 0 };
+		std::vector<std::uint64_t> blockers;
+		std::vector<std::uint64_t> attacks;
+
+		std::uint64_t magic{ 0 };
+		int bits{ 0 };
+		std::uint32_t span{ 0 };
+		std::uint32_t offset{ 0 };
+	};
+
+	/*
+	* xorshift64*, one per thread.
+	*/
+	struct Random {
+
+		std::uint64_t state;
+
+		std::uint64_t next() {
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return state * 0x2545F4914F6CDD1DULL;
+		}
+
+		std::uint64_t sparse() {
+			return next() & next() & next();
+		}
+
+	};
+
+	/**
+	 * .
+	 * Checks if a magic works for a square with the given number of index bits. Returns one past the highest slot
+	 * it uses, or 0 if two different attack sets collide.
+	 * \param s
+	 * \param magic
+	 * \param bits
+	 * \param table scratch space of at least 2^bits entries
+	 * \param stamp scratch space of the same size, marking the slots used in this try
+	 * \param epoch
+	 * \return
+	 */
+	std::uint32_t tryMagic(const Square& s, std::uint64_t magic, int bits, std::vector<std::uint64_t>& table, std::vector<std::uint32_t>& stamp, std::uint32_t epoch) {
+
+		//Magics that leave the top byte of the product nearly empty never spread the subsets well
+		if (std::popcount((s.mask * magic) & 0xFF00000000000000ULL) < 6) return 0;
+
+		std::uint32_t span{ 0 };
+
+		for (std::size_t i = 0; i < s.blockers.size(); i++) {
+
+			std::uint32_t slot = (std::uint32_t)((s.blockers[i] * magic) >> (64 - bits));
+
+			if (stamp[slot] != epoch) {
+				stamp[slot] = epoch;
+				table[slot] = s.attacks[i];
+			}
+			else if (table[slot] != s.attacks[i]) return 0;
+
+			span = std::max(span, slot + 1);
+
+		}
+
+		return span;
+
+	}
+
+	/**
+	 * .
+	 * Finds a magic for a square: first any that works with the full number of bits, then as short a table as the
+	 * tries allow, with one bit fewer if possible.
+	 * \param s
+	 * \param rng
+	 * \param tries
+	 */
+	void search(Square& s, Random& rng, std::uint64_t tries) {
+
+		int full = std::popcount(s.mask);
+
+		std::vector<std::uint64_t> table(std::size_t{ 1 } << full);
+		std::vector<std::uint32_t> stamp(table.size(), 0);
+		std::uint32_t epoch{ 0 };
+
+		while (!s.magic) {
+			std::uint64_t magic = rng.sparse();
+			std::uint32_t span = tryMagic(s, magic, full, table, stamp, ++epoch);
+			if (span) {
+				s.magic = magic;
+				s.bits = full;
+				s.span = span;
+			}
+		}
+
+		for (int bits : { full - 1, full }) {
+			for (std::uint64_t t = 0; t < tries; t++) {
+				std::uint64_t magic = rng.sparse();
+				std::uint32_t span = tryMagic(s, magic, bits, table, stamp, ++epoch);
+				if (span && span < s.span) {
+					s.magic = magic;
+					s.bits = bits;
+					s.span = span;
+				}
+			}
+		}
+
+	}
+
+	/**
+	 * .
+	 * Slot of a subset of a square's blocker mask in the packed table.
+	 * \param s
+	 * \param blockers
+	 * \return
+	 */
+	std::uint32_t slot(const Square& s, std::uint64_t blockers) {
+		return s.offset + (std::uint32_t)((blockers * s.magic) >> (64 - s.bits));
+	}
+
+	/**
+	 * .
+	 * Places every square's table in one array, biggest first, each at the lowest offset where it fits. No attack
+	 * set is ever empty, so 0 marks a free slot.
+	 * \param squares
+	 * \return the packed table
+	 */
+	std::vector<std::uint64_t> pack(std::vector<Square>& squares) {
+
+		std::vector<Square*> order;
+		for (Square& s : squares) order.push_back(&s);
+		std::stable_sort(order.begin(), order.end(), [](const Square* a, const Square* b) { return a->span > b->span; });
+
+		std::vector<std::uint64_t> table;
+
+		for (Square* s : order) {
+
+			for (std::uint32_t offset = 0;; offset++) {
+
+				s->offset = offset;
+
+				bool fits{ true };
+				for (std::size_t i = 0; i < s->blockers.size() && fits; i++) {
+					std::uint32_t at = slot(*s, s->blockers[i]);
+					if (at < table.size() && table[at] && table[at] != s->attacks[i]) fits = false;
+				}
+
+				if (fits) break;
+
+			}
+
+			if (table.size() < s->offset + s->span) table.resize(s->offset + s->span, 0);
+
+			for (std::size_t i = 0; i < s->blockers.size(); i++) table[slot(*s, s->blockers[i])] = s->attacks[i];
+
+		}
+
+		return table;
+
+	}
+
+	/**
+	 * .
+	 * Checks every entry of the packed table against the reference move generation.
+	 * \param squares
+	 * \param table
+	 * \return
+	 */
+	bool verify(const std::vector<Square>& squares, const std::vector<std::uint64_t>& table) {
+
+		for (const Square& s : squares) {
+			std::uint64_t sub{ 0 };
+			do {
+				std::uint64_t expected = s.rook ? Magic::rookBlockerToMove(s.sq, sub) : Magic::bishopBlockerToMove(s.sq, sub);
+				if (table[slot(s, sub)] != expected) {
+					std::cout << (s.rook ? "rook" : "bishop") << " square " << s.sq << " is wrong for blockers " << sub << std::endl;
+					return false;
+				}
+				sub = (sub - s.mask) & s.mask;
+			} while (sub);
+		}
+
+		return true;
+
+	}
+
+	void writeArray(std::ostream& os, const std::string& type, const std::string& name, const std::vector<std::string>& values) {
+
+		os << "\tinline constexpr " << type << ' ' << name << "[64] = {";
+
+		for (std::size_t i = 0; i < values.size(); i++) os << (i % 4 ? " " : "\n\t\t") << values[i] << (i + 1 < values.size() ? "," : "");
+
+		os << "\n\t};\n\n";
+
+	}
+
+	void writeHeader(std::ostream& os, const std::vector<Square>& squares, std::size_t tableSize, const Settings& settings) {
+
+		os << "#pragma once\n\n#include <cstdint>\n\n";
+		os << "/*\nGenerated by gorilla-magics (tools/MagicFinder.cpp) with --seed " << settings.seed << " --tries " << settings.tries << ". Don't edit by hand;\n";
+		os << "rerun it from the repository root instead. Each square's attacks are at\n";
+		os << "offset + ((occupancy & mask) * magic >> shift) in one table of tableSize entries shared by rooks and bishops.\n*/\n\n";
+		os << "namespace Magic {\n\n";
+		os << "\tinline constexpr std::uint32_t tableSize{ " << tableSize << " };\n\n";
+
+		for (bool rook : { true, false }) {
+
+			std::vector<std::string> magics, shifts, offsets;
+
+			for (const Square& s : squares) {
+				if (s.rook != rook) continue;
+				std::ostringstream m;
+				m << "0x" << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << s.magic << "ULL";
+				magics.push_back(m.str());
+				shifts.push_back(std::to_string(64 - s.bits));
+				offsets.push_back(std::to_string(s.offset));
+			}
+
+			std::string piece = rook ? "rook" : "bishop";
+			writeArray(os, "std::uint64_t", piece + "Magics", magics);
+			writeArray(os, "std::uint8_t", piece + "Shifts", shifts);
+			writeArray(os, "std::uint32_t", piece + "Offsets", offsets);
+
+		}
+
+		os << "}\n";
+
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+
+	using namespace MagicFinder;
+
+	Settings settings;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg{ argv[i] };
+		if (arg == "--threads" && i + 1 < argc) settings.threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--seed" && i + 1 < argc) settings.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--tries" && i + 1 < argc) settings.tries = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--out" && i + 1 < argc) settings.out = argv[++i];
+		else {
+			std::cout << "usage: gorilla-magics [--threads N] [--seed N] [--tries N] [--out file]" << std::endl;
+			return 1;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<Square> squares(128);
+
+	for (int i = 0; i < 128; i++) {
+
+		Square& s = squares[i];
+		s.rook = i < 64;
+		s.sq = i % 64;
+		s.mask = s.rook ? Magic::blockerMaskRook(s.sq) : Magic::blockerMaskBishop(s.sq);
+
+		std::uint64_t sub{ 0 };
+		do {
+			s.blockers.push_back(sub);
+			s.attacks.push_back(s.rook ? Magic::rookBlockerToMove(s.sq, sub) : Magic::bishopBlockerToMove(s.sq, sub));
+			sub = (sub - s.mask) & s.mask;
+		} while (sub);
+
+	}
+
+	/*
+	* Threads take squares from a shared counter. Every square has its own seed, so the result doesn't depend on
+	* the number of threads.
+	*/
+
+	std::atomic<int> next{ 0 };
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < settings.threads; t++) {
+		workers.emplace_back([&] {
+			for (int i = next++; i < 128; i = next++) {
+				Random rng{ (settings.seed * 0x9E3779B97F4A7C15ULL) ^ (0xD1B54A32D192ED03ULL * (i + 1)) };
+				search(squares[i], rng, settings.tries);
+			}
+		});
+	}
+
+	for (std::thread& t : workers) t.join();
+
+	std::vector<std::uint64_t> table = pack(squares);
+
+	std::size_t plain{ 0 }, reduced{ 0 };
+	for (const Square& s : squares) {
+		plain += std::size_t{ 1 } << std::popcount(s.mask);
+		if (s.bits < std::popcount(s.mask)) reduced++;
+	}
+
+	if (!verify(squares, table)) return 1;
+
+	std::ofstream out{ settings.out };
+	if (!out) {
+		std::cout << "cannot write " << settings.out << std::endl;
+		return 1;
+	}
+
+	writeHeader(out, squares, table.size(), settings);
+
+	std::size_t used = table.size() - std::count(table.begin(), table.end(), 0ULL);
+
+	std::cout << "table " << table.size() << " entries (" << table.size() * 8 / 1024 << " KB, " << used << " used), plain fancy magics need " << plain
+		<< " (" << plain * 8 / 1024 << " KB); " << reduced << " squares with a reduced shift; "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s; wrote " << settings.out << std::endl;
+
+	return 0;
+
+}
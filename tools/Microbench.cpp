@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Attack.h"
+#include "Batch.h"
+#include "Bench.h"
+#include "Board.h"
+#include "Magic.h"
+#include "Move.h"
+
+/*
+Microbenchmarks of the engine's hot paths: the Magic slider lookups, pseudo-legal move generation, FEN parsing and
+table initialization. Each benchmark runs its body over a corpus of positions (the bench positions, or a file of
+FENs) a few times to warm up, then times a number of repetitions and reports the mean, median, spread and
+coefficient of variation in nanoseconds per operation.
+
+Usage: gorilla-microbench [--reps N] [--warmup N] [--filter text] [--fens file] [--json [file]]
+
+With --json the results are written as one JSON document (to stdout or a file), so runs from two commits can be
+diffed or compared by a script.
+*/
+
+namespace Microbench {
+
+	/*
+	* The timings of one benchmark. Every sample is the nanoseconds per operation of one repetition.
+	*/
+	struct Result {
+		std::string name;
+		std::uint64_t opsPerRep{ 0 };
+		std::vector<double> samples;
+		double mean{ 0 }, median{ 0 }, stddev{ 0 }, min{ 0 }, max{ 0 };
+	};
+
+	struct Settings {
+		int reps{ 15 };
+		int warmup{ 3 };
+		std::string filter;
+		std::string fens;
+		bool json{ false };
+		std::string jsonFile;
+	};
+
+	//Results are xored in here so the compiler can't drop the work being timed
+	volatile std::uint64_t sink;
+
+	//Times each repetition goes over the corpus, so a repetition lasts long enough to time reliably
+	constexpr int passes{ 20 };
+
+	//The straight and diagonal sliders of the side to move
+
+	std::uint64_t rooks(const Board::State& s) {
+		return s.whiteTurn ? s.WR | s.WQ : s.BR | s.BQ;
+	}
+
+	std::uint64_t bishops(const Board::State& s) {
+		return s.whiteTurn ? s.WB | s.WQ : s.BB | s.BQ;
+	}
+
+	/**
+	 * .
+	 * Fills in the statistics of a result from its samples.
+	 * \param r
+	 */
+	void summarize(Result& r) {
+
+		std::vector<double> sorted = r.samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum{ 0 };
+		for (double s : sorted) sum += s;
+
+		r.mean = sum / sorted.size();
+		r.median = sorted.size() % 2 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+		r.min = sorted.front();
+		r.max = sorted.back();
+
+		double var{ 0 };
+		for (double s : sorted) var += (s - r.mean) * (s - r.mean);
+		r.stddev = sorted.size() > 1 ? std::sqrt(var / (sorted.size() - 1)) : 0;
+
+	}
+
+	/**
+	 * .
+	 * Times a benchmark. body does opsPerRep operations and returns a value to sink.
+	 * \param name
+	 * \param opsPerRep
+	 * \param body
+	 * \param settings
+	 * \return
+	 */
+	Result run(const std::string& name, std::uint64_t opsPerRep, const std::function<std::uint64_t()>& body, const Settings& settings) {
+
+		Result r;
+		r.name = name;
+		r.opsPerRep = opsPerRep;
+
+		for (int i = 0; i < settings.warmup; i++) sink = sink ^ body();
+
+		for (int i = 0; i < settings.reps; i++) {
+			auto start = std::chrono::steady_clock::now();
+			std::uint64_t v = body();
+			auto end = std::chrono::steady_clock::now();
+			sink = sink ^ v;
+			r.samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / opsPerRep);
+		}
+
+		summarize(r);
+
+		return r;
+
+	}
+
+	void printText(const std::vector<Result>& results) {
+
+		std::cout << std::left << std::setw(22) << "benchmark" << std::right
+			<< std::setw(12) << "ns/op" << std::setw(12) << "median" << std::setw(12) << "stddev"
+			<< std::setw(12) << "min" << std::setw(12) << "max" << std::setw(8) << "cv%" << std::setw(12) << "ops/rep" << '\n';
+
+		std::cout << std::fixed << std::setprecision(2);
+
+		for (const Result& r : results) {
+			std::cout << std::left << std::setw(22) << r.name << std::right
+				<< std::setw(12) << r.mean << std::setw(12) << r.median << std::setw(12) << r.stddev
+				<< std::setw(12) << r.min << std::setw(12) << r.max << std::setw(8) << (r.mean > 0 ? 100 * r.stddev / r.mean : 0)
+				<< std::setw(12) << r.opsPerRep << '\n';
+		}
+
+		std::cout.flush();
+
+	}
+
+	void printJSON(const std::vector<Result>& results, const Settings& settings, std::ostream& os) {
+
+		os << std::setprecision(6) << "{\n";
+		os << "  \"reps\": " << settings.reps << ",\n";
+		os << "  \"warmup\": " << settings.warmup << ",\n";
+		os << "  \"benchmarks\": [\n";
+
+		for (std::size_t i = 0; i < results.size(); i++) {
+
+			const Result& r = results[i];
+
+			os << "    { \"name\": \"" << r.name << "\", \"ops_per_rep\": " << r.opsPerRep
+				<< ", \"ns_per_op\": " << r.mean << ", \"median\": " << r.median << ", \"stddev\": " << r.stddev
+				<< ", \"min\": " << r.min << ", \"max\": " << r.max << ", \"samples\": [";
+
+			for (std::size_t j = 0; j < r.samples.size(); j++) os << (j ? ", " : "") << r.samples[j];
+
+			os << "] }" << (i + 1 < results.size() ? "," : "") << '\n';
+
+		}
+
+		os << "  ]\n}" << std::endl;
+
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+
+	using namespace Microbench;
+
+	Settings settings;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg{ argv[i] };
+		if (arg == "--reps" && i + 1 < argc) settings.reps = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--warmup" && i + 1 < argc) settings.warmup = std::max(0, std::atoi(argv[++i]));
+		else if (arg == "--filter" && i + 1 < argc) settings.filter = argv[++i];
+		else if (arg == "--fens" && i + 1 < argc) settings.fens = argv[++i];
+		else if (arg == "--json") {
+			settings.json = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') settings.jsonFile = argv[++i];
+		}
+		else {
+			std::cout << "usage: gorilla-microbench [--reps N] [--warmup N] [--filter text] [--fens file] [--json [file]]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+
+	auto wanted = [&](const std::string& name) { return settings.filter.empty() || name.find(settings.filter) != std::string::npos; };
+
+	/*
+	* The first initialization is timed on its own, since only that one starts from empty tables.
+	*/
+
+	auto coldStart = std::chrono::steady_clock::now();
+	Magic::initialize();
+	double cold = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - coldStart).count();
+
+	if (wanted("initialize")) {
+		Result r;
+		r.name = "initialize_cold";
+		r.opsPerRep = 1;
+		r.samples.push_back(cold);
+		summarize(r);
+		results.push_back(r);
+	}
+
+	std::vector<std::string> corpus;
+
+	if (!settings.fens.empty()) {
+		std::ifstream in{ settings.fens };
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty()) corpus.push_back(line);
+		}
+		if (corpus.empty()) {
+			std::cout << "no positions in " << settings.fens << std::endl;
+			return 1;
+		}
+	}
+	else {
+		for (int i = 0; i < Bench::positionCount; i++) corpus.push_back(Bench::positions[i]);
+	}
+
+	std::vector<Board::State> states;
+	std::vector<std::uint64_t> occupancies;
+
+	for (const std::string& fen : corpus) {
+		Board::loadFEN(fen);
+		states.push_back(Board::save());
+		occupancies.push_back(Board::WP | Board::WN | Board::WB | Board::WR | Board::WQ | Board::WK
+			| Board::BP | Board::BN | Board::BB | Board::BR | Board::BQ | Board::BK);
+	}
+
+	/*
+	* Slider lookups: every square of every corpus position.
+	*/
+
+	if (wanted("magic_rook")) {
+		results.push_back(run("magic_rook", occupancies.size() * 64 * passes, [&]() {
+			std::uint64_t acc{ 0 };
+			for (int pass = 0; pass < passes; pass++) {
+				for (std::uint64_t occ : occupancies) {
+					for (int sq = 0; sq < 64; sq++) acc ^= Magic::getRookMove(sq, occ);
+				}
+			}
+			return acc;
+		}, settings));
+	}
+
+	if (wanted("magic_bishop")) {
+		results.push_back(run("magic_bishop", occupancies.size() * 64 * passes, [&]() {
+			std::uint64_t acc{ 0 };
+			for (int pass = 0; pass < passes; pass++) {
+				for (std::uint64_t occ : occupancies) {
+					for (int sq = 0; sq < 64; sq++) acc ^= Magic::getBishopMove(sq, occ);
+				}
+			}
+			return acc;
+		}, settings));
+	}
+
+	/*
+	* Everything the sliders of the side to move attack, with a Magic lookup per piece and with occluded fills.
+	*/
+
+	auto sliders = [&](std::uint64_t(*attacks)(const Board::State&, std::uint64_t)) {
+		std::uint64_t acc{ 0 };
+		for (int pass = 0; pass < passes; pass++) {
+			for (std::size_t i = 0; i < states.size(); i++) acc ^= attacks(states[i], occupancies[i]);
+		}
+		return acc;
+	};
+
+	if (wanted("sliders_magic")) {
+		results.push_back(run("sliders_magic", states.size() * passes, [&]() {
+			return sliders([](const Board::State& s, std::uint64_t occ) {
+				std::uint64_t a{ 0 };
+				for (std::uint64_t b = rooks(s); b; b &= b - 1) a |= Magic::getRookMove(std::countr_zero(b), occ);
+				for (std::uint64_t b = bishops(s); b; b &= b - 1) a |= Magic::getBishopMove(std::countr_zero(b), occ);
+				return a;
+			});
+		}, settings));
+	}
+
+	if (wanted("sliders_fill")) {
+		results.push_back(run("sliders_fill", states.size() * passes, [&]() {
+			return sliders([](const Board::State& s, std::uint64_t occ) { return Attack::slidingAttacksScalar(rooks(s), bishops(s), occ); });
+		}, settings));
+	}
+
+	if (Attack::avx2 && wanted("sliders_fill_avx2")) {
+		results.push_back(run("sliders_fill_avx2", states.size() * passes, [&]() {
+			return sliders([](const Board::State& s, std::uint64_t occ) { std::uint64_t a; Attack::slidingAttacksAVX2(rooks(s), bishops(s), occ, a); return a; });
+		}, settings));
+	}
+
+	/*
+	* Pseudo-legal move generation for each color on every corpus position, whoever is to move.
+	*/
+
+	if (wanted("movegen_white")) {
+		results.push_back(run("movegen_white", states.size() * passes, [&]() {
+			std::uint64_t acc{ 0 };
+			for (int pass = 0; pass < passes; pass++) {
+				for (const Board::State& s : states) {
+					acc += Move::whiteMove(s.WP, s.WN, s.WB, s.WR, s.WQ, s.WK, s.BP, s.BN, s.BB, s.BR, s.BQ, s.BK, s.castlingRights, s.enPassant).size();
+				}
+			}
+			return acc;
+		}, settings));
+	}
+
+	if (wanted("movegen_black")) {
+		results.push_back(run("movegen_black", states.size() * passes, [&]() {
+			std::uint64_t acc{ 0 };
+			for (int pass = 0; pass < passes; pass++) {
+				for (const Board::State& s : states) {
+					acc += Move::blackMove(s.WP, s.WN, s.WB, s.WR, s.WQ, s.WK, s.BP, s.BN, s.BB, s.BR, s.BQ, s.BK, s.castlingRights, s.enPassant).size();
+				}
+			}
+			return acc;
+		}, settings));
+	}
+
+	/*
+	* The same move generation four positions at a time, with AVX2 if the CPU has it and with plain integers.
+	* Counted per position, so the numbers compare with movegen_white and movegen_black.
+	*/
+
+	std::vector<Batch::Lanes> lanes((states.size() + Batch::width - 1) / Batch::width, Batch::Lanes{});
+
+	for (std::size_t i = 0; i < states.size(); i++) Batch::load(lanes[i / Batch::width], i % Batch::width, states[i]);
+
+	auto batch = [&]() {
+		std::uint64_t acc{ 0 };
+		Batch::Targets targets;
+		for (int pass = 0; pass < passes; pass++) {
+			for (const Batch::Lanes& l : lanes) {
+				Batch::generate(l, targets);
+				acc += targets.count[0] + targets.count[1] + targets.count[2] + targets.count[3];
+			}
+		}
+		return acc;
+	};
+
+	bool avx2 = Batch::avx2;
+
+	if (avx2 && wanted("movegen_batch_avx2")) results.push_back(run("movegen_batch_avx2", lanes.size() * Batch::width * passes, batch, settings));
+
+	if (wanted("movegen_batch_scalar")) {
+		Batch::avx2 = false;
+		results.push_back(run("movegen_batch_scalar", lanes.size() * Batch::width * passes, batch, settings));
+		Batch::avx2 = avx2;
+	}
+
+	if (wanted("loadfen")) {
+		results.push_back(run("loadfen", corpus.size() * passes, [&]() {
+			std::uint64_t acc{ 0 };
+			for (int pass = 0; pass < passes; pass++) {
+				for (const std::string& fen : corpus) {
+					Board::loadFEN(fen);
+					acc ^= Board::hash;
+				}
+			}
+			return acc;
+		}, settings));
+	}
+
+	/*
+	* Rebuilding tables that already exist. Slower repetitions than the rest, so fewer of them.
+	*/
+
+	if (wanted("initialize")) {
+		Settings few = settings;
+		few.reps = std::max(1, settings.reps / 5);
+		few.warmup = 0;
+		results.push_back(run("initialize_warm", 1, []() {
+			Magic::initialize();
+			return std::uint64_t{ 0 };
+		}, few));
+	}
+
+	if (settings.json) {
+		if (settings.jsonFile.empty()) printJSON(results, settings, std::cout);
+		else {
+			std::ofstream out{ settings.jsonFile };
+			printJSON(results, settings, out);
+		}
+	}
+	else printText(results);
+
+	return 0;
+
+}
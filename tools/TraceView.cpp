@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Move.h"
+#include "Trace.h"
+
+/*
+Offline viewer for the dumps of the trace command (see Trace.h). Rebuilds each thread's search tree from its enter
+and leave events and summarizes it:
+
+- per iteration, the nodes searched, their ratio to the previous iteration (the effective branching factor of
+  iterative deepening), and the subtrees searched again within the iteration (same position, same depth);
+- per ply, full width and quiescence nodes, the average number of children searched, how often beta cutoffs came
+  from the first move and the average place of the cutoff move, and the table and null-move cutoffs;
+- the late cutoffs that wasted the most nodes, i.e. beta cutoffs where the moves searched before the one that cut
+  off had big subtrees, with the moves leading to the node.
+
+A ring that wrapped around starts in the middle of a tree; the leave events of nodes whose enter was overwritten
+are skipped, and the partial iteration is shown with an unknown depth.
+
+Usage: gorilla-trace <dump> [--thread N] [--top N]
+*/
+
+namespace TraceView {
+
+	constexpr int maxPly{ 256 };
+
+	struct Settings {
+		std::string file;
+		int thread{ -1 };
+		int top{ 10 };
+	};
+
+	/*
+	* A node being rebuilt.
+	*/
+	struct Frame {
+		Trace::Event enter;
+		std::uint64_t nodes{ 1 };		//the node and its subtree so far
+		std::uint64_t lastChild{ 0 };	//nodes of the child searched last
+		bool repeated{ false };
+	};
+
+	struct PlyStats {
+		std::uint64_t nodes{ 0 };
+		std::uint64_t qnodes{ 0 };
+		std::uint64_t interior{ 0 };	//full width nodes that searched a child
+		std::uint64_t children{ 0 };
+		std::uint64_t cutoffs{ 0 };
+		std::uint64_t firstCutoffs{ 0 };
+		std::uint64_t cutoffOrder{ 0 };
+		std::uint64_t ttHits{ 0 };
+		std::uint64_t ttCutoffs{ 0 };
+		std::uint64_t nullCutoffs{ 0 };
+	};
+
+	struct Iteration {
+		int depth{ 0 };
+		std::uint64_t nodes{ 0 };
+		std::uint64_t repeated{ 0 };
+		std::uint64_t repeatedNodes{ 0 };
+		std::unordered_map<std::uint64_t, int> seen;
+	};
+
+	struct LateCutoff {
+		std::uint64_t wasted{ 0 };
+		int iteration{ 0 };
+		int ply{ 0 };
+		int depth{ 0 };
+		int order{ 0 };
+		std::uint16_t move{ 0 };
+		std::string path;
+	};
+
+	std::string moveName(std::uint16_t m) {
+		return m ? Move::toUCI(m) : "null";
+	}
+
+	/**
+	 * .
+	 * Summarizes the events of one thread.
+	 * \param index
+	 * \param events
+	 * \param settings
+	 */
+	void summarize(int index, const std::vector<Trace::Event>& events, const Settings& settings) {
+
+		std::vector<Frame> stack;
+		std::vector<PlyStats> plies(maxPly);
+		std::vector<Iteration> iterations;
+		std::vector<LateCutoff> late;
+		std::uint64_t skipped{ 0 };
+
+		for (const Trace::Event& e : events) {
+
+			if (e.kind == Trace::enterNode || e.kind == Trace::enterQuiescence) {
+
+				/*
+				* A root node starts an iteration. A wrapped ring lost the root of the iteration it starts in, so that
+				* one is counted as an iteration of unknown depth.
+				*/
+
+				if (e.kind == Trace::enterNode && e.ply == 0) {
+					stack.clear();
+					iterations.push_back(Iteration{ e.depth, 0, 0, 0, {} });
+				}
+
+				if (iterations.empty()) iterations.push_back(Iteration{ -1, 0, 0, 0, {} });
+
+				Frame frame{ e };
+
+				if (e.kind == Trace::enterNode) {
+					std::uint64_t key = (std::uint64_t)e.key << 8 | (std::uint8_t)e.depth;
+					frame.repeated = iterations.back().seen[key]++ > 0;
+				}
+
+				stack.push_back(frame);
+
+			}
+			else if (e.kind == Trace::ttHit) {
+				if (!stack.empty()) plies[e.ply].ttHits++;
+			}
+			else if (e.kind == Trace::leave) {
+
+				while (!stack.empty() && stack.back().enter.ply > e.ply) stack.pop_back();
+				if (stack.empty() || stack.back().enter.ply != e.ply) {
+					skipped++;
+					continue;
+				}
+
+				Frame frame = stack.back();
+				stack.pop_back();
+
+				Iteration& it = iterations.back();
+				PlyStats& p = plies[e.ply];
+
+				it.nodes++;
+
+				if (frame.enter.kind == Trace::enterQuiescence) p.qnodes++;
+				else {
+
+					p.nodes++;
+
+					if (frame.nodes > 1) p.interior++;
+
+					if (frame.repeated) {
+						it.repeated++;
+						it.repeatedNodes += frame.nodes;
+					}
+
+					if (e.reason == Trace::ttCutoff) p.ttCutoffs++;
+					if (e.reason == Trace::nullCutoff) p.nullCutoffs++;
+
+					if (e.reason == Trace::betaCutoff) {
+
+						p.cutoffs++;
+						p.cutoffOrder += e.order;
+						if (e.order == 1) p.firstCutoffs++;
+
+						/*
+						* Everything but the node itself and the cutoff move's subtree was searched for nothing, if
+						* the cutoff move had been tried first.
+						*/
+
+						if (e.order > 1) {
+
+							LateCutoff cut{ frame.nodes - 1 - frame.lastChild, (int)iterations.size(), e.ply, frame.enter.depth, e.order, e.move, {} };
+
+							for (const Frame& f : stack) if (f.enter.ply) cut.path += moveName(f.enter.move) + ' ';
+							if (frame.enter.ply) cut.path += moveName(frame.enter.move);
+
+							late.push_back(cut);
+
+						}
+
+					}
+
+				}
+
+				if (!stack.empty()) {
+					Frame& parent = stack.back();
+					parent.nodes += frame.nodes;
+					parent.lastChild = frame.nodes;
+					if (parent.enter.kind == Trace::enterNode) plies[parent.enter.ply].children++;
+				}
+
+			}
+
+		}
+
+		std::cout << "thread " << index << ": " << events.size() << " events, " << iterations.size() << " iterations";
+		if (skipped) std::cout << ", " << skipped << " leave events without their enter skipped";
+		std::cout << "\n\n";
+
+		std::cout << "iteration  depth        nodes   ratio   repeated  repeated nodes\n";
+
+		for (std::size_t i = 0; i < iterations.size(); i++) {
+			const Iteration& it = iterations[i];
+			std::cout << std::setw(9) << i + 1 << std::setw(7) << (it.depth < 0 ? "?" : std::to_string(it.depth)) << std::setw(13) << it.nodes << std::setw(8);
+			if (i && iterations[i - 1].nodes) std::cout << std::fixed << std::setprecision(2) << (double)it.nodes / iterations[i - 1].nodes;
+			else std::cout << '-';
+			std::cout << std::setw(11) << it.repeated << std::setw(16) << it.repeatedNodes << '\n';
+		}
+
+		std::cout << "\nply       nodes      qnodes  children  cutoffs  first%  cut index   tt hits  tt cuts  null cuts\n";
+
+		for (int ply = 0; ply < maxPly; ply++) {
+
+			const PlyStats& p = plies[ply];
+			if (!p.nodes && !p.qnodes) continue;
+
+			std::cout << std::setw(3) << ply << std::setw(12) << p.nodes << std::setw(12) << p.qnodes << std::setw(10) << std::fixed << std::setprecision(2)
+				<< (p.interior ? (double)p.children / p.interior : 0.0) << std::setw(9) << p.cutoffs << std::setw(8) << std::setprecision(1)
+				<< (p.cutoffs ? 100.0 * p.firstCutoffs / p.cutoffs : 0.0) << std::setw(11) << std::setprecision(2)
+				<< (p.cutoffs ? (double)p.cutoffOrder / p.cutoffs : 0.0) << std::setw(10) << p.ttHits << std::setw(9) << p.ttCutoffs
+				<< std::setw(11) << p.nullCutoffs << '\n';
+
+		}
+
+		std::sort(late.begin(), late.end(), [](const LateCutoff& a, const LateCutoff& b) { return a.wasted > b.wasted; });
+		if ((int)late.size() > settings.top) late.resize(settings.top);
+
+		if (!late.empty()) {
+			std::cout << "\nlate cutoffs that wasted the most nodes\n";
+			for (const LateCutoff& cut : late) {
+				std::cout << "  iteration " << cut.iteration << " ply " << cut.ply << " depth " << cut.depth << ": " << moveName(cut.move)
+					<< " was move " << cut.order << ", " << cut.wasted << " nodes before it; after " << (cut.path.empty() ? "(root)" : cut.path) << '\n';
+			}
+		}
+
+		std::cout << std::endl;
+
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+
+	using namespace TraceView;
+
+	Settings settings;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg{ argv[i] };
+		if (arg == "--thread" && i + 1 < argc) settings.thread = std::atoi(argv[++i]);
+		else if (arg == "--top" && i + 1 < argc) settings.top = std::max(0, std::atoi(argv[++i]));
+		else if (settings.file.empty() && arg[0] != '-') settings.file = arg;
+		else {
+			settings.file.clear();
+			break;
+		}
+	}
+
+	if (settings.file.empty()) {
+		std::cout << "usage: gorilla-trace <dump> [--thread N] [--top N]" << std::endl;
+		return 1;
+	}
+
+	std::ifstream in{ settings.file, std::ios::binary };
+
+	std::uint32_t magic{ 0 }, threads{ 0 };
+	in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	in.read(reinterpret_cast<char*>(&threads), sizeof(threads));
+
+	if (!in || magic != Trace::fileMagic) {
+		std::cout << settings.file << " is not a trace dump" << std::endl;
+		return 1;
+	}
+
+	for (std::uint32_t t = 0; t < threads; t++) {
+
+		std::uint64_t count{ 0 };
+		in.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+		std::vector<Trace::Event> events(in ? count : 0);
+		in.read(reinterpret_cast<char*>(events.data()), (std::streamsize)(events.size() * sizeof(Trace::Event)));
+
+		if (!in) {
+			std::cout << settings.file << " is cut short" << std::endl;
+			return 1;
+		}
+
+		if (settings.thread < 0 || settings.thread == (int)t) summarize((int)t, events, settings);
+
+	}
+
+	return 0;
+
+}